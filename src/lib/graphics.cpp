@@ -1,7 +1,9 @@
 #include "graphics.h"
+#include <cstring>
 #include "utils.h"
 
 #include "graphics_gl4.h"
+#include "graphics_null.h"
 
 namespace Graphics
 {
@@ -19,16 +21,21 @@ namespace Graphics
             2048,
             2048,
             2048,
-            2048
+            2048,
+            2,
+            NULL,
+            NULL,
+            0
         };
         return init_backend(type, default_config);
     }
 
+    // Just returns a singleton per backend type.
+    static GL4Backend* gl4_backend_singleton = nullptr;
+    static NullBackend* null_backend_singleton = nullptr;
+
     Backend* init_backend(BackendType type, const BackendConfig& config)
     {
-        // Just returns a singleton.
-        static GL4Backend* gl4_backend_singleton = nullptr;
-        
         Backend* backend_singleton;
         // We're just newing these. Not an issue, Ray...
         switch (type)
@@ -38,6 +45,11 @@ namespace Graphics
                     gl4_backend_singleton = new GL4Backend(config);
                 backend_singleton = gl4_backend_singleton;
                 break;
+            case NULL_BACKEND:
+                if (!null_backend_singleton)
+                    null_backend_singleton = new NullBackend(config);
+                backend_singleton = null_backend_singleton;
+                break;
             default:
                 RUNTIME_ERROR("Unknown backend type %d", type);
         }
@@ -47,9 +59,33 @@ namespace Graphics
 
     void deinit_backend(Backend* backend)
     {
+        // Forget the singleton so the next init_backend makes a fresh one
+        // instead of handing back a dangling pointer
+        if (backend == gl4_backend_singleton)
+            gl4_backend_singleton = nullptr;
+        if (backend == null_backend_singleton)
+            null_backend_singleton = nullptr;
         delete backend;
     }
 
+    size_t get_data_type_bytes(DataType type)
+    {
+        switch (type)
+        {
+            case BYTE:
+            case UNSIGNED_BYTE: return 1;
+            case SHORT:
+            case UNSIGNED_SHORT: return 2;
+            case INT:
+            case UNSIGNED_INT: return 4;
+            case HALF_FLOAT: return 2;
+            case FLOAT: return 4;
+            case DOUBLE: return 8;
+            case FIXED: return 4;
+            default: RUNTIME_ERROR("Unknown type %d", type);
+        }
+    }
+
     void assert_pipeline_config_valid(const PipelineConfig& config)
     {
         ASSERT_MSG(config.num_buffers < GRAPHICS_PIPELINE_MAX_BUFFERS, "Invalid pipeline config: Num buffers %zu exceeds max buffers %d", config.num_buffers, GRAPHICS_PIPELINE_MAX_BUFFERS);
@@ -65,4 +101,116 @@ namespace Graphics
         // TODO: Check shader that shader stages don't overlap, or that one shader
         // doesn't have a stage in between another
     }
-}
\ No newline at end of file
+
+    uint64_t hash_shader_config(const ShaderConfig& config)
+    {
+        uint64_t hash = Utils::hash_fnv1a_u64(config.num_stages);
+        for (size_t i = 0; i < config.num_stages; i++)
+        {
+            const char* source = config.shader_stages[i].source;
+            hash = Utils::hash_fnv1a_u64(config.shader_stages[i].stage, hash);
+            // Terminator included so stage boundaries can't shift unnoticed
+            hash = Utils::hash_fnv1a(source, strlen(source) + 1, hash);
+        }
+        return hash;
+    }
+
+    void make_shader_config_key(const ShaderConfig& config, ShaderConfigKey* out_key)
+    {
+        out_key->stages.clear();
+        out_key->sources.clear();
+        for (size_t i = 0; i < config.num_stages; i++)
+        {
+            out_key->stages.push_back(config.shader_stages[i].stage);
+            out_key->sources.push_back(config.shader_stages[i].source);
+        }
+    }
+
+    bool shader_config_matches(const ShaderConfigKey& key, const ShaderConfig& config)
+    {
+        if (key.stages.size() != config.num_stages)
+            return false;
+
+        for (size_t i = 0; i < config.num_stages; i++)
+        {
+            if (key.stages[i] != config.shader_stages[i].stage || key.sources[i] != config.shader_stages[i].source)
+                return false;
+        }
+        return true;
+    }
+
+    uint64_t hash_pipeline_config(const PipelineConfig& config)
+    {
+        uint64_t hash = Utils::hash_fnv1a_u64(config.num_shaders);
+        for (size_t i = 0; i < config.num_shaders; i++)
+            hash = Utils::hash_fnv1a_u64(Utils::weakref_bits(config.shaders[i].handle), hash);
+
+        hash = Utils::hash_fnv1a_u64(config.num_attributes, hash);
+        for (size_t i = 0; i < config.num_attributes; i++)
+        {
+            const VertexAttributeConfig& attribute = config.vertex_attributes[i];
+            hash = Utils::hash_fnv1a_u64(attribute.type, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.binding, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.location, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.normalized, hash);
+        }
+
+        hash = Utils::hash_fnv1a_u64(config.num_buffers, hash);
+        for (size_t i = 0; i < config.num_buffers; i++)
+            hash = Utils::hash_fnv1a_u64(config.buffer_types[i], hash);
+
+        hash = Utils::hash_fnv1a_u64(config.num_textures, hash);
+        for (size_t i = 0; i < config.num_textures; i++)
+            hash = Utils::hash_fnv1a_u64(config.texture_types[i], hash);
+
+        return hash;
+    }
+
+    void make_pipeline_config_key(const PipelineConfig& config, PipelineConfigKey* out_key)
+    {
+        out_key->shaders.clear();
+        for (size_t i = 0; i < config.num_shaders; i++)
+            out_key->shaders.push_back(config.shaders[i].handle);
+        out_key->vertex_attributes.assign(config.vertex_attributes, config.vertex_attributes + config.num_attributes);
+        out_key->buffer_types.assign(config.buffer_types, config.buffer_types + config.num_buffers);
+        out_key->texture_types.assign(config.texture_types, config.texture_types + config.num_textures);
+    }
+
+    bool pipeline_config_matches(const PipelineConfigKey& key, const PipelineConfig& config)
+    {
+        if (key.shaders.size() != config.num_shaders
+            || key.vertex_attributes.size() != config.num_attributes
+            || key.buffer_types.size() != config.num_buffers
+            || key.texture_types.size() != config.num_textures)
+            return false;
+
+        for (size_t i = 0; i < config.num_shaders; i++)
+        {
+            if (key.shaders[i] != config.shaders[i].handle)
+                return false;
+        }
+
+        // Field by field, padding isn't part of the config
+        for (size_t i = 0; i < config.num_attributes; i++)
+        {
+            const VertexAttributeConfig& a = key.vertex_attributes[i];
+            const VertexAttributeConfig& b = config.vertex_attributes[i];
+            if (a.type != b.type || a.binding != b.binding || a.location != b.location || a.normalized != b.normalized)
+                return false;
+        }
+
+        for (size_t i = 0; i < config.num_buffers; i++)
+        {
+            if (key.buffer_types[i] != config.buffer_types[i])
+                return false;
+        }
+
+        for (size_t i = 0; i < config.num_textures; i++)
+        {
+            if (key.texture_types[i] != config.texture_types[i])
+                return false;
+        }
+
+        return true;
+    }
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include "utils.h"
 
 namespace Graphics
@@ -7,8 +8,28 @@ namespace Graphics
     #define GRAPHICS_MAX_VERTEX_ATTRIBS 16
     #define GRAPHICS_PIPELINE_MAX_BUFFERS 16
     #define GRAPHICS_PIPELINE_MAX_TEXTURES 16
+    #define GRAPHICS_MAX_SHADER_STAGES 6
 
-    #define STRONGLY_TYPED_WEAKREF(name) struct name {Utils::WeakRef handle;}
+    // Type tags stamped into each resource handle, so a handle used as the
+    // wrong kind of resource fails validation instead of resolving
+    enum ResourceType
+    {
+        RESOURCE_NONE,
+        RESOURCE_VERTEX_BUFFER,
+        RESOURCE_INDEX_BUFFER,
+        RESOURCE_TEXTURE,
+        RESOURCE_SHADER,
+        RESOURCE_PIPELINE
+    };
+
+    #define STRONGLY_TYPED_WEAKREF(name, resource_type) \
+        struct name \
+        { \
+            static const uint8_t type = resource_type; \
+            Utils::WeakRef handle; \
+            bool operator==(const name& other) const { return handle == other.handle; } \
+            bool operator!=(const name& other) const { return handle != other.handle; } \
+        }
 
     enum DataType
     {
@@ -23,6 +44,7 @@ namespace Graphics
         DOUBLE,
         FIXED
     };
+    size_t get_data_type_bytes(DataType type);
 
     struct VertexAttributeConfig
     {
@@ -38,20 +60,31 @@ namespace Graphics
         bool normalized;
     };
 
+    // How often a buffer's contents change. Backends pick how to upload
+    // updates from it.
+    enum BufferUsage
+    {
+        BUFFER_USAGE_STATIC, // Written once, at creation or close to it
+        BUFFER_USAGE_DYNAMIC, // Parts rewritten now and then
+        BUFFER_USAGE_STREAM // Rewritten every frame
+    };
+
     struct VertexBufferConfig
     {
         void* data;
         size_t size;
+        BufferUsage usage;
     };
-    STRONGLY_TYPED_WEAKREF(VertexBuffer);
+    STRONGLY_TYPED_WEAKREF(VertexBuffer, RESOURCE_VERTEX_BUFFER);
 
     struct IndexBufferConfig
     {
         DataType type;
         void* data;
         size_t num_indices;
+        BufferUsage usage;
     };
-    STRONGLY_TYPED_WEAKREF(IndexBuffer);
+    STRONGLY_TYPED_WEAKREF(IndexBuffer, RESOURCE_INDEX_BUFFER);
 
     enum BufferType
     {
@@ -102,7 +135,7 @@ namespace Graphics
         void* data;
         size_t size;
     };
-    STRONGLY_TYPED_WEAKREF(Texture);
+    STRONGLY_TYPED_WEAKREF(Texture, RESOURCE_TEXTURE);
 
     enum ShaderStageBit
     {
@@ -126,7 +159,26 @@ namespace Graphics
         ShaderStageConfig* shader_stages;
         size_t num_stages;
     };
-    STRONGLY_TYPED_WEAKREF(Shader);
+    STRONGLY_TYPED_WEAKREF(Shader, RESOURCE_SHADER);
+    // Covers every stage's type and source. Backends share one shader between
+    // equal configs, so pipelines built from them match up too.
+    uint64_t hash_shader_config(const ShaderConfig& config);
+
+    // Owned copy of every stage's type and source, kept per shader cache
+    // entry so a hash hit is only shared when the sources really match
+    struct ShaderConfigKey
+    {
+        std::vector<ShaderStageBit> stages;
+        std::vector<std::string> sources;
+    };
+    void make_shader_config_key(const ShaderConfig& config, ShaderConfigKey* out_key);
+    bool shader_config_matches(const ShaderConfigKey& key, const ShaderConfig& config);
+
+    struct ShaderCacheEntry
+    {
+        Shader shader;
+        ShaderConfigKey config;
+    };
 
     // Resources a pipeline needs are defined here, ie textures, 
     // vertex/index buffers, uniform buffers etc
@@ -143,12 +195,36 @@ namespace Graphics
         TextureType* texture_types;
         size_t num_textures;
     };
-    STRONGLY_TYPED_WEAKREF(Pipeline);
+    STRONGLY_TYPED_WEAKREF(Pipeline, RESOURCE_PIPELINE);
     void assert_pipeline_config_valid(const PipelineConfig& config);
+    // Covers shaders, attributes, buffer types and texture types. Backends
+    // look pipelines up by it, then check the config itself.
+    uint64_t hash_pipeline_config(const PipelineConfig& config);
+
+    // Owned copy of everything hash_pipeline_config covers. Pipeline caches
+    // keep one per entry, so configs whose hashes collide don't share.
+    struct PipelineConfigKey
+    {
+        std::vector<Utils::WeakRef> shaders;
+        std::vector<VertexAttributeConfig> vertex_attributes;
+        std::vector<BufferType> buffer_types;
+        std::vector<TextureType> texture_types;
+    };
+    void make_pipeline_config_key(const PipelineConfig& config, PipelineConfigKey* out_key);
+    bool pipeline_config_matches(const PipelineConfigKey& key, const PipelineConfig& config);
+
+    struct PipelineCacheEntry
+    {
+        Pipeline pipeline;
+        PipelineConfigKey config;
+    };
 
     enum BackendType
     {
-        OPENGL_4
+        OPENGL_4,
+        // No driver calls, only handle bookkeeping. For headless tests and
+        // for measuring the overhead of this layer
+        NULL_BACKEND
     };
 
     struct BackendConfig
@@ -157,8 +233,23 @@ namespace Graphics
         size_t num_prealloc_textures;
         size_t num_prealloc_shaders;
         size_t num_prealloc_pipelines;
+        // How many frames the GPU can lag behind. Destroyed resources are
+        // kept alive this many end_frame calls before the backend deletes them.
+        size_t num_frames_in_flight;
+        // Directory under the physfs write dir for caching compiled shader
+        // binaries between runs. NULL disables the cache.
+        const char* program_cache_dir;
+        // Used to load optional GL extension entry points, ie
+        // SDL_GL_GetProcAddress. NULL skips them.
+        void* (*gl_proc_loader)(const char* name);
+        // Bytes per frame of persistently mapped memory for stream buffer
+        // uploads, one share per frame in flight. 0, or a driver without
+        // buffer storage, leaves those uploads to the driver.
+        size_t upload_ring_size;
     };
 
+    class CommandBuffer;
+
     class Backend
     {
     public:
@@ -167,12 +258,25 @@ namespace Graphics
         virtual void destroy_vertex_buffer(const VertexBuffer& buffer) = 0;
         virtual IndexBuffer create_index_buffer(const IndexBufferConfig& config) = 0;
         virtual void destroy_index_buffer(const IndexBuffer& buffer) = 0;
+        // Overwrite part of a buffer. Render thread only. Draws submitted
+        // earlier still see the old contents.
+        virtual void update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size) = 0;
+        virtual void update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices) = 0;
         virtual Texture create_texture(const TextureConfig& config) = 0;
         virtual void destroy_texture(const Texture& texture) = 0;
         virtual Shader create_shader(const ShaderConfig& config) = 0;
         virtual void destroy_shader(const Shader& shader) = 0;
+        // Shaders may still be compiling when create_shader returns. Doesn't
+        // block where the backend can tell, so loading screens can poll this.
+        // Pipelines can be made from shaders that aren't ready; that waits.
+        virtual bool is_shader_ready(const Shader& shader) = 0;
         virtual Pipeline create_pipeline(const PipelineConfig& config) = 0;
         virtual void destroy_pipeline(const Pipeline& pipeline) = 0;
+        // Executes the command buffers in the order given. Render thread only,
+        // and none of them may be recorded into until this returns.
+        virtual void submit(CommandBuffer** command_buffers, size_t num_command_buffers) = 0;
+        // Call once per frame after presenting
+        virtual void end_frame() = 0;
     };
 
     Backend* init_backend(BackendType type);
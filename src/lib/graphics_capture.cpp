@@ -0,0 +1,816 @@
+#include "graphics_capture.h"
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+////////////////////////////////////////////////////////////////////////////////
+// Capture/replay
+////////////////////////////////////////////////////////////////////////////////
+
+namespace Graphics
+{
+    #define CAPTURE_NULL_BLOB UINT64_MAX
+
+    void CaptureWriter::write_bytes(const void* data, size_t size)
+    {
+        const uint8_t* begin = (const uint8_t*) data;
+        bytes.insert(bytes.end(), begin, begin + size);
+    }
+
+    void CaptureWriter::write_blob(const void* data, size_t size)
+    {
+        if (!data)
+        {
+            write_u64(CAPTURE_NULL_BLOB);
+            return;
+        }
+        write_u64(size);
+        write_bytes(data, size);
+    }
+
+    void CaptureWriter::write_string(const char* string)
+    {
+        ASSERT_MSG(string, "Cannot capture a null string");
+        uint32_t length = strlen(string);
+        write_u32(length);
+        write_bytes(string, length);
+    }
+
+    CaptureReader::CaptureReader(const uint8_t* in_data, size_t in_size)
+        : data(in_data)
+        , size(in_size)
+        , offset(0)
+        , failed(false)
+    {
+    }
+
+    bool CaptureReader::read_bytes(void* out_data, size_t num_bytes)
+    {
+        if (failed || size - offset < num_bytes)
+        {
+            failed = true;
+            memset(out_data, 0, num_bytes);
+            return false;
+        }
+        memcpy(out_data, data + offset, num_bytes);
+        offset += num_bytes;
+        return true;
+    }
+
+    uint8_t CaptureReader::read_u8()
+    {
+        uint8_t value;
+        read_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    uint32_t CaptureReader::read_u32()
+    {
+        uint32_t value;
+        read_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    uint64_t CaptureReader::read_u64()
+    {
+        uint64_t value;
+        read_bytes(&value, sizeof(value));
+        return value;
+    }
+
+    const void* CaptureReader::read_blob(size_t* out_size)
+    {
+        uint64_t blob_size = read_u64();
+        *out_size = 0;
+        if (failed || blob_size == CAPTURE_NULL_BLOB)
+            return nullptr;
+        if (size - offset < blob_size)
+        {
+            failed = true;
+            return nullptr;
+        }
+        const void* blob = data + offset;
+        offset += blob_size;
+        *out_size = blob_size;
+        return blob;
+    }
+
+    const char* CaptureReader::read_string(Utils::LinearArena& arena)
+    {
+        uint32_t length = read_u32();
+        if (failed || size - offset < length)
+        {
+            failed = true;
+            return nullptr;
+        }
+        // Sources go to the driver as C strings, so they need a terminator
+        char* string = arena.allocate_array<char>(length + 1);
+        memcpy(string, data + offset, length);
+        string[length] = '\0';
+        offset += length;
+        return string;
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// Config serialization
+////////////////////////////////////////////////////////////////////////////////
+
+    void write_vertex_buffer_config(CaptureWriter& writer, const VertexBufferConfig& config)
+    {
+        writer.write_u64(config.size);
+        writer.write_blob(config.data, config.size);
+        writer.write_u8(config.usage);
+    }
+
+    // Rejects anything BufferUsage can't hold
+    static BufferUsage read_buffer_usage(CaptureReader& reader)
+    {
+        uint8_t usage = reader.read_u8();
+        if (usage > BUFFER_USAGE_STREAM)
+            reader.failed = true;
+        return (BufferUsage) usage;
+    }
+
+    bool read_vertex_buffer_config(CaptureReader& reader, VertexBufferConfig* out_config)
+    {
+        size_t blob_size;
+        out_config->size = reader.read_u64();
+        out_config->data = (void*) reader.read_blob(&blob_size);
+        if (out_config->data && blob_size != out_config->size)
+            reader.failed = true;
+        out_config->usage = read_buffer_usage(reader);
+        return !reader.failed;
+    }
+
+    void write_index_buffer_config(CaptureWriter& writer, const IndexBufferConfig& config)
+    {
+        writer.write_u32(config.type);
+        writer.write_u64(config.num_indices);
+        writer.write_blob(config.data, get_data_type_bytes(config.type) * config.num_indices);
+        writer.write_u8(config.usage);
+    }
+
+    bool read_index_buffer_config(CaptureReader& reader, IndexBufferConfig* out_config)
+    {
+        size_t blob_size;
+        uint32_t type = reader.read_u32();
+        if (type > FIXED)
+            reader.failed = true;
+        out_config->type = (DataType) type;
+        out_config->num_indices = reader.read_u64();
+        out_config->data = (void*) reader.read_blob(&blob_size);
+        if (out_config->data && blob_size != get_data_type_bytes(out_config->type) * out_config->num_indices)
+            reader.failed = true;
+        out_config->usage = read_buffer_usage(reader);
+        return !reader.failed;
+    }
+
+    void write_texture_config(CaptureWriter& writer, const TextureConfig& config)
+    {
+        writer.write_u32(config.type);
+        writer.write_u32((uint32_t) config.wrap_type);
+        writer.write_u32((uint32_t) config.min_filter_type);
+        writer.write_u32((uint32_t) config.mag_filter_type);
+        writer.write_u64(config.size);
+        writer.write_blob(config.data, config.size);
+    }
+
+    bool read_texture_config(CaptureReader& reader, TextureConfig* out_config)
+    {
+        size_t blob_size;
+        out_config->type = (TextureType) reader.read_u32();
+        out_config->wrap_type = (TextureConfig::WrapType) reader.read_u32();
+        out_config->min_filter_type = (TextureConfig::MinFilterType) reader.read_u32();
+        out_config->mag_filter_type = (TextureConfig::MagFilterType) reader.read_u32();
+        out_config->size = reader.read_u64();
+        out_config->data = (void*) reader.read_blob(&blob_size);
+        if (out_config->data && blob_size != out_config->size)
+            reader.failed = true;
+        return !reader.failed;
+    }
+
+    void write_shader_config(CaptureWriter& writer, const ShaderConfig& config)
+    {
+        writer.write_u64(config.num_stages);
+        for (size_t i = 0; i < config.num_stages; i++)
+        {
+            writer.write_u32(config.shader_stages[i].stage);
+            writer.write_string(config.shader_stages[i].source);
+        }
+    }
+
+    bool read_shader_config(CaptureReader& reader, Utils::LinearArena& arena, ShaderConfig* out_config)
+    {
+        uint64_t num_stages = reader.read_u64();
+        // Anything more than one per stage bit is garbage
+        if (reader.failed || num_stages > GRAPHICS_MAX_SHADER_STAGES)
+        {
+            reader.failed = true;
+            return false;
+        }
+
+        out_config->num_stages = num_stages;
+        out_config->shader_stages = arena.allocate_array<ShaderStageConfig>(num_stages);
+        for (size_t i = 0; i < num_stages; i++)
+        {
+            out_config->shader_stages[i].stage = (ShaderStageBit) reader.read_u32();
+            out_config->shader_stages[i].source = reader.read_string(arena);
+        }
+        return !reader.failed;
+    }
+
+    void write_pipeline_config(CaptureWriter& writer, const PipelineConfig& config)
+    {
+        writer.write_u64(config.num_shaders);
+        for (size_t i = 0; i < config.num_shaders; i++)
+            writer.write_u64(Utils::weakref_bits(config.shaders[i].handle));
+
+        writer.write_u64(config.num_attributes);
+        for (size_t i = 0; i < config.num_attributes; i++)
+        {
+            const VertexAttributeConfig& attribute = config.vertex_attributes[i];
+            writer.write_u32(attribute.type);
+            writer.write_u32(attribute.binding);
+            writer.write_u32(attribute.location);
+            writer.write_u8(attribute.normalized);
+        }
+
+        writer.write_u64(config.num_buffers);
+        for (size_t i = 0; i < config.num_buffers; i++)
+            writer.write_u32(config.buffer_types[i]);
+
+        writer.write_u64(config.num_textures);
+        for (size_t i = 0; i < config.num_textures; i++)
+            writer.write_u32(config.texture_types[i]);
+    }
+
+    // Reads an array count, rejecting anything the pipeline limits would
+    // reject anyway so a corrupt count can't blow up the arena
+    static size_t read_count(CaptureReader& reader, size_t max_count)
+    {
+        uint64_t count = reader.read_u64();
+        if (count > max_count)
+        {
+            reader.failed = true;
+            return 0;
+        }
+        return count;
+    }
+
+    bool read_pipeline_config(CaptureReader& reader, Utils::LinearArena& arena, PipelineConfig* out_config)
+    {
+        out_config->num_shaders = read_count(reader, GRAPHICS_MAX_SHADER_STAGES);
+        out_config->shaders = arena.allocate_array<Shader>(out_config->num_shaders);
+        for (size_t i = 0; i < out_config->num_shaders; i++)
+            out_config->shaders[i].handle = Utils::weakref_from_bits(reader.read_u64());
+
+        out_config->num_attributes = read_count(reader, GRAPHICS_MAX_VERTEX_ATTRIBS);
+        out_config->vertex_attributes = arena.allocate_array<VertexAttributeConfig>(out_config->num_attributes);
+        for (size_t i = 0; i < out_config->num_attributes; i++)
+        {
+            VertexAttributeConfig& attribute = out_config->vertex_attributes[i];
+            attribute.type = (VertexAttributeConfig::Type) reader.read_u32();
+            attribute.binding = reader.read_u32();
+            attribute.location = reader.read_u32();
+            attribute.normalized = reader.read_u8() != 0;
+        }
+
+        out_config->num_buffers = read_count(reader, GRAPHICS_PIPELINE_MAX_BUFFERS);
+        out_config->buffer_types = arena.allocate_array<BufferType>(out_config->num_buffers);
+        for (size_t i = 0; i < out_config->num_buffers; i++)
+            out_config->buffer_types[i] = (BufferType) reader.read_u32();
+
+        out_config->num_textures = read_count(reader, GRAPHICS_PIPELINE_MAX_TEXTURES);
+        out_config->texture_types = arena.allocate_array<TextureType>(out_config->num_textures);
+        for (size_t i = 0; i < out_config->num_textures; i++)
+            out_config->texture_types[i] = (TextureType) reader.read_u32();
+
+        return !reader.failed;
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// CaptureBackend
+////////////////////////////////////////////////////////////////////////////////
+
+    CaptureBackend::CaptureBackend(Backend* backend)
+        : m_backend(backend)
+    {
+        m_writer.write_u32(CAPTURE_MAGIC);
+        m_writer.write_u32(CAPTURE_VERSION);
+    }
+
+    CaptureBackend::~CaptureBackend()
+    {
+    }
+
+    void CaptureBackend::write_handle(const Utils::WeakRef& handle)
+    {
+        m_writer.write_u64(Utils::weakref_bits(handle));
+    }
+
+    VertexBuffer CaptureBackend::create_vertex_buffer(const VertexBufferConfig& config)
+    {
+        VertexBuffer result = m_backend->create_vertex_buffer(config);
+        m_writer.write_u8(CAPTURE_OP_CREATE_VERTEX_BUFFER);
+        write_vertex_buffer_config(m_writer, config);
+        write_handle(result.handle);
+        return result;
+    }
+
+    void CaptureBackend::destroy_vertex_buffer(const VertexBuffer& buffer)
+    {
+        m_writer.write_u8(CAPTURE_OP_DESTROY_VERTEX_BUFFER);
+        write_handle(buffer.handle);
+        m_backend->destroy_vertex_buffer(buffer);
+    }
+
+    IndexBuffer CaptureBackend::create_index_buffer(const IndexBufferConfig& config)
+    {
+        IndexBuffer result = m_backend->create_index_buffer(config);
+        m_writer.write_u8(CAPTURE_OP_CREATE_INDEX_BUFFER);
+        write_index_buffer_config(m_writer, config);
+        write_handle(result.handle);
+        m_index_bytes[Utils::weakref_bits(result.handle)] = get_data_type_bytes(config.type);
+        return result;
+    }
+
+    void CaptureBackend::destroy_index_buffer(const IndexBuffer& buffer)
+    {
+        m_writer.write_u8(CAPTURE_OP_DESTROY_INDEX_BUFFER);
+        write_handle(buffer.handle);
+        m_index_bytes.erase(Utils::weakref_bits(buffer.handle));
+        m_backend->destroy_index_buffer(buffer);
+    }
+
+    // The data is recorded as a blob of the updated range only
+    void CaptureBackend::update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size)
+    {
+        m_writer.write_u8(CAPTURE_OP_UPDATE_VERTEX_BUFFER);
+        write_handle(buffer.handle);
+        m_writer.write_u64(offset);
+        m_writer.write_blob(data, size);
+        m_backend->update_vertex_buffer(buffer, offset, data, size);
+    }
+
+    void CaptureBackend::update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices)
+    {
+        std::unordered_map<uint64_t, size_t>::const_iterator index_bytes = m_index_bytes.find(Utils::weakref_bits(buffer.handle));
+        if (index_bytes == m_index_bytes.end())
+        {
+            // Let the backend complain about the handle; there's nothing to record
+            m_backend->update_index_buffer(buffer, first_index, data, num_indices);
+            return;
+        }
+
+        m_writer.write_u8(CAPTURE_OP_UPDATE_INDEX_BUFFER);
+        write_handle(buffer.handle);
+        m_writer.write_u64(first_index);
+        m_writer.write_u64(num_indices);
+        m_writer.write_blob(data, num_indices * index_bytes->second);
+        m_backend->update_index_buffer(buffer, first_index, data, num_indices);
+    }
+
+    Texture CaptureBackend::create_texture(const TextureConfig& config)
+    {
+        Texture result = m_backend->create_texture(config);
+        m_writer.write_u8(CAPTURE_OP_CREATE_TEXTURE);
+        write_texture_config(m_writer, config);
+        write_handle(result.handle);
+        return result;
+    }
+
+    void CaptureBackend::destroy_texture(const Texture& texture)
+    {
+        m_writer.write_u8(CAPTURE_OP_DESTROY_TEXTURE);
+        write_handle(texture.handle);
+        m_backend->destroy_texture(texture);
+    }
+
+    Shader CaptureBackend::create_shader(const ShaderConfig& config)
+    {
+        Shader result = m_backend->create_shader(config);
+        m_writer.write_u8(CAPTURE_OP_CREATE_SHADER);
+        write_shader_config(m_writer, config);
+        write_handle(result.handle);
+        return result;
+    }
+
+    void CaptureBackend::destroy_shader(const Shader& shader)
+    {
+        m_writer.write_u8(CAPTURE_OP_DESTROY_SHADER);
+        write_handle(shader.handle);
+        m_backend->destroy_shader(shader);
+    }
+
+    // Queries don't change backend state, so they aren't recorded
+    bool CaptureBackend::is_shader_ready(const Shader& shader)
+    {
+        return m_backend->is_shader_ready(shader);
+    }
+
+    Pipeline CaptureBackend::create_pipeline(const PipelineConfig& config)
+    {
+        Pipeline result = m_backend->create_pipeline(config);
+        m_writer.write_u8(CAPTURE_OP_CREATE_PIPELINE);
+        write_pipeline_config(m_writer, config);
+        write_handle(result.handle);
+        return result;
+    }
+
+    void CaptureBackend::destroy_pipeline(const Pipeline& pipeline)
+    {
+        m_writer.write_u8(CAPTURE_OP_DESTROY_PIPELINE);
+        write_handle(pipeline.handle);
+        m_backend->destroy_pipeline(pipeline);
+    }
+
+    void CaptureBackend::submit(CommandBuffer** command_buffers, size_t num_command_buffers)
+    {
+        m_writer.write_u8(CAPTURE_OP_SUBMIT);
+        m_writer.write_u64(num_command_buffers);
+        for (size_t i = 0; i < num_command_buffers; i++)
+        {
+            m_writer.write_u64(command_buffers[i]->num_commands());
+            for (const Command* command = command_buffers[i]->first_command(); command; command = command->next)
+            {
+                m_writer.write_u8(command->type);
+                switch (command->type)
+                {
+                    case COMMAND_BIND_PIPELINE:
+                        write_handle(((const BindPipelineCommand*) command)->pipeline.handle);
+                        break;
+                    case COMMAND_BIND_VERTEX_BUFFER:
+                    {
+                        const BindVertexBufferCommand* bind = (const BindVertexBufferCommand*) command;
+                        write_handle(bind->buffer.handle);
+                        m_writer.write_u32(bind->binding);
+                        m_writer.write_u64(bind->offset);
+                        break;
+                    }
+                    case COMMAND_BIND_INDEX_BUFFER:
+                    {
+                        const BindIndexBufferCommand* bind = (const BindIndexBufferCommand*) command;
+                        write_handle(bind->buffer.handle);
+                        m_writer.write_u64(bind->offset);
+                        break;
+                    }
+                    case COMMAND_DRAW:
+                    {
+                        const DrawCommand* draw = (const DrawCommand*) command;
+                        m_writer.write_u64(draw->num_vertices);
+                        m_writer.write_u64(draw->first_vertex);
+                        break;
+                    }
+                    case COMMAND_DRAW_INDEXED:
+                    {
+                        const DrawIndexedCommand* draw = (const DrawIndexedCommand*) command;
+                        m_writer.write_u64(draw->num_indices);
+                        m_writer.write_u64(draw->first_index);
+                        break;
+                    }
+                    default:
+                        RUNTIME_ERROR("Unknown command type %d", command->type);
+                }
+            }
+        }
+        m_backend->submit(command_buffers, num_command_buffers);
+    }
+
+    void CaptureBackend::end_frame()
+    {
+        m_writer.write_u8(CAPTURE_OP_END_FRAME);
+        m_backend->end_frame();
+    }
+
+    bool CaptureBackend::write_to_file(const char* path) const
+    {
+        FILE* file = fopen(path, "wb");
+        if (!file)
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_IO, "Could not open %s for writing", path);
+            return false;
+        }
+
+        size_t written = fwrite(m_writer.bytes.data(), 1, m_writer.bytes.size(), file);
+        fclose(file);
+        if (written != m_writer.bytes.size())
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_IO, "Short write to %s: %zu of %zu bytes", path, written, m_writer.bytes.size());
+            return false;
+        }
+        return true;
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// Replay
+////////////////////////////////////////////////////////////////////////////////
+
+    // Maps handles as they were recorded to the handles the replay backend
+    // hands out. Backends can hand the same handle out more than once (shared
+    // pipelines), so each one counts the creates it still owes a destroy.
+    struct ReplayHandle
+    {
+        Utils::WeakRef handle;
+        size_t ref_count;
+    };
+    typedef std::unordered_map<uint64_t, ReplayHandle> ReplayHandleMap;
+
+    struct ReplayState
+    {
+        ReplayHandleMap vertex_buffers;
+        ReplayHandleMap index_buffers;
+        ReplayHandleMap textures;
+        ReplayHandleMap shaders;
+        ReplayHandleMap pipelines;
+
+        // Reused across submits so replaying doesn't allocate per frame
+        std::vector<std::unique_ptr<CommandBuffer>> command_buffers;
+        std::vector<CommandBuffer*> command_buffer_ptrs;
+    };
+
+    // What unknown recorded handles map to. No backend has a slot at this
+    // index, so it can't land on a live resource, or on an unused slot.
+    static const Utils::WeakRef replay_dead_handle = { WEAKREF_INVALID_INDEX, 0, 0 };
+
+    // Handles that were already dead when recorded stay dead on replay
+    static Utils::WeakRef replay_find_handle(const ReplayHandleMap& map, uint64_t recorded)
+    {
+        ReplayHandleMap::const_iterator it = map.find(recorded);
+        if (it == map.end())
+            return replay_dead_handle;
+        return it->second.handle;
+    }
+
+    static bool replay_command_buffer(CaptureReader& reader, ReplayState& state, CommandBuffer* command_buffer)
+    {
+        uint64_t num_commands = reader.read_u64();
+        for (uint64_t i = 0; i < num_commands && !reader.failed; i++)
+        {
+            uint8_t type = reader.read_u8();
+            switch (type)
+            {
+                case COMMAND_BIND_PIPELINE:
+                    command_buffer->bind_pipeline({replay_find_handle(state.pipelines, reader.read_u64())});
+                    break;
+                case COMMAND_BIND_VERTEX_BUFFER:
+                {
+                    Utils::WeakRef handle = replay_find_handle(state.vertex_buffers, reader.read_u64());
+                    uint32_t binding = reader.read_u32();
+                    uint64_t offset = reader.read_u64();
+                    if (binding >= GRAPHICS_PIPELINE_MAX_BUFFERS)
+                        return false;
+                    command_buffer->bind_vertex_buffer(binding, {handle}, offset);
+                    break;
+                }
+                case COMMAND_BIND_INDEX_BUFFER:
+                {
+                    Utils::WeakRef handle = replay_find_handle(state.index_buffers, reader.read_u64());
+                    command_buffer->bind_index_buffer({handle}, reader.read_u64());
+                    break;
+                }
+                case COMMAND_DRAW:
+                {
+                    uint64_t num_vertices = reader.read_u64();
+                    command_buffer->draw(num_vertices, reader.read_u64());
+                    break;
+                }
+                case COMMAND_DRAW_INDEXED:
+                {
+                    uint64_t num_indices = reader.read_u64();
+                    command_buffer->draw_indexed(num_indices, reader.read_u64());
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return !reader.failed;
+    }
+
+    static bool replay_submit(CaptureReader& reader, Backend* backend, ReplayState& state)
+    {
+        uint64_t num_command_buffers = reader.read_u64();
+        // Bounded by what's left in the stream, each buffer takes at least 8 bytes
+        if (reader.failed || num_command_buffers > (reader.size - reader.offset) / 8)
+            return false;
+
+        while (state.command_buffers.size() < num_command_buffers)
+            state.command_buffers.emplace_back(new CommandBuffer());
+
+        state.command_buffer_ptrs.clear();
+        for (size_t i = 0; i < num_command_buffers; i++)
+        {
+            CommandBuffer* command_buffer = state.command_buffers[i].get();
+            command_buffer->reset();
+            if (!replay_command_buffer(reader, state, command_buffer))
+                return false;
+            state.command_buffer_ptrs.push_back(command_buffer);
+        }
+
+        backend->submit(state.command_buffer_ptrs.data(), num_command_buffers);
+        return true;
+    }
+
+    // Handles that were never created, or were already destroyed, come back
+    // dead. The destroy still goes through, for the backend to reject like it
+    // did when recording.
+    static Utils::WeakRef replay_take_handle(ReplayHandleMap& map, uint64_t recorded)
+    {
+        ReplayHandleMap::iterator it = map.find(recorded);
+        if (it == map.end())
+            return replay_dead_handle;
+        Utils::WeakRef handle = it->second.handle;
+        if (--it->second.ref_count == 0)
+            map.erase(it);
+        return handle;
+    }
+
+    static void replay_add_handle(ReplayHandleMap& map, uint64_t recorded, const Utils::WeakRef& handle)
+    {
+        ReplayHandleMap::iterator it = map.find(recorded);
+        if (it != map.end() && it->second.handle == handle)
+        {
+            it->second.ref_count++;
+            return;
+        }
+        ReplayHandle replay_handle = { handle, 1 };
+        map[recorded] = replay_handle;
+    }
+
+    static bool replay_record(CaptureReader& reader, CaptureOp op, Backend* backend, ReplayState& state, Utils::LinearArena& scratch)
+    {
+        Utils::WeakRef handle;
+        switch (op)
+        {
+            case CAPTURE_OP_CREATE_VERTEX_BUFFER:
+            {
+                VertexBufferConfig config;
+                if (!read_vertex_buffer_config(reader, &config))
+                    return false;
+                uint64_t recorded = reader.read_u64();
+                replay_add_handle(state.vertex_buffers, recorded, backend->create_vertex_buffer(config).handle);
+                return !reader.failed;
+            }
+            case CAPTURE_OP_DESTROY_VERTEX_BUFFER:
+                handle = replay_take_handle(state.vertex_buffers, reader.read_u64());
+                if (reader.failed)
+                    return false;
+                backend->destroy_vertex_buffer({handle});
+                return true;
+            case CAPTURE_OP_CREATE_INDEX_BUFFER:
+            {
+                IndexBufferConfig config;
+                if (!read_index_buffer_config(reader, &config))
+                    return false;
+                uint64_t recorded = reader.read_u64();
+                replay_add_handle(state.index_buffers, recorded, backend->create_index_buffer(config).handle);
+                return !reader.failed;
+            }
+            case CAPTURE_OP_DESTROY_INDEX_BUFFER:
+                handle = replay_take_handle(state.index_buffers, reader.read_u64());
+                if (reader.failed)
+                    return false;
+                backend->destroy_index_buffer({handle});
+                return true;
+            case CAPTURE_OP_CREATE_TEXTURE:
+            {
+                TextureConfig config;
+                if (!read_texture_config(reader, &config))
+                    return false;
+                uint64_t recorded = reader.read_u64();
+                replay_add_handle(state.textures, recorded, backend->create_texture(config).handle);
+                return !reader.failed;
+            }
+            case CAPTURE_OP_DESTROY_TEXTURE:
+                handle = replay_take_handle(state.textures, reader.read_u64());
+                if (reader.failed)
+                    return false;
+                backend->destroy_texture({handle});
+                return true;
+            case CAPTURE_OP_CREATE_SHADER:
+            {
+                ShaderConfig config;
+                if (!read_shader_config(reader, scratch, &config))
+                    return false;
+                uint64_t recorded = reader.read_u64();
+                replay_add_handle(state.shaders, recorded, backend->create_shader(config).handle);
+                return !reader.failed;
+            }
+            case CAPTURE_OP_DESTROY_SHADER:
+                handle = replay_take_handle(state.shaders, reader.read_u64());
+                if (reader.failed)
+                    return false;
+                backend->destroy_shader({handle});
+                return true;
+            case CAPTURE_OP_CREATE_PIPELINE:
+            {
+                PipelineConfig config;
+                if (!read_pipeline_config(reader, scratch, &config))
+                    return false;
+                // Point the recorded shader handles at the replayed shaders
+                for (size_t i = 0; i < config.num_shaders; i++)
+                {
+                    ReplayHandleMap::iterator it = state.shaders.find(Utils::weakref_bits(config.shaders[i].handle));
+                    if (it == state.shaders.end())
+                        return false;
+                    config.shaders[i].handle = it->second.handle;
+                }
+                uint64_t recorded = reader.read_u64();
+                replay_add_handle(state.pipelines, recorded, backend->create_pipeline(config).handle);
+                return !reader.failed;
+            }
+            case CAPTURE_OP_DESTROY_PIPELINE:
+                handle = replay_take_handle(state.pipelines, reader.read_u64());
+                if (reader.failed)
+                    return false;
+                backend->destroy_pipeline({handle});
+                return true;
+            case CAPTURE_OP_UPDATE_VERTEX_BUFFER:
+            {
+                handle = replay_find_handle(state.vertex_buffers, reader.read_u64());
+                uint64_t offset = reader.read_u64();
+                size_t size;
+                const void* data = reader.read_blob(&size);
+                if (reader.failed)
+                    return false;
+                // Unknown handles go through, for the backend to reject like it did when recording
+                backend->update_vertex_buffer({handle}, offset, data, size);
+                return true;
+            }
+            case CAPTURE_OP_UPDATE_INDEX_BUFFER:
+            {
+                handle = replay_find_handle(state.index_buffers, reader.read_u64());
+                uint64_t first_index = reader.read_u64();
+                uint64_t num_indices = reader.read_u64();
+                size_t size;
+                const void* data = reader.read_blob(&size);
+                if (reader.failed || (!data && num_indices > 0) || (data && num_indices > 0 && size % num_indices != 0))
+                    return false;
+                backend->update_index_buffer({handle}, first_index, data, num_indices);
+                return true;
+            }
+            case CAPTURE_OP_END_FRAME:
+                backend->end_frame();
+                return true;
+            case CAPTURE_OP_SUBMIT:
+                return replay_submit(reader, backend, state);
+            default:
+                return false;
+        }
+    }
+
+    bool replay_capture(const uint8_t* data, size_t size, Backend* backend, ReplayStats* out_stats)
+    {
+        ReplayStats stats = {};
+        ReplayState state;
+        CaptureReader reader(data, size);
+
+        uint32_t magic = reader.read_u32();
+        uint32_t version = reader.read_u32();
+        if (magic != CAPTURE_MAGIC || version != CAPTURE_VERSION)
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_GRAPHICS, "Not a capture, or unsupported version %u", version);
+            return false;
+        }
+
+        Utils::LinearArena scratch(16 * 1024);
+        bool ok = true;
+        while (!reader.at_end())
+        {
+            size_t record_offset = reader.offset;
+            uint8_t op = reader.read_u8();
+            if (!replay_record(reader, (CaptureOp) op, backend, state, scratch))
+            {
+                LOG_ERROR_CH(LOG_CHANNEL_GRAPHICS, "Malformed capture record %u at offset %zu", op, record_offset);
+                ok = false;
+                break;
+            }
+
+            stats.num_calls[op]++;
+            if (op == CAPTURE_OP_END_FRAME)
+                stats.num_frames++;
+            scratch.reset();
+        }
+
+        // Clean up whatever the capture left alive, dependents first
+        for (ReplayHandleMap::iterator it = state.pipelines.begin(); it != state.pipelines.end(); ++it)
+            for (size_t i = 0; i < it->second.ref_count; i++)
+                backend->destroy_pipeline({it->second.handle});
+        for (ReplayHandleMap::iterator it = state.shaders.begin(); it != state.shaders.end(); ++it)
+            for (size_t i = 0; i < it->second.ref_count; i++)
+                backend->destroy_shader({it->second.handle});
+        for (ReplayHandleMap::iterator it = state.textures.begin(); it != state.textures.end(); ++it)
+            for (size_t i = 0; i < it->second.ref_count; i++)
+                backend->destroy_texture({it->second.handle});
+        for (ReplayHandleMap::iterator it = state.index_buffers.begin(); it != state.index_buffers.end(); ++it)
+            for (size_t i = 0; i < it->second.ref_count; i++)
+                backend->destroy_index_buffer({it->second.handle});
+        for (ReplayHandleMap::iterator it = state.vertex_buffers.begin(); it != state.vertex_buffers.end(); ++it)
+            for (size_t i = 0; i < it->second.ref_count; i++)
+                backend->destroy_vertex_buffer({it->second.handle});
+
+        if (out_stats)
+            *out_stats = stats;
+        return ok;
+    }
+}
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include "graphics.h"
+#include "graphics_commands.h"
+#include "utils_memory.h"
+
+namespace Graphics
+{
+    // Capture streams are a header followed by one record per Backend call:
+    // an opcode byte, the config payload, then the handle the call returned
+    // (or was passed, for destroys). Values are written in host byte order,
+    // so captures are only portable between machines of the same endianness.
+    #define CAPTURE_MAGIC 0x50434256u // "VBCP"
+    #define CAPTURE_VERSION 3u
+
+    enum CaptureOp
+    {
+        CAPTURE_OP_CREATE_VERTEX_BUFFER,
+        CAPTURE_OP_DESTROY_VERTEX_BUFFER,
+        CAPTURE_OP_CREATE_INDEX_BUFFER,
+        CAPTURE_OP_DESTROY_INDEX_BUFFER,
+        CAPTURE_OP_CREATE_TEXTURE,
+        CAPTURE_OP_DESTROY_TEXTURE,
+        CAPTURE_OP_CREATE_SHADER,
+        CAPTURE_OP_DESTROY_SHADER,
+        CAPTURE_OP_CREATE_PIPELINE,
+        CAPTURE_OP_DESTROY_PIPELINE,
+        CAPTURE_OP_END_FRAME,
+        CAPTURE_OP_SUBMIT,
+        CAPTURE_OP_UPDATE_VERTEX_BUFFER,
+        CAPTURE_OP_UPDATE_INDEX_BUFFER,
+        CAPTURE_OP_COUNT
+    };
+
+    struct CaptureWriter
+    {
+        std::vector<uint8_t> bytes;
+
+        void write_u8(uint8_t value) { bytes.push_back(value); }
+        void write_u32(uint32_t value) { write_bytes(&value, sizeof(value)); }
+        void write_u64(uint64_t value) { write_bytes(&value, sizeof(value)); }
+        void write_bytes(const void* data, size_t size);
+        // Null data is recorded as such, so it replays as null
+        void write_blob(const void* data, size_t size);
+        void write_string(const char* string);
+    };
+
+    // Reads past the end of the stream return zeroes and set failed, so
+    // callers can check once per record instead of after every read
+    struct CaptureReader
+    {
+        const uint8_t* data;
+        size_t size;
+        size_t offset;
+        bool failed;
+
+        CaptureReader(const uint8_t* in_data, size_t in_size);
+
+        bool at_end() const { return offset >= size; }
+        uint8_t read_u8();
+        uint32_t read_u32();
+        uint64_t read_u64();
+        bool read_bytes(void* out_data, size_t size);
+        // Returned pointers point into the stream, or into the arena for
+        // strings, and stay valid as long as both do
+        const void* read_blob(size_t* out_size);
+        const char* read_string(Utils::LinearArena& arena);
+    };
+
+    // Config serialization, shared with anything else that wants to persist
+    // configs. Shader handles in pipeline configs are written as raw handle
+    // bits; it's up to the reader to map them to live handles.
+    void write_vertex_buffer_config(CaptureWriter& writer, const VertexBufferConfig& config);
+    void write_index_buffer_config(CaptureWriter& writer, const IndexBufferConfig& config);
+    void write_texture_config(CaptureWriter& writer, const TextureConfig& config);
+    void write_shader_config(CaptureWriter& writer, const ShaderConfig& config);
+    void write_pipeline_config(CaptureWriter& writer, const PipelineConfig& config);
+    // Variable sized arrays are allocated out of arena
+    bool read_vertex_buffer_config(CaptureReader& reader, VertexBufferConfig* out_config);
+    bool read_index_buffer_config(CaptureReader& reader, IndexBufferConfig* out_config);
+    bool read_texture_config(CaptureReader& reader, TextureConfig* out_config);
+    bool read_shader_config(CaptureReader& reader, Utils::LinearArena& arena, ShaderConfig* out_config);
+    bool read_pipeline_config(CaptureReader& reader, Utils::LinearArena& arena, PipelineConfig* out_config);
+
+    // Decorator that forwards every call to another backend and records it
+    class CaptureBackend : public Backend
+    {
+    public:
+        // Doesn't take ownership of backend
+        CaptureBackend(Backend* backend);
+        ~CaptureBackend();
+
+        VertexBuffer create_vertex_buffer(const VertexBufferConfig& config);
+        void destroy_vertex_buffer(const VertexBuffer& buffer);
+        IndexBuffer create_index_buffer(const IndexBufferConfig& config);
+        void destroy_index_buffer(const IndexBuffer& buffer);
+        void update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size);
+        void update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices);
+        Texture create_texture(const TextureConfig& config);
+        void destroy_texture(const Texture& texture);
+        Shader create_shader(const ShaderConfig& config);
+        void destroy_shader(const Shader& shader);
+        bool is_shader_ready(const Shader& shader);
+        Pipeline create_pipeline(const PipelineConfig& config);
+        void destroy_pipeline(const Pipeline& pipeline);
+        void submit(CommandBuffer** command_buffers, size_t num_command_buffers);
+        void end_frame();
+
+        const std::vector<uint8_t>& capture() const { return m_writer.bytes; }
+        bool write_to_file(const char* path) const;
+    private:
+        void write_handle(const Utils::WeakRef& handle);
+
+        Backend* m_backend;
+        CaptureWriter m_writer;
+        // Bytes per index of each live index buffer, for sizing updates
+        std::unordered_map<uint64_t, size_t> m_index_bytes;
+    };
+
+    struct ReplayStats
+    {
+        size_t num_calls[CAPTURE_OP_COUNT];
+        size_t num_frames;
+    };
+
+    // Feeds a capture into backend. Returns false if the stream is malformed,
+    // after replaying everything up to the bad record. Resources the capture
+    // never destroyed are destroyed at the end so backends can be reused.
+    bool replay_capture(const uint8_t* data, size_t size, Backend* backend, ReplayStats* out_stats);
+}
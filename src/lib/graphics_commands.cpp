@@ -0,0 +1,105 @@
+#include "graphics_commands.h"
+
+namespace Graphics
+{
+    Utils::PoolAllocator& default_command_block_pool()
+    {
+        static Utils::PoolAllocator pool(GRAPHICS_COMMAND_BLOCK_SIZE, GRAPHICS_COMMAND_BLOCKS_PER_PAGE);
+        return pool;
+    }
+
+    CommandBuffer::CommandBuffer(Utils::PoolAllocator& block_pool)
+        : m_block_pool(block_pool)
+        , m_first_block(nullptr)
+        , m_current_block(nullptr)
+        , m_current_offset(0)
+        , m_first(nullptr)
+        , m_last(nullptr)
+        , m_num_commands(0)
+    {
+    }
+
+    CommandBuffer::~CommandBuffer()
+    {
+        Block* block = m_first_block;
+        while (block)
+        {
+            Block* next = block->next;
+            m_block_pool.free(block);
+            block = next;
+        }
+    }
+
+    void* CommandBuffer::allocate(size_t size, size_t alignment)
+    {
+        // Pool elements are aligned, so aligning the offset aligns the address
+        size_t block_size = m_block_pool.get_element_size();
+        size_t offset = (m_current_offset + alignment - 1) & ~(alignment - 1);
+        if (!m_current_block || offset + size > block_size)
+        {
+            offset = (sizeof(Block) + alignment - 1) & ~(alignment - 1);
+            ASSERT_MSG(offset + size <= block_size, "%zu byte command doesn't fit in a %zu byte block", size, block_size);
+
+            // Blocks kept from before the last reset go first
+            Block* next = m_current_block ? m_current_block->next : m_first_block;
+            if (!next)
+            {
+                next = (Block*) m_block_pool.allocate();
+                next->next = nullptr;
+                if (m_current_block)
+                    m_current_block->next = next;
+                else
+                    m_first_block = next;
+            }
+            m_current_block = next;
+        }
+
+        m_current_offset = offset + size;
+        return (uint8_t*) m_current_block + offset;
+    }
+
+    void CommandBuffer::bind_pipeline(const Pipeline& pipeline)
+    {
+        BindPipelineCommand* command = push<BindPipelineCommand>(COMMAND_BIND_PIPELINE);
+        command->pipeline = pipeline;
+    }
+
+    void CommandBuffer::bind_vertex_buffer(size_t binding, const VertexBuffer& buffer, size_t offset)
+    {
+        ASSERT_MSG(binding < GRAPHICS_PIPELINE_MAX_BUFFERS, "Binding %zu exceeds max buffers %d", binding, GRAPHICS_PIPELINE_MAX_BUFFERS);
+        BindVertexBufferCommand* command = push<BindVertexBufferCommand>(COMMAND_BIND_VERTEX_BUFFER);
+        command->buffer = buffer;
+        command->binding = binding;
+        command->offset = offset;
+    }
+
+    void CommandBuffer::bind_index_buffer(const IndexBuffer& buffer, size_t offset)
+    {
+        BindIndexBufferCommand* command = push<BindIndexBufferCommand>(COMMAND_BIND_INDEX_BUFFER);
+        command->buffer = buffer;
+        command->offset = offset;
+    }
+
+    void CommandBuffer::draw(size_t num_vertices, size_t first_vertex)
+    {
+        DrawCommand* command = push<DrawCommand>(COMMAND_DRAW);
+        command->num_vertices = num_vertices;
+        command->first_vertex = first_vertex;
+    }
+
+    void CommandBuffer::draw_indexed(size_t num_indices, size_t first_index)
+    {
+        DrawIndexedCommand* command = push<DrawIndexedCommand>(COMMAND_DRAW_INDEXED);
+        command->num_indices = num_indices;
+        command->first_index = first_index;
+    }
+
+    void CommandBuffer::reset()
+    {
+        m_current_block = nullptr;
+        m_current_offset = 0;
+        m_first = nullptr;
+        m_last = nullptr;
+        m_num_commands = 0;
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "graphics.h"
+#include "utils_memory.h"
+
+namespace Graphics
+{
+    #define GRAPHICS_COMMAND_BLOCK_SIZE (16 * 1024)
+    #define GRAPHICS_COMMAND_BLOCKS_PER_PAGE 16
+
+    enum CommandType
+    {
+        COMMAND_BIND_PIPELINE,
+        COMMAND_BIND_VERTEX_BUFFER,
+        COMMAND_BIND_INDEX_BUFFER,
+        COMMAND_DRAW,
+        COMMAND_DRAW_INDEXED
+    };
+
+    // Commands are variable sized and chained through next, all out of the
+    // command buffer's blocks. Every command struct starts with a Command so a
+    // Command* can be cast to the concrete type once you've checked type.
+    struct Command
+    {
+        CommandType type;
+        Command* next;
+    };
+
+    struct BindPipelineCommand
+    {
+        Command header;
+        Pipeline pipeline;
+    };
+
+    struct BindVertexBufferCommand
+    {
+        Command header;
+        VertexBuffer buffer;
+        size_t binding;
+        size_t offset; // In bytes
+    };
+
+    struct BindIndexBufferCommand
+    {
+        Command header;
+        IndexBuffer buffer;
+        size_t offset; // In bytes
+    };
+
+    struct DrawCommand
+    {
+        Command header;
+        size_t num_vertices;
+        size_t first_vertex;
+    };
+
+    struct DrawIndexedCommand
+    {
+        Command header;
+        size_t num_indices;
+        size_t first_index;
+    };
+
+    // Command memory comes in fixed size blocks from a pool, and goes back to
+    // it when the command buffer is destroyed. Command buffers made and thrown
+    // away every frame then stop touching the heap once the pool has grown to
+    // fit. Buffers that aren't given a pool of their own share this one.
+    Utils::PoolAllocator& default_command_block_pool();
+
+    // Records draws and binds without touching the backend, so any thread can
+    // fill one in. A command buffer must only be used by one thread at a time,
+    // and not be reset or recorded into while it's being submitted. Handles
+    // are only resolved at submit time, on the thread that owns the backend.
+    class CommandBuffer
+    {
+    public:
+        CommandBuffer(Utils::PoolAllocator& block_pool = default_command_block_pool());
+        ~CommandBuffer();
+
+        CommandBuffer(const CommandBuffer&) = delete;
+        CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+        void bind_pipeline(const Pipeline& pipeline);
+        void bind_vertex_buffer(size_t binding, const VertexBuffer& buffer, size_t offset = 0);
+        void bind_index_buffer(const IndexBuffer& buffer, size_t offset = 0);
+        void draw(size_t num_vertices, size_t first_vertex = 0);
+        void draw_indexed(size_t num_indices, size_t first_index = 0);
+
+        // Drops all commands. Keeps the memory, so re-recording every frame
+        // doesn't allocate once the buffer has grown to fit.
+        void reset();
+
+        const Command* first_command() const { return m_first; }
+        size_t num_commands() const { return m_num_commands; }
+    private:
+        // Blocks are chained through their first bytes, commands follow
+        struct Block
+        {
+            Block* next;
+        };
+
+        template <typename T>
+        T* push(CommandType type)
+        {
+            T* command = (T*) allocate(sizeof(T), alignof(T));
+            command->header.type = type;
+            command->header.next = nullptr;
+            if (m_last)
+                m_last->next = &command->header;
+            else
+                m_first = &command->header;
+            m_last = &command->header;
+            m_num_commands++;
+            return command;
+        }
+
+        void* allocate(size_t size, size_t alignment);
+
+        Utils::PoolAllocator& m_block_pool;
+        // Blocks are kept across resets, m_current_block is null until the
+        // first command after one
+        Block* m_first_block;
+        Block* m_current_block;
+        size_t m_current_offset; // From the start of m_current_block
+        Command* m_first;
+        Command* m_last;
+        size_t m_num_commands;
+    };
+}
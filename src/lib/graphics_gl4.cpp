@@ -1,5 +1,7 @@
 #pragma once
 #include "graphics_gl4.h"
+#include <cstring>
+#include "utils_profile.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // GL4 implementation
@@ -81,43 +83,65 @@ namespace Graphics
             case GEOMETRY_SHADER: return GL_GEOMETRY_SHADER;
             case TESSELATION_CONTROL_SHADER: return GL_TESS_CONTROL_SHADER;
             case TESSELATION_EVALUATION_SHADER: return GL_TESS_EVALUATION_SHADER;
+            case FRAGMENT_SHADER: return GL_FRAGMENT_SHADER;
             case COMPUTE_SHADER: return GL_COMPUTE_SHADER;
             default: RUNTIME_ERROR("Unknown shader stage type %d", stage);
         }
     }
 
+    // Info logs come out of the scratch arena rather than the heap
+    static GLchar* gl_alloc_info_log(Utils::LinearArena& scratch, GLint length)
+    {
+        GLchar* log = scratch.allocate_array<GLchar>(length + 1);
+        log[0] = '\0';
+        return log;
+    }
+
+    // Compiling and linking only kick the work off. Querying status waits for
+    // it, so that's left to gl_check_shader/gl_check_program, as late as
+    // possible, which lets the driver compile in the background.
     static GLuint gl_compile_shader(const char* source, GLenum shader_type)
     {
         GLuint new_shader = glCreateShader(shader_type); 
         int length = strlen(source);
         glShaderSource(new_shader, 1, &source, &length);
-                    
+        glCompileShader(new_shader);
+        return new_shader;
+    }
+
+    static void gl_check_shader(GLuint shader, Utils::LinearArena& scratch)
+    {
         GLint is_compiled = 0;
-        glGetShaderiv(new_shader, GL_COMPILE_STATUS, &is_compiled);
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &is_compiled);
         if(is_compiled == GL_FALSE)
         {
             GLint max_length = 0;
-            glGetShaderiv(new_shader, GL_INFO_LOG_LENGTH, &max_length);
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_length);
 
-            std::vector<GLchar> error_log(max_length);
-            glGetShaderInfoLog(new_shader, max_length, &max_length, &error_log[0]);
+            GLchar* error_log = gl_alloc_info_log(scratch, max_length);
+            glGetShaderInfoLog(shader, max_length, &max_length, error_log);
 
-            glDeleteShader(new_shader);
-            RUNTIME_ERROR("Shader compilation error: %s", &error_log[0])
+            glDeleteShader(shader);
+            RUNTIME_ERROR("Shader compilation error: %s", error_log)
         }
-        return new_shader;
     }
 
-    static GLuint gl_link_shader(GLuint* shaders, size_t num_shaders)
+    static GLuint gl_link_shader(GLuint* shaders, size_t num_shaders, bool retrievable)
     {
         GLuint program = glCreateProgram();
         glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        if (retrievable)
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
         for (size_t i = 0; i < num_shaders; i++)
             glAttachShader(program, shaders[i]);
         
         glLinkProgram(program);
+        return program;
+    }
 
+    static void gl_check_program(GLuint program, Utils::LinearArena& scratch)
+    {
         GLint is_linked = 0;
         glGetProgramiv(program, GL_LINK_STATUS, (int*) &is_linked);
         if (is_linked == GL_FALSE)
@@ -125,21 +149,16 @@ namespace Graphics
             GLint max_length = 0;
             glGetProgramiv(program, GL_INFO_LOG_LENGTH, &max_length);
 
-            std::vector<GLchar> error_log(max_length);
-            glGetProgramInfoLog(program, max_length, &max_length, &error_log[0]);
+            GLchar* error_log = gl_alloc_info_log(scratch, max_length);
+            glGetProgramInfoLog(program, max_length, &max_length, error_log);
             
             glDeleteProgram(program);
             
-            RUNTIME_ERROR("Shader linking error: %s", &error_log[0]);
+            RUNTIME_ERROR("Shader linking error: %s", error_log);
         }
-
-        for (size_t i = 0; i < num_shaders; i++)
-            glDetachShader(program, shaders[i]);
-
-        return program;
     }
 
-    static GLuint gl_create_shader_pipeline(GL4Shader* shaders, size_t num_shaders)
+    static GLuint gl_create_shader_pipeline(GL4Shader* shaders, size_t num_shaders, Utils::LinearArena& scratch)
     {
         GLuint pipeline;
         glGenProgramPipelines(1, &pipeline);
@@ -158,12 +177,12 @@ namespace Graphics
             GLint max_length = 0;
             glGetProgramPipelineiv(pipeline, GL_INFO_LOG_LENGTH, &max_length);
 
-            std::vector<GLchar> error_log(max_length);
-            glGetProgramPipelineInfoLog(pipeline, max_length, &max_length, &error_log[0]);
+            GLchar* error_log = gl_alloc_info_log(scratch, max_length);
+            glGetProgramPipelineInfoLog(pipeline, max_length, &max_length, error_log);
             
             glDeleteProgramPipelines(1, &pipeline);
             
-            RUNTIME_ERROR("Shader linking error: %s", &error_log[0]);
+            RUNTIME_ERROR("Shader linking error: %s", error_log);
         }
 
         return pipeline;
@@ -179,6 +198,33 @@ namespace Graphics
         }
     }
 
+    static GLenum get_gl_buffer_usage(BufferUsage usage)
+    {
+        switch (usage)
+        {
+            case BUFFER_USAGE_STATIC: return GL_STATIC_DRAW;
+            case BUFFER_USAGE_DYNAMIC: return GL_DYNAMIC_DRAW;
+            case BUFFER_USAGE_STREAM: return GL_STREAM_DRAW;
+            default: RUNTIME_ERROR("Unknown buffer usage %d", usage);
+        }
+    }
+
+    GL4UploadMethod get_gl_upload_method(BufferUsage usage, size_t offset, size_t size, size_t buffer_size, bool has_upload_ring)
+    {
+        // Static buffers shouldn't be updated often enough for this to matter
+        if (usage == BUFFER_USAGE_STATIC)
+            return GL4_UPLOAD_SUB_DATA;
+        // Rewriting all of it means nothing has to be kept, so new storage
+        // can be handed out instead of waiting on the GPU. The ring does that
+        // without going through the driver at all.
+        if (offset == 0 && size == buffer_size)
+            return usage == BUFFER_USAGE_STREAM && has_upload_ring ? GL4_UPLOAD_RING : GL4_UPLOAD_ORPHAN;
+        // Streamed data is big and touched once, so skip the driver's copy
+        if (usage == BUFFER_USAGE_STREAM)
+            return GL4_UPLOAD_MAP_INVALIDATE;
+        return GL4_UPLOAD_SUB_DATA;
+    }
+
     static void get_gl_vertex_attribute(GL4VertexAttribute* out_attribute, const VertexAttributeConfig* attribute)
     {
         out_attribute->binding = attribute->binding;
@@ -187,36 +233,125 @@ namespace Graphics
         out_attribute->type = get_gl_type_enum(data_type_for_attribute_type(attribute->type, &(out_attribute->size)));
     }
 
-    static void get_gl_vertex_format(GL4VertexFormat* format, VertexAttributeConfig* attributes, size_t num_attributes)
+    void get_gl_vertex_format(GL4VertexFormat* format, const VertexAttributeConfig* attributes, size_t num_attributes)
     {
         format->stride = 0;
         format->num_attributes = num_attributes;
         for (size_t i = 0; i < num_attributes; i++)
         {
             get_gl_vertex_attribute(&(format->attributes[i]), &attributes[i]);
+            // Attributes are packed in the order they're given
+            format->attributes[i].offset = format->stride;
             format->stride += format->attributes[i].size * get_gl_type_bytes(format->attributes[i].type);
         }
     }
 
+    uint64_t hash_gl_vertex_format(const GL4VertexFormat& format)
+    {
+        uint64_t hash = Utils::hash_fnv1a_u64(format.num_attributes);
+        hash = Utils::hash_fnv1a_u64(format.stride, hash);
+        for (size_t i = 0; i < format.num_attributes; i++)
+        {
+            const GL4VertexAttribute& attribute = format.attributes[i];
+            hash = Utils::hash_fnv1a_u64(attribute.binding, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.location, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.size, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.type, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.normalized, hash);
+            hash = Utils::hash_fnv1a_u64(attribute.offset, hash);
+        }
+        return hash;
+    }
+
+    bool gl_vertex_formats_match(const GL4VertexFormat& a, const GL4VertexFormat& b)
+    {
+        if (a.num_attributes != b.num_attributes || a.stride != b.stride)
+            return false;
+        for (size_t i = 0; i < a.num_attributes; i++)
+        {
+            const GL4VertexAttribute& attribute_a = a.attributes[i];
+            const GL4VertexAttribute& attribute_b = b.attributes[i];
+            if (attribute_a.binding != attribute_b.binding
+                || attribute_a.location != attribute_b.location
+                || attribute_a.size != attribute_b.size
+                || attribute_a.type != attribute_b.type
+                || attribute_a.normalized != attribute_b.normalized
+                || attribute_a.offset != attribute_b.offset)
+                return false;
+        }
+        return true;
+    }
+
     GL4Backend::GL4Backend(const BackendConfig& config)
         : m_buffers(config.num_prealloc_buffers)
         , m_textures(config.num_prealloc_textures)
         , m_shaders(config.num_prealloc_shaders)
         , m_pipelines(config.num_prealloc_pipelines)
+        , m_retire_queues(config.num_frames_in_flight + 1)
+        , m_frame_index(0)
+        , m_frame_arena(GL4_FRAME_ARENA_BLOCK_SIZE)
+        , m_bound_pipeline()
+        , m_bound_stride(0)
+        , m_bound_vertex_buffer_mask(0)
+        , m_bound_index_buffer(0)
+        , m_bound_index_type(GL_UNSIGNED_INT)
+        , m_bound_index_offset(0)
+        , m_last_frame_state_stats()
+        , m_upload_ring_size(config.upload_ring_size)
+        , m_gl_proc_loader(config.gl_proc_loader)
+        , m_extensions_checked(false)
+        , m_parallel_shader_compile(false)
     {
+        m_program_cache.init(config.program_cache_dir);
     }
 
     GL4Backend::~GL4Backend()
     {
+        // Anything still alive at this point was leaked by the user. Report it
+        // and clean up after them.
+        if (m_pipelines.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu pipelines still alive at shutdown", m_pipelines.size());
+        if (m_shaders.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu shaders still alive at shutdown", m_shaders.size());
+        if (m_textures.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu textures still alive at shutdown", m_textures.size());
+        if (m_buffers.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu buffers still alive at shutdown", m_buffers.size());
+
+        m_pipelines.for_each([](const Utils::WeakRef&, GL4Pipeline& pipeline) {
+            glDeleteProgramPipelines(1, &(pipeline.shader_pipeline));
+        });
+        m_shaders.for_each([](const Utils::WeakRef&, GL4Shader& shader) {
+            for (size_t i = 0; i < shader.num_stages; i++)
+                glDeleteShader(shader.stages[i]);
+            glDeleteProgram(shader.program);
+        });
+        m_textures.for_each([](const Utils::WeakRef&, GLuint& texture) {
+            glDeleteTextures(1, &texture);
+        });
+        m_buffers.for_each([](const Utils::WeakRef&, GL4Buffer& buffer) {
+            glDeleteBuffers(1, &(buffer.buffer));
+        });
+
+        for (size_t i = 0; i < m_retire_queues.size(); i++)
+            flush_retire_queue(m_retire_queues[i]);
+        m_upload_ring.release(m_state_cache);
+
+        for (size_t i = 0; i < m_vertex_formats.size(); i++)
+        {
+            if (m_vertex_formats[i].ref_count > 0)
+                glDeleteVertexArrays(1, &(m_vertex_formats[i].vertex_array));
+        }
     }
 
     VertexBuffer GL4Backend::create_vertex_buffer(const VertexBufferConfig& config)
     {
         GLuint new_buffer;
         glGenBuffers(1, &new_buffer);
-        glBindBuffer(GL_ARRAY_BUFFER, new_buffer);
-        glBufferData(GL_ARRAY_BUFFER, config.size, config.data, GL_STATIC_DRAW);
-        return {m_buffers.add(new_buffer)};
+        m_state_cache.bind_buffer(GL_ARRAY_BUFFER, new_buffer);
+        glBufferData(GL_ARRAY_BUFFER, config.size, config.data, get_gl_buffer_usage(config.usage));
+        GL4Buffer result = { new_buffer, GL_NONE, config.size, config.usage, new_buffer, 0 };
+        return {m_buffers.add(result, VertexBuffer::type)};
     }
 
     void GL4Backend::destroy_vertex_buffer(const VertexBuffer& buffer)
@@ -228,9 +363,16 @@ namespace Graphics
     {
         GLuint new_buffer;
         glGenBuffers(1, &new_buffer);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, new_buffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, get_gl_type_bytes(get_gl_type_enum(config.type)) * config.num_indices, config.data, GL_STATIC_DRAW);
-        return {m_buffers.add(new_buffer)};
+        GLenum index_type = get_gl_type_enum(config.type);
+        ASSERT_MSG(index_type == GL_UNSIGNED_BYTE || index_type == GL_UNSIGNED_SHORT || index_type == GL_UNSIGNED_INT,
+            "Index buffers must be unsigned bytes, shorts or ints");
+        // Don't disturb the element array binding of the VAO used for draws
+        m_state_cache.bind_vertex_array(0);
+        m_state_cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, new_buffer);
+        size_t size = get_gl_type_bytes(index_type) * config.num_indices;
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, config.data, get_gl_buffer_usage(config.usage));
+        GL4Buffer result = { new_buffer, index_type, size, config.usage, new_buffer, 0 };
+        return {m_buffers.add(result, IndexBuffer::type)};
     }
 
     void GL4Backend::destroy_index_buffer(const IndexBuffer& buffer)
@@ -238,6 +380,144 @@ namespace Graphics
         destroy_buffer(buffer.handle);
     }
 
+    void GL4Backend::update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size)
+    {
+        update_buffer(buffer.handle, GL_ARRAY_BUFFER, offset, data, size);
+    }
+
+    void GL4Backend::update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices)
+    {
+        GL4Buffer* buffer_obj = m_buffers.get(buffer.handle);
+        if (!buffer_obj)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid index buffer handle")
+            return;
+        }
+        size_t index_bytes = get_gl_type_bytes(buffer_obj->index_type);
+        update_buffer(buffer.handle, GL_ELEMENT_ARRAY_BUFFER, first_index * index_bytes, data, num_indices * index_bytes);
+    }
+
+    void GL4Backend::update_buffer(const Utils::WeakRef& handle, GLenum target, size_t offset, const void* data, size_t size)
+    {
+        PROFILE_SCOPE("GL4Backend::update_buffer");
+        GL4Buffer* buffer = m_buffers.get(handle);
+        if (!buffer)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid buffer handle")
+            return;
+        }
+        ASSERT_MSG(offset <= buffer->size && size <= buffer->size - offset,
+            "Update of %zu bytes at %zu overruns a %zu byte buffer", size, offset, buffer->size);
+        if (size == 0)
+            return;
+
+        // Needs a context, which the constructor can't count on
+        if (!m_extensions_checked)
+            check_extensions();
+
+        GL4UploadMethod method = get_gl_upload_method(buffer->usage, offset, size, buffer->size, m_upload_ring.enabled());
+        if (method == GL4_UPLOAD_RING)
+        {
+            size_t ring_offset;
+            void* mapped = m_upload_ring.allocate(size, &ring_offset);
+            if (mapped)
+            {
+                memcpy(mapped, data, size);
+                if (buffer->storage == buffer->buffer)
+                    m_ring_resident_buffers.push_back(handle);
+                move_buffer_storage(*buffer, m_upload_ring.buffer(), ring_offset);
+                return;
+            }
+            method = GL4_UPLOAD_ORPHAN;
+        }
+
+        // Everything else writes the buffer's own storage. Unless it's all
+        // being rewritten, the rest of the contents come back from the ring.
+        if (buffer->storage != buffer->buffer)
+        {
+            if (method == GL4_UPLOAD_ORPHAN)
+                move_buffer_storage(*buffer, buffer->buffer, 0);
+            else
+                copy_buffer_home(*buffer);
+        }
+
+        // Same as creation, don't disturb the VAO used for draws. submit puts
+        // the right one back.
+        if (target == GL_ELEMENT_ARRAY_BUFFER)
+            m_state_cache.bind_vertex_array(0);
+        m_state_cache.bind_buffer(target, buffer->buffer);
+
+        switch (method)
+        {
+            case GL4_UPLOAD_SUB_DATA:
+                glBufferSubData(target, offset, size, data);
+                break;
+            case GL4_UPLOAD_ORPHAN:
+                glBufferData(target, size, data, get_gl_buffer_usage(buffer->usage));
+                break;
+            case GL4_UPLOAD_MAP_INVALIDATE:
+            {
+                void* mapped = glMapBufferRange(target, offset, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+                if (!mapped)
+                {
+                    // Mapping can fail for driver reasons; the copy still works
+                    glBufferSubData(target, offset, size, data);
+                    break;
+                }
+                memcpy(mapped, data, size);
+                // False means the storage was lost while mapped and has to be
+                // written again
+                if (glUnmapBuffer(target) == GL_FALSE)
+                    glBufferSubData(target, offset, size, data);
+                break;
+            }
+            case GL4_UPLOAD_RING:
+                RUNTIME_ERROR("Ring uploads are handled above");
+        }
+    }
+
+    // Whether a binding reads from the buffer's current contents
+    static bool is_bound_to_storage(GLuint bound_buffer, size_t bound_offset, const GL4Buffer& buffer)
+    {
+        return bound_buffer == buffer.storage
+            && bound_offset >= buffer.storage_offset && bound_offset - buffer.storage_offset < buffer.size;
+    }
+
+    // Points draws at wherever the buffer's contents live now, including
+    // the bindings submit will reapply
+    void GL4Backend::move_buffer_storage(GL4Buffer& buffer, GLuint storage, size_t storage_offset)
+    {
+        for (uint32_t mask = m_bound_vertex_buffer_mask; mask; mask &= mask - 1)
+        {
+            uint32_t binding = Utils::lowest_bit_index(mask);
+            size_t bound_offset = m_bound_vertex_buffers[binding].offset;
+            if (is_bound_to_storage(m_bound_vertex_buffers[binding].buffer, bound_offset, buffer))
+            {
+                m_bound_vertex_buffers[binding].buffer = storage;
+                m_bound_vertex_buffers[binding].offset = bound_offset - buffer.storage_offset + storage_offset;
+            }
+        }
+        if (is_bound_to_storage(m_bound_index_buffer, m_bound_index_offset, buffer))
+        {
+            m_bound_index_buffer = storage;
+            m_bound_index_offset = m_bound_index_offset - buffer.storage_offset + storage_offset;
+        }
+
+        buffer.storage = storage;
+        buffer.storage_offset = storage_offset;
+    }
+
+    // Brings a buffer's contents back from the ring to its own storage. The
+    // copy happens on the GPU, in order with the draws around it.
+    void GL4Backend::copy_buffer_home(GL4Buffer& buffer)
+    {
+        // The state cache doesn't track the copy targets
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer.storage);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, buffer.buffer);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, buffer.storage_offset, 0, buffer.size);
+        move_buffer_storage(buffer, buffer.buffer, 0);
+    }
+
     Texture GL4Backend::create_texture(const TextureConfig& config)
     {
         // TODO
@@ -250,9 +530,34 @@ namespace Graphics
 
     Shader GL4Backend::create_shader(const ShaderConfig& config)
     {
+        PROFILE_SCOPE("GL4Backend::create_shader");
         ASSERT_MSG(config.num_stages > 0, "Cannot create shader with zero stages");
+        ASSERT_MSG(config.num_stages <= GRAPHICS_MAX_SHADER_STAGES, "Too many shader stages: %zu", config.num_stages);
+
+        uint64_t config_hash = hash_shader_config(config);
+        std::unordered_map<uint64_t, ShaderCacheEntry>::iterator cached = m_shader_cache.find(config_hash);
+        bool add_to_cache = cached == m_shader_cache.end();
+        if (!add_to_cache && shader_config_matches(cached->second.config, config))
+        {
+            GL4Shader* shader_obj = m_shaders.get(cached->second.shader.handle);
+            ASSERT_MSG(shader_obj, "Shader cache holds a dead shader");
+            shader_obj->ref_count++;
+            return cached->second.shader;
+        }
+        // Otherwise different sources hashed the same. They get a shader of
+        // their own, which stays out of the cache.
+
+        // Needs a context, which the constructor can't count on
+        if (!m_extensions_checked)
+            check_extensions();
 
         GL4Shader result;
+        result.config_hash = config_hash;
+        result.ref_count = 1;
+        result.pending = false;
+        result.store_in_cache = false;
+        result.cache_key = 0;
+        result.num_stages = 0;
 
         // Create stage bitfield
         ShaderStageBitfield stage_bitfield = 0;
@@ -262,19 +567,49 @@ namespace Graphics
         // Convert stage bitfield to GLbitfield
         result.stage_bitfield = get_gl_shader_stage_bitfield(stage_bitfield);
         
-        // Compile shaders
-        std::vector<GLuint> shader_stages;
+        Utils::ScratchScope scratch(m_frame_arena);
+
+        // Warm starts skip GLSL compilation entirely
+        bool use_cache = m_program_cache.enabled();
+        uint64_t cache_key = 0;
+        result.program = 0;
+        if (use_cache)
+        {
+            cache_key = m_program_cache.program_key(config);
+            result.program = m_program_cache.load_program(cache_key, m_frame_arena);
+        }
+
+        if (result.program)
+        {
+            LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Loaded program %u from cache, stage bits 0x%x", result.program, result.stage_bitfield);
+            Shader shader = {m_shaders.add(result, Shader::type)};
+            if (add_to_cache)
+                add_shader_to_cache(config, config_hash, shader);
+            return shader;
+        }
+
+        // Compile and link without waiting; finish_shader picks up the results
+        result.num_stages = config.num_stages;
         for (size_t i = 0; i < config.num_stages; i++)
-            shader_stages.push_back(gl_compile_shader(config.shader_stages[i].source, get_gl_shader_stage_type(config.shader_stages[i].stage)));
-        
-        // Link shaders
-        result.program = gl_link_shader(&shader_stages[0], shader_stages.size());
+            result.stages[i] = gl_compile_shader(config.shader_stages[i].source, get_gl_shader_stage_type(config.shader_stages[i].stage));
+        result.program = gl_link_shader(result.stages, config.num_stages, use_cache);
+        result.pending = true;
+        result.store_in_cache = use_cache;
+        result.cache_key = cache_key;
 
-        // Clean up shader objects
-        for (size_t i = 0; i < shader_stages.size(); i++)
-            glDeleteShader(shader_stages[i]);
+        LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Issued program %u with %zu stages, stage bits 0x%x", result.program, config.num_stages, result.stage_bitfield);
 
-        return {m_shaders.add(result)};
+        Shader shader = {m_shaders.add(result, Shader::type)};
+        if (add_to_cache)
+            add_shader_to_cache(config, config_hash, shader);
+        return shader;
+    }
+
+    void GL4Backend::add_shader_to_cache(const ShaderConfig& config, uint64_t config_hash, const Shader& shader)
+    {
+        ShaderCacheEntry& entry = m_shader_cache[config_hash];
+        entry.shader = shader;
+        make_shader_config_key(config, &entry.config);
     }
 
     void GL4Backend::destroy_shader(const Shader& shader)
@@ -282,19 +617,136 @@ namespace Graphics
         GL4Shader* shader_obj = m_shaders.get(shader.handle);
         if (!shader_obj)
         {
-            LOG_WARNING("Invalid shader handle")
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid shader handle")
             return;
         }
 
-        glDeleteProgram(shader_obj->program);
+        if (--shader_obj->ref_count > 0)
+            return;
+
+        std::unordered_map<uint64_t, ShaderCacheEntry>::iterator cached = m_shader_cache.find(shader_obj->config_hash);
+        if (cached != m_shader_cache.end() && cached->second.shader == shader)
+            m_shader_cache.erase(cached);
+        // Attached stages go away along with the program
+        for (size_t i = 0; i < shader_obj->num_stages; i++)
+            glDeleteShader(shader_obj->stages[i]);
+        current_retire_queue().programs.push_back(shader_obj->program);
         m_shaders.remove(shader.handle);
     }
 
+    bool GL4Backend::is_shader_ready(const Shader& shader)
+    {
+        GL4Shader* shader_obj = m_shaders.get(shader.handle);
+        if (!shader_obj)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid shader handle")
+            return false;
+        }
+        if (!shader_obj->pending)
+            return true;
+
+        // Without parallel compile there's no asking without waiting, so
+        // the shader is ready as soon as anyone asks
+        if (m_parallel_shader_compile)
+        {
+            GLint is_complete = GL_FALSE;
+            glGetProgramiv(shader_obj->program, GL4_COMPLETION_STATUS_KHR, &is_complete);
+            if (is_complete == GL_FALSE)
+                return false;
+        }
+        finish_shader(*shader_obj);
+        return true;
+    }
+
+    void GL4Backend::finish_shader(GL4Shader& shader)
+    {
+        PROFILE_SCOPE("GL4Backend::finish_shader");
+        Utils::ScratchScope scratch(m_frame_arena);
+
+        // Stage errors say more than the link error they cause
+        for (size_t i = 0; i < shader.num_stages; i++)
+            gl_check_shader(shader.stages[i], m_frame_arena);
+        gl_check_program(shader.program, m_frame_arena);
+
+        for (size_t i = 0; i < shader.num_stages; i++)
+        {
+            glDetachShader(shader.program, shader.stages[i]);
+            glDeleteShader(shader.stages[i]);
+        }
+        shader.num_stages = 0;
+        shader.pending = false;
+
+        if (shader.store_in_cache)
+            m_program_cache.store_program(shader.cache_key, shader.program, m_frame_arena);
+
+        LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Finished program %u", shader.program);
+    }
+
+    void GL4Backend::check_extensions()
+    {
+        m_extensions_checked = true;
+
+        bool buffer_storage = false;
+        GLint num_extensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+        for (GLint i = 0; i < num_extensions; i++)
+        {
+            const char* name = (const char*) glGetStringi(GL_EXTENSIONS, i);
+            if (!name)
+                continue;
+            if (strcmp(name, "GL_KHR_parallel_shader_compile") == 0 || strcmp(name, "GL_ARB_parallel_shader_compile") == 0)
+                m_parallel_shader_compile = true;
+            else if (strcmp(name, "GL_ARB_buffer_storage") == 0)
+                buffer_storage = true;
+        }
+
+        if (buffer_storage && m_upload_ring_size > 0 && m_gl_proc_loader)
+        {
+            // One region per frame the GPU can be behind, plus the one we write
+            GL4BufferStorageProc buffer_storage_proc = (GL4BufferStorageProc) m_gl_proc_loader("glBufferStorage");
+            m_upload_ring.init(m_upload_ring_size, m_retire_queues.size(), buffer_storage_proc, m_state_cache);
+        }
+
+        if (!m_parallel_shader_compile)
+            return;
+
+        // Our glad doesn't load extensions. Without the entry point we can
+        // still poll, the driver just picks its own thread count.
+        typedef void (APIENTRYP GL4MaxShaderCompilerThreadsProc)(GLuint count);
+        GL4MaxShaderCompilerThreadsProc max_shader_compiler_threads = nullptr;
+        if (m_gl_proc_loader)
+        {
+            max_shader_compiler_threads = (GL4MaxShaderCompilerThreadsProc) m_gl_proc_loader("glMaxShaderCompilerThreadsKHR");
+            if (!max_shader_compiler_threads)
+                max_shader_compiler_threads = (GL4MaxShaderCompilerThreadsProc) m_gl_proc_loader("glMaxShaderCompilerThreadsARB");
+        }
+        if (max_shader_compiler_threads)
+            max_shader_compiler_threads(GL4_MAX_SHADER_COMPILER_THREADS_ANY);
+
+        LOG_INFO_CH(LOG_CHANNEL_GRAPHICS, "Parallel shader compile enabled");
+    }
+
     Pipeline GL4Backend::create_pipeline(const PipelineConfig& config)
     {
+        PROFILE_SCOPE("GL4Backend::create_pipeline");
         assert_pipeline_config_valid(config);
 
+        uint64_t config_hash = hash_pipeline_config(config);
+        std::unordered_map<uint64_t, PipelineCacheEntry>::iterator cached = m_pipeline_cache.find(config_hash);
+        bool add_to_cache = cached == m_pipeline_cache.end();
+        if (!add_to_cache && pipeline_config_matches(cached->second.config, config))
+        {
+            GL4Pipeline* pipeline_obj = m_pipelines.get(cached->second.pipeline.handle);
+            ASSERT_MSG(pipeline_obj, "Pipeline cache holds a dead pipeline");
+            pipeline_obj->ref_count++;
+            return cached->second.pipeline;
+        }
+        // Otherwise a different config hashed the same. It gets a pipeline of
+        // its own, which stays out of the cache.
+
         GL4Pipeline new_pipeline;
+        new_pipeline.config_hash = config_hash;
+        new_pipeline.ref_count = 1;
 
         // Fill in buffer types
         new_pipeline.num_buffers = config.num_buffers;
@@ -306,23 +758,39 @@ namespace Graphics
         // TODO: Fill in texture types
 
         // Fill in vertex format
-        // TODO: Hash 'n cache vertex formats
-        get_gl_vertex_format(&(new_pipeline.vertex_format), config.vertex_attributes, config.num_attributes);
+        GL4VertexFormat vertex_format;
+        get_gl_vertex_format(&vertex_format, config.vertex_attributes, config.num_attributes);
+        new_pipeline.vertex_format_id = acquire_vertex_format(vertex_format);
+        new_pipeline.stride = vertex_format.stride;
 
         // Create shader pipeline
-        // TODO: Hash 'n cache shader pipelines
-        std::vector<GL4Shader> shaders;
+        Utils::ScratchScope scratch(m_frame_arena);
+        GL4Shader* shaders = scratch.allocate_array<GL4Shader>(config.num_shaders);
         for (size_t i = 0; i < config.num_shaders; i++)
         {
             GL4Shader* shader = m_shaders.get(config.shaders[i].handle);
             ASSERT_MSG(shader, "Shader not found. Did you delete it?");
+            // Programs have to be linked to go in a pipeline, so this is
+            // where unfinished shaders wait
+            if (shader->pending)
+                finish_shader(*shader);
 
             shaders[i] = *shader;
         }
         
-        new_pipeline.shader_pipeline = gl_create_shader_pipeline(&shaders[0], shaders.size());
+        new_pipeline.shader_pipeline = gl_create_shader_pipeline(shaders, config.num_shaders, m_frame_arena);
+
+        LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Created program pipeline %u: %zu shaders, vertex format %u, stride %zu",
+            new_pipeline.shader_pipeline, config.num_shaders, new_pipeline.vertex_format_id, new_pipeline.stride);
 
-        return {m_pipelines.add(new_pipeline)};
+        Pipeline result = {m_pipelines.add(new_pipeline, Pipeline::type)};
+        if (add_to_cache)
+        {
+            PipelineCacheEntry& entry = m_pipeline_cache[config_hash];
+            entry.pipeline = result;
+            make_pipeline_config_key(config, &entry.config);
+        }
+        return result;
     }
 
     void GL4Backend::destroy_pipeline(const Pipeline& pipeline)
@@ -330,24 +798,330 @@ namespace Graphics
         GL4Pipeline* pipeline_obj = m_pipelines.get(pipeline.handle);
         if (!pipeline_obj)
         {
-            LOG_WARNING("Invalid pipeline handle")
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid pipeline handle")
             return;
         }
 
-        glDeleteProgramPipelines(1, &(pipeline_obj->shader_pipeline));
+        if (--pipeline_obj->ref_count > 0)
+            return;
+
+        std::unordered_map<uint64_t, PipelineCacheEntry>::iterator cached = m_pipeline_cache.find(pipeline_obj->config_hash);
+        if (cached != m_pipeline_cache.end() && cached->second.pipeline == pipeline)
+            m_pipeline_cache.erase(cached);
+        if (pipeline == m_bound_pipeline)
+            m_bound_pipeline = Pipeline();
+        release_vertex_format(pipeline_obj->vertex_format_id);
+        current_retire_queue().program_pipelines.push_back(pipeline_obj->shader_pipeline);
         m_pipelines.remove(pipeline.handle);
     }
 
+    void GL4Backend::submit(CommandBuffer** command_buffers, size_t num_command_buffers)
+    {
+        PROFILE_SCOPE("GL4Backend::submit");
+        // Pipeline creation binds new VAOs to bake their formats, so put the
+        // logically bound one back
+        if (m_bound_pipeline != Pipeline())
+        {
+            const GL4Pipeline* bound_pipeline = m_pipelines.get(m_bound_pipeline.handle);
+            if (bound_pipeline)
+                apply_vertex_array_state(*bound_pipeline);
+        }
+
+        for (size_t i = 0; i < num_command_buffers; i++)
+        {
+            for (const Command* command = command_buffers[i]->first_command(); command; command = command->next)
+                execute(command);
+        }
+    }
+
+    void GL4Backend::execute(const Command* command)
+    {
+        switch (command->type)
+        {
+            case COMMAND_BIND_PIPELINE:
+            {
+                const BindPipelineCommand* bind = (const BindPipelineCommand*) command;
+                GL4Pipeline* pipeline = m_pipelines.get(bind->pipeline.handle);
+                if (!pipeline)
+                {
+                    LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid pipeline handle in command buffer");
+                    return;
+                }
+                m_state_cache.bind_program_pipeline(pipeline->shader_pipeline);
+                m_bound_pipeline = bind->pipeline;
+                m_bound_stride = pipeline->stride;
+                apply_vertex_array_state(*pipeline);
+                return;
+            }
+            case COMMAND_BIND_VERTEX_BUFFER:
+            {
+                const BindVertexBufferCommand* bind = (const BindVertexBufferCommand*) command;
+                const GL4Buffer* buffer = m_buffers.get(bind->buffer.handle);
+                if (!buffer || m_bound_pipeline == Pipeline())
+                {
+                    LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid vertex buffer handle, or no pipeline bound for its stride");
+                    return;
+                }
+                size_t offset = buffer->storage_offset + bind->offset;
+                m_state_cache.bind_vertex_buffer(bind->binding, buffer->storage, offset, m_bound_stride);
+                m_bound_vertex_buffers[bind->binding].buffer = buffer->storage;
+                m_bound_vertex_buffers[bind->binding].offset = offset;
+                m_bound_vertex_buffer_mask |= 1u << bind->binding;
+                return;
+            }
+            case COMMAND_BIND_INDEX_BUFFER:
+            {
+                const BindIndexBufferCommand* bind = (const BindIndexBufferCommand*) command;
+                const GL4Buffer* buffer = m_buffers.get(bind->buffer.handle);
+                if (!buffer)
+                {
+                    LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid index buffer handle in command buffer");
+                    return;
+                }
+                m_state_cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, buffer->storage);
+                m_bound_index_buffer = buffer->storage;
+                m_bound_index_type = buffer->index_type;
+                m_bound_index_offset = buffer->storage_offset + bind->offset;
+                return;
+            }
+            case COMMAND_DRAW:
+            {
+                const DrawCommand* draw = (const DrawCommand*) command;
+                if (m_bound_pipeline == Pipeline())
+                    return;
+                glDrawArrays(GL_TRIANGLES, draw->first_vertex, draw->num_vertices);
+                return;
+            }
+            case COMMAND_DRAW_INDEXED:
+            {
+                const DrawIndexedCommand* draw = (const DrawIndexedCommand*) command;
+                if (m_bound_pipeline == Pipeline())
+                    return;
+                // Without an element array buffer GL would read the indices
+                // from client memory at the offset
+                if (m_bound_index_buffer == 0)
+                {
+                    LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Indexed draw with no index buffer bound");
+                    return;
+                }
+                size_t offset = m_bound_index_offset + draw->first_index * get_gl_type_bytes(m_bound_index_type);
+                glDrawElements(GL_TRIANGLES, draw->num_indices, m_bound_index_type, (const void*) offset);
+                return;
+            }
+            default:
+                RUNTIME_ERROR("Unknown command type %d", command->type);
+        }
+    }
+
+    void GL4Backend::apply_vertex_array_state(const GL4Pipeline& pipeline)
+    {
+        m_state_cache.bind_vertex_array(m_vertex_formats[pipeline.vertex_format_id].vertex_array);
+
+        // Both filtered by the state cache unless the VAO actually changed,
+        // or the stride did
+        for (uint32_t mask = m_bound_vertex_buffer_mask; mask; mask &= mask - 1)
+        {
+            GLuint binding = Utils::lowest_bit_index(mask);
+            m_state_cache.bind_vertex_buffer(binding, m_bound_vertex_buffers[binding].buffer, m_bound_vertex_buffers[binding].offset, pipeline.stride);
+        }
+        if (m_bound_index_buffer)
+            m_state_cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, m_bound_index_buffer);
+    }
+
+    uint32_t GL4Backend::acquire_vertex_format(const GL4VertexFormat& format)
+    {
+        uint64_t hash = hash_gl_vertex_format(format);
+        std::unordered_map<uint64_t, uint32_t>::iterator cached = m_vertex_format_ids.find(hash);
+        bool add_to_cache = cached == m_vertex_format_ids.end();
+        if (!add_to_cache && gl_vertex_formats_match(m_vertex_formats[cached->second].format, format))
+        {
+            m_vertex_formats[cached->second].ref_count++;
+            return cached->second;
+        }
+        // Otherwise a different format hashed the same. It gets a VAO of its
+        // own, which stays out of the cache.
+
+        uint32_t id;
+        if (!m_free_vertex_format_ids.empty())
+        {
+            id = m_free_vertex_format_ids.back();
+            m_free_vertex_format_ids.pop_back();
+        }
+        else
+        {
+            id = m_vertex_formats.size();
+            m_vertex_formats.push_back(GL4CachedVertexFormat());
+        }
+
+        GL4CachedVertexFormat& cached_format = m_vertex_formats[id];
+        cached_format.format = format;
+        cached_format.hash = hash;
+        cached_format.ref_count = 1;
+
+        // Bake the format into its own VAO, once
+        glGenVertexArrays(1, &(cached_format.vertex_array));
+        m_state_cache.bind_vertex_array(cached_format.vertex_array);
+        for (size_t i = 0; i < format.num_attributes; i++)
+        {
+            const GL4VertexAttribute& attribute = format.attributes[i];
+            glEnableVertexAttribArray(attribute.location);
+            glVertexAttribFormat(attribute.location, attribute.size, attribute.type, attribute.normalized, attribute.offset);
+            glVertexAttribBinding(attribute.location, attribute.binding);
+        }
+
+        if (add_to_cache)
+            m_vertex_format_ids[hash] = id;
+        LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Created vertex format %u: %zu attributes, stride %zu, VAO %u",
+            id, format.num_attributes, format.stride, cached_format.vertex_array);
+        return id;
+    }
+
+    void GL4Backend::release_vertex_format(uint32_t id)
+    {
+        GL4CachedVertexFormat& cached_format = m_vertex_formats[id];
+        ASSERT_MSG(cached_format.ref_count > 0, "Vertex format %u released too many times", id);
+        if (--cached_format.ref_count > 0)
+            return;
+
+        current_retire_queue().vertex_arrays.push_back(cached_format.vertex_array);
+        std::unordered_map<uint64_t, uint32_t>::iterator cached = m_vertex_format_ids.find(cached_format.hash);
+        if (cached != m_vertex_format_ids.end() && cached->second == id)
+            m_vertex_format_ids.erase(cached);
+        m_free_vertex_format_ids.push_back(id);
+    }
+
+    void GL4Backend::end_frame()
+    {
+        PROFILE_SCOPE("GL4Backend::end_frame");
+        // The queue we're about to refill was retired num_frames_in_flight
+        // frames ago, so nothing in it can still be in use
+        m_frame_index++;
+        flush_retire_queue(current_retire_queue());
+        end_upload_ring_frame();
+
+        m_last_frame_state_stats = m_state_cache.stats();
+        m_state_cache.reset_stats();
+
+        m_frame_arena.reset();
+    }
+
+    void GL4Backend::end_upload_ring_frame()
+    {
+        if (!m_upload_ring.enabled())
+            return;
+        m_upload_ring.end_frame();
+
+        // Buffers that haven't been rewritten since the ring last came
+        // through here would get overwritten by this frame's uploads
+        size_t num_moved = 0;
+        size_t num_kept = 0;
+        for (size_t i = 0; i < m_ring_resident_buffers.size(); i++)
+        {
+            const Utils::WeakRef& handle = m_ring_resident_buffers[i];
+            GL4Buffer* buffer = m_buffers.ref_is_valid(handle) ? m_buffers.get(handle) : nullptr;
+            if (!buffer || buffer->storage != m_upload_ring.buffer())
+                continue;
+            if (m_upload_ring.in_current_region(buffer->storage_offset))
+            {
+                copy_buffer_home(*buffer);
+                num_moved++;
+                continue;
+            }
+            m_ring_resident_buffers[num_kept++] = handle;
+        }
+        m_ring_resident_buffers.resize(num_kept);
+
+        if (num_moved > 0)
+        {
+            // The copies read the region too, so writes have to wait for them
+            m_upload_ring.fence_current_region();
+            LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Moved %zu stream buffers out of the upload ring, they went a whole cycle without updates", num_moved);
+        }
+    }
+
     void GL4Backend::destroy_buffer(const Utils::WeakRef& handle)
     {
-        const GLuint* gl_buffer = m_buffers.get(handle);
+        const GL4Buffer* gl_buffer = m_buffers.get(handle);
         if (!gl_buffer)
         {
-            LOG_WARNING("Invalid buffer handle");
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid buffer handle");
             return;
         }
 
-        glDeleteBuffers(1, gl_buffer);
+        // Bindings into the upload ring point at the ring's name, which
+        // retiring the buffer's own name won't clear
+        if (gl_buffer->storage != gl_buffer->buffer)
+            forget_bound_storage(*gl_buffer);
+        current_retire_queue().buffers.push_back(gl_buffer->buffer);
         m_buffers.remove(handle);
     }
-}
\ No newline at end of file
+
+    GL4RetireQueue& GL4Backend::current_retire_queue()
+    {
+        return m_retire_queues[m_frame_index % m_retire_queues.size()];
+    }
+
+    void GL4Backend::flush_retire_queue(GL4RetireQueue& queue)
+    {
+        if (queue.buffers.size() + queue.textures.size() + queue.programs.size() + queue.program_pipelines.size() + queue.vertex_arrays.size() > 0)
+        {
+            LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Deleting %zu buffers, %zu textures, %zu programs, %zu program pipelines, %zu VAOs",
+                queue.buffers.size(), queue.textures.size(), queue.programs.size(), queue.program_pipelines.size(), queue.vertex_arrays.size());
+        }
+
+        // GL unbinds deleted objects and reuses their names
+        for (size_t i = 0; i < queue.buffers.size(); i++)
+        {
+            m_state_cache.forget_buffer(queue.buffers[i]);
+            forget_bound_buffer(queue.buffers[i]);
+        }
+        for (size_t i = 0; i < queue.vertex_arrays.size(); i++)
+            m_state_cache.forget_vertex_array(queue.vertex_arrays[i]);
+        for (size_t i = 0; i < queue.program_pipelines.size(); i++)
+            m_state_cache.forget_program_pipeline(queue.program_pipelines[i]);
+
+        if (!queue.buffers.empty())
+            glDeleteBuffers(queue.buffers.size(), &queue.buffers[0]);
+        if (!queue.textures.empty())
+            glDeleteTextures(queue.textures.size(), &queue.textures[0]);
+        if (!queue.program_pipelines.empty())
+            glDeleteProgramPipelines(queue.program_pipelines.size(), &queue.program_pipelines[0]);
+        for (size_t i = 0; i < queue.programs.size(); i++)
+            glDeleteProgram(queue.programs[i]);
+        if (!queue.vertex_arrays.empty())
+            glDeleteVertexArrays(queue.vertex_arrays.size(), &queue.vertex_arrays[0]);
+
+        // clear() keeps the capacity, so steady state frames don't allocate
+        queue.buffers.clear();
+        queue.textures.clear();
+        queue.programs.clear();
+        queue.program_pipelines.clear();
+        queue.vertex_arrays.clear();
+    }
+
+    // Drops a deleted buffer from the bindings we reapply on VAO switches
+    void GL4Backend::forget_bound_buffer(GLuint buffer)
+    {
+        for (uint32_t mask = m_bound_vertex_buffer_mask; mask; mask &= mask - 1)
+        {
+            uint32_t binding = Utils::lowest_bit_index(mask);
+            if (m_bound_vertex_buffers[binding].buffer == buffer)
+                m_bound_vertex_buffer_mask &= ~(1u << binding);
+        }
+        if (m_bound_index_buffer == buffer)
+            m_bound_index_buffer = 0;
+    }
+
+    // Same as forget_bound_buffer, for bindings to a range of the ring
+    void GL4Backend::forget_bound_storage(const GL4Buffer& buffer)
+    {
+        for (uint32_t mask = m_bound_vertex_buffer_mask; mask; mask &= mask - 1)
+        {
+            uint32_t binding = Utils::lowest_bit_index(mask);
+            if (is_bound_to_storage(m_bound_vertex_buffers[binding].buffer, m_bound_vertex_buffers[binding].offset, buffer))
+                m_bound_vertex_buffer_mask &= ~(1u << binding);
+        }
+        if (is_bound_to_storage(m_bound_index_buffer, m_bound_index_offset, buffer))
+            m_bound_index_buffer = 0;
+    }
+}
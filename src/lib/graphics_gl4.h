@@ -1,14 +1,67 @@
 #pragma once
 
+#include <unordered_map>
 #include <glad/glad.h>
 #include "graphics.h"
+#include "graphics_commands.h"
+#include "graphics_gl4_program_cache.h"
+#include "graphics_gl4_state.h"
+#include "graphics_gl4_upload_ring.h"
+#include "utils_memory.h"
 
 namespace Graphics
 {
+    #define GL4_FRAME_ARENA_BLOCK_SIZE (64 * 1024)
+
+    // From KHR_parallel_shader_compile, which our glad doesn't include. The
+    // ARB version uses the same values.
+    #define GL4_COMPLETION_STATUS_KHR 0x91B1
+    #define GL4_MAX_SHADER_COMPILER_THREADS_ANY 0xFFFFFFFFu
+
+    struct GL4Buffer
+    {
+        GLuint buffer;
+        GLenum index_type; // Only for index buffers
+        size_t size;
+        BufferUsage usage;
+        // Where draws read the contents from. The buffer itself at 0, unless
+        // the last full rewrite went through the upload ring.
+        GLuint storage;
+        size_t storage_offset;
+    };
+
+    // How a buffer update gets to GL
+    enum GL4UploadMethod
+    {
+        // glBufferSubData. The driver copies the data and syncs with draws
+        // still reading the old contents.
+        GL4_UPLOAD_SUB_DATA,
+        // glBufferData over the whole buffer. The driver swaps in fresh
+        // storage, so in-flight draws keep the old one and nothing stalls.
+        GL4_UPLOAD_ORPHAN,
+        // glMapBufferRange with the range invalidated, then a plain memcpy
+        GL4_UPLOAD_MAP_INVALIDATE,
+        // memcpy into the persistently mapped upload ring, and draws read the
+        // buffer from there until it's next updated
+        GL4_UPLOAD_RING
+    };
+
+    GL4UploadMethod get_gl_upload_method(BufferUsage usage, size_t offset, size_t size, size_t buffer_size, bool has_upload_ring);
+
     struct GL4Shader
     {
         GLbitfield stage_bitfield;
         GLuint program;
+        // Compile and link results aren't checked until the shader is first
+        // needed. Until then the stage objects stay attached to the program.
+        bool pending;
+        bool store_in_cache;
+        uint64_t cache_key;
+        size_t num_stages;
+        GLuint stages[GRAPHICS_MAX_SHADER_STAGES];
+
+        uint64_t config_hash;
+        uint32_t ref_count; // Identical shaders are shared, freed when this hits 0
     };
 
     struct GL4VertexAttribute
@@ -18,6 +71,7 @@ namespace Graphics
         GLint size;
         GLenum type;
         GLboolean normalized;
+        GLuint offset; // Relative to the start of the vertex
     };
 
     struct GL4VertexFormat
@@ -26,11 +80,30 @@ namespace Graphics
         size_t num_attributes;
         size_t stride;
     };
+    // Pure CPU, no GL calls
+    void get_gl_vertex_format(GL4VertexFormat* format, const VertexAttributeConfig* attributes, size_t num_attributes);
+
+    uint64_t hash_gl_vertex_format(const GL4VertexFormat& format);
+    // Compares the attributes in use, so a hash hit can be told apart from a
+    // collision
+    bool gl_vertex_formats_match(const GL4VertexFormat& a, const GL4VertexFormat& b);
+
+    // One per unique vertex format, shared by every pipeline that uses it.
+    // The VAO has the format baked in, so switching formats is a single bind
+    // and pipelines with the same format don't switch at all.
+    struct GL4CachedVertexFormat
+    {
+        GL4VertexFormat format;
+        uint64_t hash;
+        GLuint vertex_array;
+        uint32_t ref_count; // Free slot when zero
+    };
 
     struct GL4Pipeline
     {
-        // Replace this with a hash to get cached value and quick comparisons
-        GL4VertexFormat vertex_format;
+        // Index into the backend's vertex format cache
+        uint32_t vertex_format_id;
+        size_t stride;
         // Can cache these separately by the components
         GLuint shader_pipeline;
 
@@ -38,6 +111,21 @@ namespace Graphics
         size_t num_buffers;
         GLenum texture_types[GRAPHICS_PIPELINE_MAX_TEXTURES];
         size_t num_textures;
+
+        // Identical configs share one pipeline, destroyed with the last reference
+        uint64_t config_hash;
+        uint32_t ref_count;
+    };
+
+    // GL objects whose handles were destroyed during a frame. They get
+    // deleted in batches once that frame can't be in flight anymore.
+    struct GL4RetireQueue
+    {
+        std::vector<GLuint> buffers;
+        std::vector<GLuint> textures;
+        std::vector<GLuint> programs;
+        std::vector<GLuint> program_pipelines;
+        std::vector<GLuint> vertex_arrays;
     };
 
     class GL4Backend : public Backend
@@ -50,20 +138,87 @@ namespace Graphics
         void destroy_vertex_buffer(const VertexBuffer& buffer);
         IndexBuffer create_index_buffer(const IndexBufferConfig& config);
         void destroy_index_buffer(const IndexBuffer& buffer);
+        void update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size);
+        void update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices);
         Texture create_texture(const TextureConfig& config);
         void destroy_texture(const Texture& texture);
         Shader create_shader(const ShaderConfig& config);
         void destroy_shader(const Shader& shader);
+        bool is_shader_ready(const Shader& shader);
         Pipeline create_pipeline(const PipelineConfig& config);
         void destroy_pipeline(const Pipeline& pipeline);
+        void submit(CommandBuffer** command_buffers, size_t num_command_buffers);
+        void end_frame();
+
+        // Binds issued and filtered by the state cache during the last frame
+        const GL4StateCacheStats& state_cache_stats() const { return m_last_frame_state_stats; }
+        const GL4ProgramCacheStats& program_cache_stats() const { return m_program_cache.stats(); }
+        const GL4UploadRingStats& upload_ring_stats() const { return m_upload_ring.stats(); }
     private:
         void destroy_buffer(const Utils::WeakRef& handle);
+        void update_buffer(const Utils::WeakRef& handle, GLenum target, size_t offset, const void* data, size_t size);
         void destroy_shader(const Utils::WeakRef& handle);
         void destroy_pipeline(const Utils::WeakRef& handle);
+        void execute(const Command* command);
+        void apply_vertex_array_state(const GL4Pipeline& pipeline);
+        uint32_t acquire_vertex_format(const GL4VertexFormat& format);
+        void release_vertex_format(uint32_t id);
+        void forget_bound_buffer(GLuint buffer);
+        void forget_bound_storage(const GL4Buffer& buffer);
+        void move_buffer_storage(GL4Buffer& buffer, GLuint storage, size_t storage_offset);
+        void copy_buffer_home(GL4Buffer& buffer);
+        void end_upload_ring_frame();
+        void check_extensions();
+        void finish_shader(GL4Shader& shader);
+        void add_shader_to_cache(const ShaderConfig& config, uint64_t config_hash, const Shader& shader);
+
+        Utils::DenseWeakRefManager<GL4Buffer> m_buffers;
+        Utils::DenseWeakRefManager<GLuint> m_textures;
+        Utils::DenseWeakRefManager<GL4Shader> m_shaders;
+        Utils::DenseWeakRefManager<GL4Pipeline> m_pipelines;
+        // Live pipelines and shaders by config hash
+        std::unordered_map<uint64_t, PipelineCacheEntry> m_pipeline_cache;
+        std::unordered_map<uint64_t, ShaderCacheEntry> m_shader_cache;
+
+        std::vector<GL4CachedVertexFormat> m_vertex_formats;
+        std::vector<uint32_t> m_free_vertex_format_ids;
+        std::unordered_map<uint64_t, uint32_t> m_vertex_format_ids;
+
+        // One queue per frame in flight, plus the one being filled this frame
+        std::vector<GL4RetireQueue> m_retire_queues;
+        size_t m_frame_index;
+
+        // Transient allocations for the current frame, reset in end_frame
+        Utils::LinearArena m_frame_arena;
+
+        // Bound state during submit, carries over between submits like GL's.
+        // Vertex and index buffer bindings live in the VAO in GL, these are
+        // what gets reapplied when a pipeline switches VAOs.
+        Pipeline m_bound_pipeline; // Handle rather than pointer, the table moves pipelines around
+        size_t m_bound_stride;
+        struct
+        {
+            GLuint buffer;
+            size_t offset;
+        } m_bound_vertex_buffers[GRAPHICS_PIPELINE_MAX_BUFFERS];
+        uint32_t m_bound_vertex_buffer_mask;
+        GLuint m_bound_index_buffer;
+        GLenum m_bound_index_type;
+        size_t m_bound_index_offset;
+
+        GL4StateCache m_state_cache;
+        GL4StateCacheStats m_last_frame_state_stats;
+        GL4ProgramCache m_program_cache;
+        GL4UploadRing m_upload_ring;
+        size_t m_upload_ring_size;
+        // Buffers whose contents may be in the ring, checked every end_frame
+        std::vector<Utils::WeakRef> m_ring_resident_buffers;
+
+        void* (*m_gl_proc_loader)(const char* name);
+        bool m_extensions_checked;
+        bool m_parallel_shader_compile;
 
-        Utils::WeakRefManager<GLuint> m_buffers;
-        Utils::WeakRefManager<GLuint> m_textures;
-        Utils::WeakRefManager<GL4Shader> m_shaders;
-        Utils::WeakRefManager<GL4Pipeline> m_pipelines;
+        GL4RetireQueue& current_retire_queue();
+        void flush_retire_queue(GL4RetireQueue& queue);
     };
 }
\ No newline at end of file
@@ -0,0 +1,222 @@
+#include "graphics_gl4_program_cache.h"
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <physfs.h>
+#include "utils_profile.h"
+
+namespace Graphics
+{
+    struct GL4ProgramCacheHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t binary_format;
+        uint32_t binary_size;
+    };
+
+    static uint64_t hash_gl_string(GLenum name, uint64_t hash)
+    {
+        const char* string = (const char*) glGetString(name);
+        if (!string)
+            string = "";
+        // Include the terminator so "ab" + "c" doesn't hash like "a" + "bc"
+        return Utils::hash_fnv1a(string, strlen(string) + 1, hash);
+    }
+
+    uint64_t hash_program_sources(const ShaderConfig& config, uint64_t driver_hash)
+    {
+        uint64_t hash = Utils::hash_fnv1a_u64(GL4_PROGRAM_CACHE_VERSION, driver_hash);
+        hash = Utils::hash_fnv1a_u64(config.num_stages, hash);
+        for (size_t i = 0; i < config.num_stages; i++)
+        {
+            const char* source = config.shader_stages[i].source;
+            hash = Utils::hash_fnv1a_u64(config.shader_stages[i].stage, hash);
+            hash = Utils::hash_fnv1a(source, strlen(source) + 1, hash);
+        }
+        return hash;
+    }
+
+    GL4ProgramCache::GL4ProgramCache()
+        : m_driver_checked(false)
+        , m_enabled(false)
+        , m_driver_hash(0)
+        , m_stats()
+    {
+    }
+
+    void GL4ProgramCache::init(const char* directory)
+    {
+        m_directory = directory ? directory : "";
+        m_driver_checked = false;
+        m_enabled = false;
+        if (!directory)
+            return;
+
+        if (!PHYSFS_isInit() || !PHYSFS_getWriteDir())
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Program cache disabled: physfs has no write dir")
+            m_directory.clear();
+            return;
+        }
+        // Reads go through the search path, so the write dir has to be on it
+        const char* write_dir = PHYSFS_getWriteDir();
+        if (!PHYSFS_getMountPoint(write_dir) && !PHYSFS_mount(write_dir, NULL, 1))
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Program cache disabled: couldn't mount %s: %s",
+                write_dir, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            m_directory.clear();
+            return;
+        }
+        if (!PHYSFS_mkdir(directory))
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Program cache disabled: couldn't create %s: %s",
+                directory, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            m_directory.clear();
+            return;
+        }
+    }
+
+    bool GL4ProgramCache::enabled()
+    {
+        if (!m_driver_checked)
+            init_driver();
+        return m_enabled;
+    }
+
+    void GL4ProgramCache::init_driver()
+    {
+        m_driver_checked = true;
+        if (m_directory.empty())
+            return;
+
+        GLint num_formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+        if (num_formats <= 0)
+        {
+            LOG_INFO_CH(LOG_CHANNEL_GRAPHICS, "Program cache disabled: driver supports no binary formats");
+            return;
+        }
+
+        // Binaries are only good for the exact driver that made them
+        m_driver_hash = hash_gl_string(GL_VENDOR, UTILS_FNV1A_OFFSET);
+        m_driver_hash = hash_gl_string(GL_RENDERER, m_driver_hash);
+        m_driver_hash = hash_gl_string(GL_VERSION, m_driver_hash);
+        m_enabled = true;
+        LOG_VERBOSE_CH(LOG_CHANNEL_GRAPHICS, "Program cache in %s, driver hash %016" PRIx64, m_directory.c_str(), m_driver_hash);
+    }
+
+    uint64_t GL4ProgramCache::program_key(const ShaderConfig& config)
+    {
+        if (!m_driver_checked)
+            init_driver();
+        return hash_program_sources(config, m_driver_hash);
+    }
+
+    void GL4ProgramCache::get_path(uint64_t key, char* out_path, size_t path_size) const
+    {
+        snprintf(out_path, path_size, "%s/%016" PRIx64 ".bin", m_directory.c_str(), key);
+    }
+
+    GLuint GL4ProgramCache::load_program(uint64_t key, Utils::LinearArena& scratch)
+    {
+        PROFILE_SCOPE("GL4ProgramCache::load_program");
+        if (!enabled())
+            return 0;
+
+        char path[512];
+        get_path(key, path, sizeof(path));
+        PHYSFS_File* file = PHYSFS_openRead(path);
+        if (!file)
+        {
+            m_stats.num_misses++;
+            return 0;
+        }
+
+        GL4ProgramCacheHeader header;
+        bool valid = PHYSFS_readBytes(file, &header, sizeof(header)) == sizeof(header)
+            && header.magic == GL4_PROGRAM_CACHE_MAGIC
+            && header.version == GL4_PROGRAM_CACHE_VERSION
+            && header.key == key
+            && PHYSFS_fileLength(file) == (PHYSFS_sint64) (sizeof(header) + header.binary_size);
+        void* binary = nullptr;
+        if (valid)
+        {
+            binary = scratch.allocate(header.binary_size);
+            valid = PHYSFS_readBytes(file, binary, header.binary_size) == (PHYSFS_sint64) header.binary_size;
+        }
+        PHYSFS_close(file);
+
+        if (!valid)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Ignoring malformed program cache entry %s", path);
+            m_stats.num_misses++;
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        glProgramParameteri(program, GL_PROGRAM_SEPARABLE, GL_TRUE);
+        glProgramBinary(program, header.binary_format, binary, header.binary_size);
+
+        GLint is_linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &is_linked);
+        if (is_linked == GL_FALSE)
+        {
+            // Stale binary; it gets overwritten once the program is rebuilt
+            glDeleteProgram(program);
+            m_stats.num_rejected++;
+            m_stats.num_misses++;
+            return 0;
+        }
+
+        m_stats.num_hits++;
+        return program;
+    }
+
+    void GL4ProgramCache::store_program(uint64_t key, GLuint program, Utils::LinearArena& scratch)
+    {
+        PROFILE_SCOPE("GL4ProgramCache::store_program");
+        if (!enabled())
+            return;
+
+        GLint binary_size = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binary_size);
+        if (binary_size <= 0)
+            return;
+
+        GL4ProgramCacheHeader header;
+        header.magic = GL4_PROGRAM_CACHE_MAGIC;
+        header.version = GL4_PROGRAM_CACHE_VERSION;
+        header.key = key;
+        void* binary = scratch.allocate(binary_size);
+        GLsizei written = 0;
+        GLenum binary_format = 0;
+        glGetProgramBinary(program, binary_size, &written, &binary_format, binary);
+        if (written <= 0)
+            return;
+        header.binary_format = binary_format;
+        header.binary_size = written;
+
+        char path[512];
+        get_path(key, path, sizeof(path));
+        PHYSFS_File* file = PHYSFS_openWrite(path);
+        if (!file)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Couldn't write program cache entry %s: %s",
+                path, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            return;
+        }
+        bool ok = PHYSFS_writeBytes(file, &header, sizeof(header)) == sizeof(header)
+            && PHYSFS_writeBytes(file, binary, written) == written;
+        PHYSFS_close(file);
+
+        // A truncated entry would just be a miss, but don't leave it around
+        if (!ok)
+        {
+            PHYSFS_delete(path);
+            return;
+        }
+        m_stats.num_stored++;
+    }
+}
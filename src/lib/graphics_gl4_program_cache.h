@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <glad/glad.h>
+#include "graphics.h"
+#include "utils_memory.h"
+
+namespace Graphics
+{
+    #define GL4_PROGRAM_CACHE_MAGIC 0x4247504Cu // "LPGB"
+    // Bump whenever the file layout or the key changes
+    #define GL4_PROGRAM_CACHE_VERSION 1u
+
+    struct GL4ProgramCacheStats
+    {
+        size_t num_hits;
+        size_t num_misses;
+        // Binaries the driver refused, usually after a driver update that
+        // kept the same version string
+        size_t num_rejected;
+        size_t num_stored;
+    };
+
+    // Hash of everything that decides whether a binary can be reused: the
+    // driver identity and every stage's type and source
+    uint64_t hash_program_sources(const ShaderConfig& config, uint64_t driver_hash);
+
+    // Linked program binaries on disk, one file per program named after its
+    // key, under a directory relative to the physfs write dir. Anything that
+    // goes wrong just turns into a miss; the caller compiles from source.
+    class GL4ProgramCache
+    {
+    public:
+        GL4ProgramCache();
+
+        // NULL directory disables the cache. Needs physfs initialized with a
+        // write dir. Driver identity is read on first use, since the backend
+        // may be created before there's a context.
+        void init(const char* directory);
+        bool enabled();
+
+        uint64_t program_key(const ShaderConfig& config);
+        // Returns 0 on a miss
+        GLuint load_program(uint64_t key, Utils::LinearArena& scratch);
+        // Program must have been linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+        void store_program(uint64_t key, GLuint program, Utils::LinearArena& scratch);
+
+        const GL4ProgramCacheStats& stats() const { return m_stats; }
+    private:
+        void init_driver();
+        void get_path(uint64_t key, char* out_path, size_t path_size) const;
+
+        std::string m_directory;
+        bool m_driver_checked;
+        bool m_enabled;
+        uint64_t m_driver_hash;
+
+        GL4ProgramCacheStats m_stats;
+    };
+}
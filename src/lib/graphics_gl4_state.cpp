@@ -0,0 +1,120 @@
+#include "graphics_gl4_state.h"
+
+namespace Graphics
+{
+    GL4StateCache::GL4StateCache()
+    {
+        invalidate();
+        reset_stats();
+    }
+
+    void GL4StateCache::bind_buffer(GLenum target, GLuint buffer)
+    {
+        GLuint* cached;
+        switch (target)
+        {
+            case GL_ARRAY_BUFFER: cached = &m_array_buffer; break;
+            case GL_ELEMENT_ARRAY_BUFFER: cached = &m_element_array_buffer; break;
+            default: RUNTIME_ERROR("Buffer target 0x%x isn't cached", target);
+        }
+
+        if (*cached == buffer)
+        {
+            m_stats.num_filtered++;
+            return;
+        }
+        glBindBuffer(target, buffer);
+        *cached = buffer;
+        m_stats.num_issued++;
+    }
+
+    void GL4StateCache::bind_vertex_array(GLuint vertex_array)
+    {
+        if (m_vertex_array == vertex_array)
+        {
+            m_stats.num_filtered++;
+            return;
+        }
+        glBindVertexArray(vertex_array);
+        m_vertex_array = vertex_array;
+        invalidate_vertex_array_state();
+        m_stats.num_issued++;
+    }
+
+    void GL4StateCache::bind_program_pipeline(GLuint pipeline)
+    {
+        if (m_program_pipeline == pipeline)
+        {
+            m_stats.num_filtered++;
+            return;
+        }
+        glBindProgramPipeline(pipeline);
+        m_program_pipeline = pipeline;
+        m_stats.num_issued++;
+    }
+
+    void GL4StateCache::bind_vertex_buffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride)
+    {
+        ASSERT_MSG(binding < GRAPHICS_PIPELINE_MAX_BUFFERS, "Binding %u exceeds max buffers %d", binding, GRAPHICS_PIPELINE_MAX_BUFFERS);
+        VertexBufferBinding& cached = m_vertex_buffers[binding];
+        if (cached.buffer == buffer && cached.offset == offset && cached.stride == stride)
+        {
+            m_stats.num_filtered++;
+            return;
+        }
+        glBindVertexBuffer(binding, buffer, offset, stride);
+        cached.buffer = buffer;
+        cached.offset = offset;
+        cached.stride = stride;
+        m_stats.num_issued++;
+    }
+
+    void GL4StateCache::forget_buffer(GLuint buffer)
+    {
+        if (m_array_buffer == buffer)
+            m_array_buffer = GL4_STATE_UNKNOWN;
+        if (m_element_array_buffer == buffer)
+            m_element_array_buffer = GL4_STATE_UNKNOWN;
+        for (size_t i = 0; i < GRAPHICS_PIPELINE_MAX_BUFFERS; i++)
+        {
+            if (m_vertex_buffers[i].buffer == buffer)
+                m_vertex_buffers[i].buffer = GL4_STATE_UNKNOWN;
+        }
+    }
+
+    void GL4StateCache::forget_vertex_array(GLuint vertex_array)
+    {
+        if (m_vertex_array == vertex_array)
+        {
+            m_vertex_array = GL4_STATE_UNKNOWN;
+            invalidate_vertex_array_state();
+        }
+    }
+
+    void GL4StateCache::forget_program_pipeline(GLuint pipeline)
+    {
+        if (m_program_pipeline == pipeline)
+            m_program_pipeline = GL4_STATE_UNKNOWN;
+    }
+
+    void GL4StateCache::invalidate()
+    {
+        m_array_buffer = GL4_STATE_UNKNOWN;
+        m_vertex_array = GL4_STATE_UNKNOWN;
+        m_program_pipeline = GL4_STATE_UNKNOWN;
+        invalidate_vertex_array_state();
+    }
+
+    void GL4StateCache::reset_stats()
+    {
+        m_stats.num_issued = 0;
+        m_stats.num_filtered = 0;
+    }
+
+    void GL4StateCache::invalidate_vertex_array_state()
+    {
+        m_element_array_buffer = GL4_STATE_UNKNOWN;
+        for (size_t i = 0; i < GRAPHICS_PIPELINE_MAX_BUFFERS; i++)
+            m_vertex_buffers[i].buffer = GL4_STATE_UNKNOWN;
+    }
+}
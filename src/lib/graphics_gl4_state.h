@@ -0,0 +1,60 @@
+#pragma once
+
+#include <glad/glad.h>
+#include "graphics.h"
+
+namespace Graphics
+{
+    // Marks a cached binding we can't vouch for, so the next bind goes through
+    #define GL4_STATE_UNKNOWN 0xFFFFFFFFu
+
+    struct GL4StateCacheStats
+    {
+        size_t num_issued;
+        size_t num_filtered;
+    };
+
+    // Shadow copy of the GL bindings the backend touches. Binds that wouldn't
+    // change anything are dropped before they reach the driver. Everything
+    // has to go through here for the shadow copy to stay right, and anything
+    // that deletes a GL object has to tell the cache, since GL unbinds deleted
+    // objects and hands their names out again.
+    class GL4StateCache
+    {
+    public:
+        GL4StateCache();
+
+        void bind_buffer(GLenum target, GLuint buffer);
+        void bind_vertex_array(GLuint vertex_array);
+        void bind_program_pipeline(GLuint pipeline);
+        void bind_vertex_buffer(GLuint binding, GLuint buffer, GLintptr offset, GLsizei stride);
+
+        void forget_buffer(GLuint buffer);
+        void forget_vertex_array(GLuint vertex_array);
+        void forget_program_pipeline(GLuint pipeline);
+        // For when something outside the backend may have touched GL state
+        void invalidate();
+
+        // Counts since the last reset_stats
+        const GL4StateCacheStats& stats() const { return m_stats; }
+        void reset_stats();
+    private:
+        struct VertexBufferBinding
+        {
+            GLuint buffer;
+            GLintptr offset;
+            GLsizei stride;
+        };
+
+        // Element array and vertex buffer bindings belong to the VAO
+        void invalidate_vertex_array_state();
+
+        GLuint m_array_buffer;
+        GLuint m_element_array_buffer;
+        GLuint m_vertex_array;
+        GLuint m_program_pipeline;
+        VertexBufferBinding m_vertex_buffers[GRAPHICS_PIPELINE_MAX_BUFFERS];
+
+        GL4StateCacheStats m_stats;
+    };
+}
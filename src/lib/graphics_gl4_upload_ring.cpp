@@ -0,0 +1,147 @@
+#include "graphics_gl4_upload_ring.h"
+#include "utils_profile.h"
+
+namespace Graphics
+{
+    // Per wait call. We loop until the fence signals, this only decides how
+    // often a stuck GPU gets logged.
+    #define GL4_UPLOAD_RING_WAIT_TIMEOUT_NS 1000000000ull
+
+    static size_t align_up(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    GL4UploadRing::GL4UploadRing()
+        : m_buffer(0)
+        , m_mapped(nullptr)
+        , m_frame_size(0)
+        , m_region(0)
+        , m_head(0)
+        , m_region_ready(false)
+        , m_stats()
+    {
+    }
+
+    bool GL4UploadRing::init(size_t frame_size, size_t num_frames, GL4BufferStorageProc buffer_storage, GL4StateCache& state_cache)
+    {
+        ASSERT_MSG(!enabled(), "Upload ring initialized twice");
+        ASSERT_MSG(num_frames > 0, "Upload ring needs at least one frame");
+        if (frame_size == 0 || !buffer_storage)
+            return false;
+
+        m_frame_size = align_up(frame_size, GL4_UPLOAD_RING_ALIGNMENT);
+        size_t total_size = m_frame_size * num_frames;
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL4_MAP_PERSISTENT_BIT | GL4_MAP_COHERENT_BIT;
+
+        glGenBuffers(1, &m_buffer);
+        state_cache.bind_buffer(GL_ARRAY_BUFFER, m_buffer);
+        // Immutable storage is what allows mapping it while draws read from it
+        buffer_storage(GL_ARRAY_BUFFER, total_size, nullptr, flags);
+        m_mapped = (uint8_t*) glMapBufferRange(GL_ARRAY_BUFFER, 0, total_size, flags);
+        if (!m_mapped)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Couldn't persistently map a %zu byte upload ring", total_size);
+            state_cache.forget_buffer(m_buffer);
+            glDeleteBuffers(1, &m_buffer);
+            m_buffer = 0;
+            return false;
+        }
+
+        m_fences.assign(num_frames, nullptr);
+        m_region = 0;
+        m_head = 0;
+        m_region_ready = true;
+        LOG_INFO_CH(LOG_CHANNEL_GRAPHICS, "Upload ring: %zu frames of %zu bytes", num_frames, m_frame_size);
+        return true;
+    }
+
+    void GL4UploadRing::release(GL4StateCache& state_cache)
+    {
+        for (size_t i = 0; i < m_fences.size(); i++)
+        {
+            if (m_fences[i])
+                glDeleteSync(m_fences[i]);
+        }
+        m_fences.clear();
+
+        if (m_buffer)
+        {
+            state_cache.bind_buffer(GL_ARRAY_BUFFER, m_buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            state_cache.forget_buffer(m_buffer);
+            glDeleteBuffers(1, &m_buffer);
+        }
+        m_buffer = 0;
+        m_mapped = nullptr;
+    }
+
+    void* GL4UploadRing::allocate(size_t size, size_t* out_offset)
+    {
+        ASSERT_MSG(enabled(), "Allocating from an upload ring that isn't initialized");
+        size_t offset = align_up(m_head, GL4_UPLOAD_RING_ALIGNMENT);
+        if (offset > m_frame_size || size > m_frame_size - offset)
+        {
+            if (m_stats.num_overflows++ == 0)
+                LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Upload ring full, falling back to driver uploads. Raise upload_ring_size above %zu", m_frame_size);
+            return nullptr;
+        }
+
+        // Only the first allocation of a frame can find its region busy
+        if (!m_region_ready)
+            wait_for_region();
+
+        m_head = offset + size;
+        m_stats.num_allocations++;
+        m_stats.bytes_allocated += size;
+        *out_offset = m_region * m_frame_size + offset;
+        return m_mapped + *out_offset;
+    }
+
+    void GL4UploadRing::end_frame()
+    {
+        if (!enabled())
+            return;
+
+        // Regions nothing was written to don't need guarding
+        if (m_head > 0)
+        {
+            ASSERT_MSG(!m_fences[m_region], "Upload ring region %zu fenced twice", m_region);
+            m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+
+        m_region = (m_region + 1) % m_fences.size();
+        m_head = 0;
+        m_region_ready = !m_fences[m_region];
+    }
+
+    void GL4UploadRing::fence_current_region()
+    {
+        ASSERT_MSG(m_head == 0, "Upload ring region %zu fenced after it was written to", m_region);
+        // The new fence signals after the old one, which can go
+        if (m_fences[m_region])
+            glDeleteSync(m_fences[m_region]);
+        m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_region_ready = false;
+    }
+
+    void GL4UploadRing::wait_for_region()
+    {
+        PROFILE_SCOPE("GL4UploadRing::wait_for_region");
+        GLsync fence = m_fences[m_region];
+        // Flush on the first try, or the fence may never reach the GPU
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED)
+        {
+            m_stats.num_waits++;
+            while ((status = glClientWaitSync(fence, 0, GL4_UPLOAD_RING_WAIT_TIMEOUT_NS)) == GL_TIMEOUT_EXPIRED)
+                LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Still waiting on the GPU for upload ring region %zu", m_region);
+        }
+        if (status == GL_WAIT_FAILED)
+            LOG_ERROR_CH(LOG_CHANNEL_GRAPHICS, "Waiting on upload ring region %zu failed, writing over it anyway", m_region);
+
+        glDeleteSync(fence);
+        m_fences[m_region] = nullptr;
+        m_region_ready = true;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <vector>
+#include <glad/glad.h>
+#include "graphics.h"
+#include "graphics_gl4_state.h"
+
+namespace Graphics
+{
+    // From ARB_buffer_storage, which our glad doesn't include. Core since 4.4.
+    #define GL4_MAP_PERSISTENT_BIT 0x0040
+    #define GL4_MAP_COHERENT_BIT 0x0080
+    typedef void (APIENTRYP GL4BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+    // Allocations start on this boundary. Enough for any vertex attribute,
+    // and for the uniform buffer offset alignment of common drivers.
+    #define GL4_UPLOAD_RING_ALIGNMENT 256
+
+    struct GL4UploadRingStats
+    {
+        size_t num_allocations;
+        size_t bytes_allocated;
+        // Allocations that didn't fit in the frame's share of the ring
+        size_t num_overflows;
+        // Times the CPU caught up with the GPU and had to block on a fence
+        size_t num_waits;
+    };
+
+    // One buffer, mapped once for its whole life, split into a region per
+    // frame in flight plus the one being written. Writes go straight into
+    // memory the GPU reads from: no map or unmap per upload, and no driver
+    // syncs. A fence at the end of each frame guards its region until the GPU
+    // is done with it, and is only waited on if the ring comes back around
+    // to that region too soon.
+    class GL4UploadRing
+    {
+    public:
+        GL4UploadRing();
+
+        // Needs a context. Returns false, leaving the ring disabled, if the
+        // driver won't give us a persistent mapping.
+        bool init(size_t frame_size, size_t num_frames, GL4BufferStorageProc buffer_storage, GL4StateCache& state_cache);
+        // Unmaps and deletes the buffer, and drops any fences still pending
+        void release(GL4StateCache& state_cache);
+        bool enabled() const { return m_mapped != nullptr; }
+
+        // Returns where to write size bytes, which the GPU can read at
+        // out_offset in buffer() once the draws using them are submitted.
+        // Returns nullptr when this frame's region is full.
+        void* allocate(size_t size, size_t* out_offset);
+        // Fences the current region and moves on to the next
+        void end_frame();
+        // For GPU work queued since end_frame that still reads the region
+        // about to be written; allocations wait for it as well
+        void fence_current_region();
+        bool in_current_region(size_t offset) const { return offset / m_frame_size == m_region; }
+
+        GLuint buffer() const { return m_buffer; }
+        const GL4UploadRingStats& stats() const { return m_stats; }
+    private:
+        void wait_for_region();
+
+        GLuint m_buffer;
+        uint8_t* m_mapped;
+        size_t m_frame_size;
+        size_t m_region; // Index of the region being written
+        size_t m_head; // Offset into that region
+        bool m_region_ready; // Its fence has been waited on this frame
+        std::vector<GLsync> m_fences; // One per region, null when not pending
+
+        GL4UploadRingStats m_stats;
+    };
+}
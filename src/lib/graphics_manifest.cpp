@@ -0,0 +1,286 @@
+#include "graphics_manifest.h"
+#include <physfs.h>
+#include "utils_profile.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Pipeline manifests
+////////////////////////////////////////////////////////////////////////////////
+
+namespace Graphics
+{
+    #define MANIFEST_ARENA_BLOCK_SIZE (16 * 1024)
+
+    ManifestBackend::ManifestBackend(Backend* backend)
+        : m_backend(backend)
+    {
+        m_writer.write_u32(MANIFEST_MAGIC);
+        m_writer.write_u32(MANIFEST_VERSION);
+    }
+
+    VertexBuffer ManifestBackend::create_vertex_buffer(const VertexBufferConfig& config)
+    {
+        return m_backend->create_vertex_buffer(config);
+    }
+
+    void ManifestBackend::destroy_vertex_buffer(const VertexBuffer& buffer)
+    {
+        m_backend->destroy_vertex_buffer(buffer);
+    }
+
+    IndexBuffer ManifestBackend::create_index_buffer(const IndexBufferConfig& config)
+    {
+        return m_backend->create_index_buffer(config);
+    }
+
+    void ManifestBackend::destroy_index_buffer(const IndexBuffer& buffer)
+    {
+        m_backend->destroy_index_buffer(buffer);
+    }
+
+    void ManifestBackend::update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size)
+    {
+        m_backend->update_vertex_buffer(buffer, offset, data, size);
+    }
+
+    void ManifestBackend::update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices)
+    {
+        m_backend->update_index_buffer(buffer, first_index, data, num_indices);
+    }
+
+    Texture ManifestBackend::create_texture(const TextureConfig& config)
+    {
+        return m_backend->create_texture(config);
+    }
+
+    void ManifestBackend::destroy_texture(const Texture& texture)
+    {
+        m_backend->destroy_texture(texture);
+    }
+
+    Shader ManifestBackend::create_shader(const ShaderConfig& config)
+    {
+        Shader result = m_backend->create_shader(config);
+
+        // Shaders are deduplicated by config hash. Unlike in the backends a
+        // collision costs nothing worse than a missed prewarm.
+        uint64_t config_hash = hash_shader_config(config);
+        std::unordered_map<uint64_t, uint32_t>::iterator known = m_shader_indices.find(config_hash);
+        uint32_t index;
+        if (known != m_shader_indices.end())
+        {
+            index = known->second;
+        }
+        else
+        {
+            index = m_shader_indices.size();
+            m_shader_indices[config_hash] = index;
+            m_writer.write_u8(MANIFEST_RECORD_SHADER);
+            write_shader_config(m_writer, config);
+        }
+        ManifestShaderHandle& handle = m_shader_handle_indices[Utils::weakref_bits(result.handle)];
+        handle.index = index;
+        handle.ref_count++;
+        return result;
+    }
+
+    void ManifestBackend::destroy_shader(const Shader& shader)
+    {
+        // Freed slots get reused with a new generation, which is a different
+        // key, so dead handles have to go or the map only ever grows
+        std::unordered_map<uint64_t, ManifestShaderHandle>::iterator known = m_shader_handle_indices.find(Utils::weakref_bits(shader.handle));
+        if (known != m_shader_handle_indices.end() && --known->second.ref_count == 0)
+            m_shader_handle_indices.erase(known);
+        m_backend->destroy_shader(shader);
+    }
+
+    bool ManifestBackend::is_shader_ready(const Shader& shader)
+    {
+        return m_backend->is_shader_ready(shader);
+    }
+
+    Pipeline ManifestBackend::create_pipeline(const PipelineConfig& config)
+    {
+        Pipeline result = m_backend->create_pipeline(config);
+
+        ASSERT_MSG(config.num_shaders <= GRAPHICS_MAX_SHADER_STAGES, "Too many shaders in pipeline: %zu", config.num_shaders);
+        Shader shaders[GRAPHICS_MAX_SHADER_STAGES];
+        for (size_t i = 0; i < config.num_shaders; i++)
+        {
+            std::unordered_map<uint64_t, ManifestShaderHandle>::iterator known = m_shader_handle_indices.find(Utils::weakref_bits(config.shaders[i].handle));
+            if (known == m_shader_handle_indices.end())
+            {
+                LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Pipeline uses a shader created before recording started, leaving it out of the manifest");
+                return result;
+            }
+            shaders[i].handle = Utils::weakref_from_bits(known->second.index);
+        }
+
+        PipelineConfig manifest_config = config;
+        manifest_config.shaders = shaders;
+        if (m_pipeline_hashes.insert(hash_pipeline_config(manifest_config)).second)
+        {
+            m_writer.write_u8(MANIFEST_RECORD_PIPELINE);
+            write_pipeline_config(m_writer, manifest_config);
+        }
+        return result;
+    }
+
+    void ManifestBackend::destroy_pipeline(const Pipeline& pipeline)
+    {
+        m_backend->destroy_pipeline(pipeline);
+    }
+
+    void ManifestBackend::submit(CommandBuffer** command_buffers, size_t num_command_buffers)
+    {
+        m_backend->submit(command_buffers, num_command_buffers);
+    }
+
+    void ManifestBackend::end_frame()
+    {
+        m_backend->end_frame();
+    }
+
+    bool ManifestBackend::write_to_file(const char* path) const
+    {
+        PHYSFS_File* file = PHYSFS_openWrite(path);
+        if (!file)
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_IO, "Could not open %s for writing: %s", path, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            return false;
+        }
+
+        PHYSFS_sint64 written = PHYSFS_writeBytes(file, m_writer.bytes.data(), m_writer.bytes.size());
+        PHYSFS_close(file);
+        if (written != (PHYSFS_sint64) m_writer.bytes.size())
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_IO, "Short write to %s: %lld of %zu bytes", path, (long long) written, m_writer.bytes.size());
+            return false;
+        }
+        return true;
+    }
+
+    PipelinePrewarmer::PipelinePrewarmer()
+        : m_arena(MANIFEST_ARENA_BLOCK_SIZE)
+    {
+    }
+
+    void PipelinePrewarmer::clear()
+    {
+        m_shader_configs.clear();
+        m_pipeline_configs.clear();
+        m_arena.reset();
+    }
+
+    bool PipelinePrewarmer::load(const uint8_t* data, size_t size)
+    {
+        PROFILE_SCOPE("PipelinePrewarmer::load");
+        ASSERT_MSG(m_shaders.empty() && m_pipelines.empty(), "Cannot load a manifest while prewarming another");
+        clear();
+
+        CaptureReader reader(data, size);
+        if (reader.read_u32() != MANIFEST_MAGIC || reader.read_u32() != MANIFEST_VERSION)
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_GRAPHICS, "Not a pipeline manifest, or unsupported version");
+            return false;
+        }
+
+        while (!reader.at_end())
+        {
+            size_t record_offset = reader.offset;
+            uint8_t record = reader.read_u8();
+            bool valid = false;
+            if (record == MANIFEST_RECORD_SHADER)
+            {
+                ShaderConfig config;
+                valid = read_shader_config(reader, m_arena, &config);
+                if (valid)
+                    m_shader_configs.push_back(config);
+            }
+            else if (record == MANIFEST_RECORD_PIPELINE)
+            {
+                PipelineConfig config;
+                valid = read_pipeline_config(reader, m_arena, &config);
+                // Shaders always come before the pipelines using them
+                for (size_t i = 0; valid && i < config.num_shaders; i++)
+                    valid = Utils::weakref_bits(config.shaders[i].handle) < m_shader_configs.size();
+                if (valid)
+                    m_pipeline_configs.push_back(config);
+            }
+
+            if (!valid)
+            {
+                LOG_ERROR_CH(LOG_CHANNEL_GRAPHICS, "Malformed manifest record %u at offset %zu", record, record_offset);
+                clear();
+                return false;
+            }
+        }
+
+        LOG_INFO_CH(LOG_CHANNEL_GRAPHICS, "Loaded manifest with %zu shaders, %zu pipelines", m_shader_configs.size(), m_pipeline_configs.size());
+        return true;
+    }
+
+    bool PipelinePrewarmer::load_file(const char* path)
+    {
+        if (!PHYSFS_exists(path))
+        {
+            clear();
+            return true;
+        }
+
+        PHYSFS_File* file = PHYSFS_openRead(path);
+        if (!file)
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_IO, "Could not open %s: %s", path, PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+            return false;
+        }
+
+        std::vector<uint8_t> data(PHYSFS_fileLength(file));
+        PHYSFS_sint64 read = PHYSFS_readBytes(file, data.data(), data.size());
+        PHYSFS_close(file);
+        if (read != (PHYSFS_sint64) data.size())
+        {
+            LOG_ERROR_CH(LOG_CHANNEL_IO, "Short read from %s", path);
+            return false;
+        }
+        return load(data.data(), data.size());
+    }
+
+    bool PipelinePrewarmer::update(Backend* backend, size_t max_pipelines)
+    {
+        PROFILE_SCOPE("PipelinePrewarmer::update");
+
+        // Get every compile going at once, so they overlap
+        if (m_shaders.size() < m_shader_configs.size())
+        {
+            for (size_t i = m_shaders.size(); i < m_shader_configs.size(); i++)
+                m_shaders.push_back(backend->create_shader(m_shader_configs[i]));
+        }
+
+        for (size_t num_created = 0; num_created < max_pipelines && m_pipelines.size() < m_pipeline_configs.size(); num_created++)
+        {
+            PipelineConfig config = m_pipeline_configs[m_pipelines.size()];
+            Shader shaders[GRAPHICS_MAX_SHADER_STAGES];
+            for (size_t i = 0; i < config.num_shaders; i++)
+            {
+                shaders[i] = m_shaders[Utils::weakref_bits(config.shaders[i].handle)];
+                // Creating it now would wait on the compiler, try again next update
+                if (!backend->is_shader_ready(shaders[i]))
+                    return false;
+            }
+            config.shaders = shaders;
+            m_pipelines.push_back(backend->create_pipeline(config));
+        }
+        return m_pipelines.size() == m_pipeline_configs.size();
+    }
+
+    void PipelinePrewarmer::release(Backend* backend)
+    {
+        for (size_t i = 0; i < m_pipelines.size(); i++)
+            backend->destroy_pipeline(m_pipelines[i]);
+        for (size_t i = 0; i < m_shaders.size(); i++)
+            backend->destroy_shader(m_shaders[i]);
+        m_pipelines.clear();
+        m_shaders.clear();
+        clear();
+    }
+}
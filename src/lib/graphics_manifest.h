@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include "graphics.h"
+#include "graphics_capture.h"
+#include "utils_memory.h"
+
+namespace Graphics
+{
+    // Manifests list the pipelines a run created, plus the shaders they use,
+    // so the next run can create them before they're needed. Each record is
+    // an opcode byte and a config in the capture format. Pipelines refer to
+    // shaders by the order they appear in the manifest rather than by handle.
+    #define MANIFEST_MAGIC 0x4D504256u // "VBPM"
+    #define MANIFEST_VERSION 1u
+
+    enum ManifestRecord
+    {
+        MANIFEST_RECORD_SHADER,
+        MANIFEST_RECORD_PIPELINE
+    };
+
+    // Decorator that forwards every call to another backend and notes each
+    // unique shader and pipeline config along the way
+    class ManifestBackend : public Backend
+    {
+    public:
+        // Doesn't take ownership of backend
+        ManifestBackend(Backend* backend);
+
+        VertexBuffer create_vertex_buffer(const VertexBufferConfig& config);
+        void destroy_vertex_buffer(const VertexBuffer& buffer);
+        IndexBuffer create_index_buffer(const IndexBufferConfig& config);
+        void destroy_index_buffer(const IndexBuffer& buffer);
+        void update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size);
+        void update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices);
+        Texture create_texture(const TextureConfig& config);
+        void destroy_texture(const Texture& texture);
+        Shader create_shader(const ShaderConfig& config);
+        void destroy_shader(const Shader& shader);
+        bool is_shader_ready(const Shader& shader);
+        Pipeline create_pipeline(const PipelineConfig& config);
+        void destroy_pipeline(const Pipeline& pipeline);
+        void submit(CommandBuffer** command_buffers, size_t num_command_buffers);
+        void end_frame();
+
+        size_t num_shaders() const { return m_shader_indices.size(); }
+        size_t num_shader_handles() const { return m_shader_handle_indices.size(); }
+        size_t num_pipelines() const { return m_pipeline_hashes.size(); }
+        const std::vector<uint8_t>& manifest() const { return m_writer.bytes; }
+        // Path is relative to the physfs write dir
+        bool write_to_file(const char* path) const;
+    private:
+        Backend* m_backend;
+        CaptureWriter m_writer;
+        // Manifest index by shader config hash, and of every live handle
+        // handed out. Backends hand the same handle out once per create of a
+        // shared shader, so each counts the destroys it still has coming.
+        struct ManifestShaderHandle
+        {
+            uint32_t index;
+            uint32_t ref_count;
+        };
+        std::unordered_map<uint64_t, uint32_t> m_shader_indices;
+        std::unordered_map<uint64_t, ManifestShaderHandle> m_shader_handle_indices;
+        std::unordered_set<uint64_t> m_pipeline_hashes;
+    };
+
+    // Creates everything in a manifest ahead of time. All shader compiles are
+    // issued on the first update, then pipelines are created as their shaders
+    // become ready, a few per update so a loading screen can keep drawing.
+    // Once the game asks for the same configs, the backends hand back the
+    // prewarmed objects instead of creating new ones.
+    class PipelinePrewarmer
+    {
+    public:
+        PipelinePrewarmer();
+
+        // Copies what it needs out of data. Returns false, with nothing to
+        // prewarm, if the manifest is malformed.
+        bool load(const uint8_t* data, size_t size);
+        // Path is searched for in the physfs search path. A missing manifest
+        // isn't an error; there's just nothing to prewarm.
+        bool load_file(const char* path);
+
+        // Creates at most max_pipelines pipelines. Returns true once all of
+        // them exist.
+        bool update(Backend* backend, size_t max_pipelines);
+        // Drops the prewarmer's references. Whatever the game has created in
+        // the meantime stays alive.
+        void release(Backend* backend);
+
+        size_t num_pipelines() const { return m_pipeline_configs.size(); }
+        size_t num_created() const { return m_pipelines.size(); }
+    private:
+        void clear();
+
+        Utils::LinearArena m_arena;
+        std::vector<ShaderConfig> m_shader_configs;
+        // Shader handles hold manifest indices
+        std::vector<PipelineConfig> m_pipeline_configs;
+        std::vector<Shader> m_shaders;
+        std::vector<Pipeline> m_pipelines;
+    };
+}
@@ -0,0 +1,321 @@
+#include "graphics_null.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Null implementation
+////////////////////////////////////////////////////////////////////////////////
+
+namespace Graphics
+{
+    static size_t get_attribute_bytes(VertexAttributeConfig::Type type)
+    {
+        switch (type)
+        {
+            case VertexAttributeConfig::Type::FLOAT: return 1 * sizeof(float);
+            case VertexAttributeConfig::Type::VEC2: return 2 * sizeof(float);
+            case VertexAttributeConfig::Type::VEC3: return 3 * sizeof(float);
+            case VertexAttributeConfig::Type::VEC4: return 4 * sizeof(float);
+            default: RUNTIME_ERROR("Unknown type %d", type);
+        }
+    }
+
+    NullBackend::NullBackend(const BackendConfig& config)
+        : m_buffers(config.num_prealloc_buffers)
+        , m_textures(config.num_prealloc_textures)
+        , m_shaders(config.num_prealloc_shaders)
+        , m_pipelines(config.num_prealloc_pipelines)
+        , m_frame_index(0)
+        , m_bound_pipeline()
+        , m_index_buffer_bound(false)
+        , m_submit_stats()
+    {
+    }
+
+    NullBackend::~NullBackend()
+    {
+        if (m_pipelines.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu pipelines still alive at shutdown", m_pipelines.size());
+        if (m_shaders.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu shaders still alive at shutdown", m_shaders.size());
+        if (m_textures.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu textures still alive at shutdown", m_textures.size());
+        if (m_buffers.size() > 0)
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "%zu buffers still alive at shutdown", m_buffers.size());
+    }
+
+    VertexBuffer NullBackend::create_vertex_buffer(const VertexBufferConfig& config)
+    {
+        NullBuffer new_buffer = { VERTEX, config.size, 0, config.usage, 0, 0 };
+        return {m_buffers.add(new_buffer, VertexBuffer::type)};
+    }
+
+    void NullBackend::destroy_vertex_buffer(const VertexBuffer& buffer)
+    {
+        destroy_buffer(buffer.handle);
+    }
+
+    IndexBuffer NullBackend::create_index_buffer(const IndexBufferConfig& config)
+    {
+        size_t index_bytes = get_data_type_bytes(config.type);
+        NullBuffer new_buffer = { INDEX, index_bytes * config.num_indices, index_bytes, config.usage, 0, 0 };
+        return {m_buffers.add(new_buffer, IndexBuffer::type)};
+    }
+
+    void NullBackend::destroy_index_buffer(const IndexBuffer& buffer)
+    {
+        destroy_buffer(buffer.handle);
+    }
+
+    void NullBackend::update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size)
+    {
+        ASSERT_MSG(data || size == 0, "Cannot update a buffer from null data");
+        update_buffer(buffer.handle, offset, size);
+    }
+
+    void NullBackend::update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices)
+    {
+        ASSERT_MSG(data || num_indices == 0, "Cannot update a buffer from null data");
+        NullBuffer* buffer_obj = m_buffers.get(buffer.handle);
+        if (!buffer_obj)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid index buffer handle");
+            return;
+        }
+        update_buffer(buffer.handle, first_index * buffer_obj->index_bytes, num_indices * buffer_obj->index_bytes);
+    }
+
+    Texture NullBackend::create_texture(const TextureConfig& config)
+    {
+        NullTexture new_texture = { config.type, config.size };
+        return {m_textures.add(new_texture, Texture::type)};
+    }
+
+    void NullBackend::destroy_texture(const Texture& texture)
+    {
+        if (!m_textures.ref_is_valid(texture.handle))
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid texture handle");
+            return;
+        }
+
+        m_textures.remove(texture.handle);
+    }
+
+    Shader NullBackend::create_shader(const ShaderConfig& config)
+    {
+        ASSERT_MSG(config.num_stages > 0, "Cannot create shader with zero stages");
+
+        NullShader result;
+        result.stage_bitfield = 0;
+        for (size_t i = 0; i < config.num_stages; i++)
+        {
+            ASSERT_MSG(config.shader_stages[i].source, "Shader stage %zu has no source", i);
+            result.stage_bitfield |= config.shader_stages[i].stage;
+        }
+
+        uint64_t config_hash = hash_shader_config(config);
+        std::unordered_map<uint64_t, ShaderCacheEntry>::iterator cached = m_shader_cache.find(config_hash);
+        bool add_to_cache = cached == m_shader_cache.end();
+        if (!add_to_cache && shader_config_matches(cached->second.config, config))
+        {
+            m_shaders.get(cached->second.shader.handle)->ref_count++;
+            return cached->second.shader;
+        }
+        // Otherwise different sources hashed the same. They get a shader of
+        // their own, which stays out of the cache.
+
+        result.config_hash = config_hash;
+        result.ref_count = 1;
+        Shader shader = {m_shaders.add(result, Shader::type)};
+        if (add_to_cache)
+        {
+            ShaderCacheEntry& entry = m_shader_cache[config_hash];
+            entry.shader = shader;
+            make_shader_config_key(config, &entry.config);
+        }
+        return shader;
+    }
+
+    void NullBackend::destroy_shader(const Shader& shader)
+    {
+        NullShader* shader_obj = m_shaders.get(shader.handle);
+        if (!shader_obj)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid shader handle");
+            return;
+        }
+
+        if (--shader_obj->ref_count > 0)
+            return;
+
+        std::unordered_map<uint64_t, ShaderCacheEntry>::iterator cached = m_shader_cache.find(shader_obj->config_hash);
+        if (cached != m_shader_cache.end() && cached->second.shader == shader)
+            m_shader_cache.erase(cached);
+        m_shaders.remove(shader.handle);
+    }
+
+    // Nothing to compile
+    bool NullBackend::is_shader_ready(const Shader& shader)
+    {
+        return m_shaders.ref_is_valid(shader.handle);
+    }
+
+    Pipeline NullBackend::create_pipeline(const PipelineConfig& config)
+    {
+        assert_pipeline_config_valid(config);
+
+        uint64_t config_hash = hash_pipeline_config(config);
+        std::unordered_map<uint64_t, PipelineCacheEntry>::iterator cached = m_pipeline_cache.find(config_hash);
+        bool add_to_cache = cached == m_pipeline_cache.end();
+        if (!add_to_cache && pipeline_config_matches(cached->second.config, config))
+        {
+            m_pipelines.get(cached->second.pipeline.handle)->ref_count++;
+            return cached->second.pipeline;
+        }
+        // Otherwise a different config hashed the same. It gets a pipeline of
+        // its own, which stays out of the cache.
+
+        NullPipeline new_pipeline;
+        new_pipeline.config_hash = config_hash;
+        new_pipeline.ref_count = 1;
+        new_pipeline.num_buffers = config.num_buffers;
+        new_pipeline.num_textures = config.num_textures;
+        new_pipeline.num_attributes = config.num_attributes;
+
+        new_pipeline.stride = 0;
+        for (size_t i = 0; i < config.num_attributes; i++)
+            new_pipeline.stride += get_attribute_bytes(config.vertex_attributes[i].type);
+
+        new_pipeline.stage_bitfield = 0;
+        for (size_t i = 0; i < config.num_shaders; i++)
+        {
+            NullShader* shader = m_shaders.get(config.shaders[i].handle);
+            ASSERT_MSG(shader, "Shader not found. Did you delete it?");
+
+            new_pipeline.stage_bitfield |= shader->stage_bitfield;
+        }
+
+        Pipeline result = {m_pipelines.add(new_pipeline, Pipeline::type)};
+        if (add_to_cache)
+        {
+            PipelineCacheEntry& entry = m_pipeline_cache[config_hash];
+            entry.pipeline = result;
+            make_pipeline_config_key(config, &entry.config);
+        }
+        return result;
+    }
+
+    void NullBackend::destroy_pipeline(const Pipeline& pipeline)
+    {
+        NullPipeline* pipeline_obj = m_pipelines.get(pipeline.handle);
+        if (!pipeline_obj)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid pipeline handle");
+            return;
+        }
+
+        if (--pipeline_obj->ref_count > 0)
+            return;
+
+        std::unordered_map<uint64_t, PipelineCacheEntry>::iterator cached = m_pipeline_cache.find(pipeline_obj->config_hash);
+        if (cached != m_pipeline_cache.end() && cached->second.pipeline == pipeline)
+            m_pipeline_cache.erase(cached);
+        m_pipelines.remove(pipeline.handle);
+    }
+
+    void NullBackend::submit(CommandBuffer** command_buffers, size_t num_command_buffers)
+    {
+        for (size_t i = 0; i < num_command_buffers; i++)
+        {
+            for (const Command* command = command_buffers[i]->first_command(); command; command = command->next)
+                execute(command);
+        }
+    }
+
+    void NullBackend::end_frame()
+    {
+        m_frame_index++;
+        m_submit_stats = NullSubmitStats();
+    }
+
+    void NullBackend::destroy_buffer(const Utils::WeakRef& handle)
+    {
+        if (!m_buffers.ref_is_valid(handle))
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid buffer handle");
+            return;
+        }
+
+        m_buffers.remove(handle);
+    }
+
+    void NullBackend::update_buffer(const Utils::WeakRef& handle, size_t offset, size_t size)
+    {
+        NullBuffer* buffer = m_buffers.get(handle);
+        if (!buffer)
+        {
+            LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "Invalid buffer handle");
+            return;
+        }
+        ASSERT_MSG(offset <= buffer->size && size <= buffer->size - offset,
+            "Update of %zu bytes at %zu overruns a %zu byte buffer", size, offset, buffer->size);
+
+        buffer->num_updates++;
+        buffer->bytes_updated += size;
+    }
+
+    // Checks everything a real backend would need to resolve, and counts it
+    void NullBackend::execute(const Command* command)
+    {
+        switch (command->type)
+        {
+            case COMMAND_BIND_PIPELINE:
+            {
+                const BindPipelineCommand* bind = (const BindPipelineCommand*) command;
+                if (!m_pipelines.ref_is_valid(bind->pipeline.handle))
+                {
+                    m_submit_stats.num_invalid_commands++;
+                    return;
+                }
+                m_bound_pipeline = bind->pipeline;
+                m_submit_stats.num_pipeline_binds++;
+                return;
+            }
+            case COMMAND_BIND_VERTEX_BUFFER:
+            {
+                const BindVertexBufferCommand* bind = (const BindVertexBufferCommand*) command;
+                if (!m_buffers.ref_is_valid(bind->buffer.handle))
+                {
+                    m_submit_stats.num_invalid_commands++;
+                    return;
+                }
+                m_submit_stats.num_buffer_binds++;
+                return;
+            }
+            case COMMAND_BIND_INDEX_BUFFER:
+            {
+                const BindIndexBufferCommand* bind = (const BindIndexBufferCommand*) command;
+                if (!m_buffers.ref_is_valid(bind->buffer.handle))
+                {
+                    m_submit_stats.num_invalid_commands++;
+                    return;
+                }
+                m_index_buffer_bound = true;
+                m_submit_stats.num_buffer_binds++;
+                return;
+            }
+            case COMMAND_DRAW:
+            case COMMAND_DRAW_INDEXED:
+                // Draws need a pipeline that's still alive, and indexed draws an index buffer
+                if (m_bound_pipeline == Pipeline() || !m_pipelines.ref_is_valid(m_bound_pipeline.handle) ||
+                    (command->type == COMMAND_DRAW_INDEXED && !m_index_buffer_bound))
+                {
+                    m_submit_stats.num_invalid_commands++;
+                    return;
+                }
+                m_submit_stats.num_draws++;
+                return;
+            default:
+                RUNTIME_ERROR("Unknown command type %d", command->type);
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <unordered_map>
+#include "graphics.h"
+#include "graphics_commands.h"
+
+namespace Graphics
+{
+    // Headless backend. Does all the handle bookkeeping the real backends do
+    // but never talks to a driver, so the CPU cost of the resource/pipeline
+    // layer can be measured on machines without a GPU.
+
+    struct NullBuffer
+    {
+        BufferType type;
+        size_t size;
+        size_t index_bytes; // Only for index buffers
+        BufferUsage usage;
+        size_t num_updates;
+        size_t bytes_updated;
+    };
+
+    struct NullTexture
+    {
+        TextureType type;
+        size_t size;
+    };
+
+    struct NullShader
+    {
+        ShaderStageBitfield stage_bitfield;
+
+        uint64_t config_hash;
+        uint32_t ref_count;
+    };
+
+    struct NullPipeline
+    {
+        ShaderStageBitfield stage_bitfield;
+        size_t num_attributes;
+        size_t stride;
+        size_t num_buffers;
+        size_t num_textures;
+
+        uint64_t config_hash;
+        uint32_t ref_count;
+    };
+
+    // What the last frame's submits would have sent to a driver
+    struct NullSubmitStats
+    {
+        size_t num_pipeline_binds;
+        size_t num_buffer_binds;
+        size_t num_draws;
+        size_t num_invalid_commands;
+    };
+
+    class NullBackend : public Backend
+    {
+    public:
+        NullBackend(const BackendConfig& config);
+        ~NullBackend();
+
+        VertexBuffer create_vertex_buffer(const VertexBufferConfig& config);
+        void destroy_vertex_buffer(const VertexBuffer& buffer);
+        IndexBuffer create_index_buffer(const IndexBufferConfig& config);
+        void destroy_index_buffer(const IndexBuffer& buffer);
+        void update_vertex_buffer(const VertexBuffer& buffer, size_t offset, const void* data, size_t size);
+        void update_index_buffer(const IndexBuffer& buffer, size_t first_index, const void* data, size_t num_indices);
+        Texture create_texture(const TextureConfig& config);
+        void destroy_texture(const Texture& texture);
+        Shader create_shader(const ShaderConfig& config);
+        void destroy_shader(const Shader& shader);
+        bool is_shader_ready(const Shader& shader);
+        Pipeline create_pipeline(const PipelineConfig& config);
+        void destroy_pipeline(const Pipeline& pipeline);
+        void submit(CommandBuffer** command_buffers, size_t num_command_buffers);
+        void end_frame();
+
+        // Introspection for tests
+        size_t num_buffers() const { return m_buffers.size(); }
+        size_t num_textures() const { return m_textures.size(); }
+        size_t num_shaders() const { return m_shaders.size(); }
+        size_t num_pipelines() const { return m_pipelines.size(); }
+        size_t frame_index() const { return m_frame_index; }
+        const NullSubmitStats& submit_stats() const { return m_submit_stats; }
+        const NullBuffer* get_buffer(const Utils::WeakRef& handle) { return m_buffers.get(handle); }
+        const NullPipeline* get_pipeline(const Pipeline& pipeline) { return m_pipelines.get(pipeline.handle); }
+    private:
+        void destroy_buffer(const Utils::WeakRef& handle);
+        void update_buffer(const Utils::WeakRef& handle, size_t offset, size_t size);
+        void execute(const Command* command);
+
+        Utils::DenseWeakRefManager<NullBuffer> m_buffers;
+        Utils::DenseWeakRefManager<NullTexture> m_textures;
+        Utils::DenseWeakRefManager<NullShader> m_shaders;
+        std::unordered_map<uint64_t, ShaderCacheEntry> m_shader_cache;
+        Utils::DenseWeakRefManager<NullPipeline> m_pipelines;
+        // Live pipelines by config hash, shared the same way GL4Backend does
+        std::unordered_map<uint64_t, PipelineCacheEntry> m_pipeline_cache;
+
+        size_t m_frame_index;
+
+        // Bound state during submit. Like GL, it carries over between
+        // command buffers and submits.
+        Pipeline m_bound_pipeline;
+        bool m_index_buffer_bound;
+        NullSubmitStats m_submit_stats;
+    };
+}
@@ -0,0 +1,120 @@
+#include "graphics_sort.h"
+#include "utils_profile.h"
+
+namespace Graphics
+{
+    static uint64_t sort_key_field(uint64_t value, size_t bits)
+    {
+        return value & ((1ull << bits) - 1);
+    }
+
+    static uint64_t quantize_depth(float depth)
+    {
+        const uint64_t max_depth = (1ull << SORT_KEY_DEPTH_BITS) - 1;
+        // Written so NaN ends up at 0 too
+        if (!(depth > 0.0f))
+            return 0;
+        if (depth >= 1.0f)
+            return max_depth;
+        return (uint64_t) (depth * max_depth);
+    }
+
+    uint64_t make_sort_key(SortKeyLayout layout, uint32_t layer, uint32_t pipeline_id, uint32_t texture_set, float depth)
+    {
+        uint64_t key_layer = sort_key_field(layer, SORT_KEY_LAYER_BITS);
+        uint64_t key_pipeline = sort_key_field(pipeline_id, SORT_KEY_PIPELINE_BITS);
+        uint64_t key_texture_set = sort_key_field(texture_set, SORT_KEY_TEXTURE_SET_BITS);
+        uint64_t key_depth = quantize_depth(depth);
+
+        switch (layout)
+        {
+            case SORT_KEY_OPAQUE:
+                return key_layer << (SORT_KEY_PIPELINE_BITS + SORT_KEY_TEXTURE_SET_BITS + SORT_KEY_DEPTH_BITS)
+                    | key_pipeline << (SORT_KEY_TEXTURE_SET_BITS + SORT_KEY_DEPTH_BITS)
+                    | key_texture_set << SORT_KEY_DEPTH_BITS
+                    | key_depth;
+            case SORT_KEY_TRANSPARENT:
+            {
+                uint64_t inverted_depth = ((1ull << SORT_KEY_DEPTH_BITS) - 1) - key_depth;
+                return key_layer << (SORT_KEY_DEPTH_BITS + SORT_KEY_PIPELINE_BITS + SORT_KEY_TEXTURE_SET_BITS)
+                    | inverted_depth << (SORT_KEY_PIPELINE_BITS + SORT_KEY_TEXTURE_SET_BITS)
+                    | key_pipeline << SORT_KEY_TEXTURE_SET_BITS
+                    | key_texture_set;
+            }
+            default:
+                RUNTIME_ERROR("Unknown sort key layout %d", layout);
+        }
+    }
+
+    DrawSorter::DrawSorter(size_t num_threads)
+        : m_workers(num_threads)
+    {
+    }
+
+    void DrawSorter::sort(DrawList** draw_lists, size_t num_draw_lists, CommandBuffer* out_command_buffer)
+    {
+        PROFILE_SCOPE("DrawSorter::sort");
+
+        m_packets.clear();
+        for (size_t i = 0; i < num_draw_lists; i++)
+        {
+            const DrawPacket* packets = draw_lists[i]->packets();
+            for (size_t j = 0; j < draw_lists[i]->size(); j++)
+                m_packets.push_back(&packets[j]);
+        }
+
+        const size_t num_packets = m_packets.size();
+        ASSERT_MSG(num_packets <= UINT32_MAX, "Too many draws to sort: %zu", num_packets);
+        m_keys.resize(num_packets);
+        m_indices.resize(num_packets);
+        m_scratch_keys.resize(num_packets);
+        m_scratch_indices.resize(num_packets);
+        for (size_t i = 0; i < num_packets; i++)
+        {
+            m_keys[i] = m_packets[i]->sort_key;
+            m_indices[i] = i;
+        }
+
+        Utils::radix_sort(m_keys.data(), m_indices.data(), num_packets, m_scratch_keys.data(), m_scratch_indices.data(), &m_workers);
+
+        // Record the sorted draws, skipping binds of what's already bound
+        Pipeline bound_pipeline = {};
+        VertexBuffer bound_vertex_buffer = {};
+        size_t bound_vertex_offset = 0;
+        IndexBuffer bound_index_buffer = {};
+        size_t bound_index_offset = 0;
+        for (size_t i = 0; i < num_packets; i++)
+        {
+            const DrawPacket& packet = *m_packets[m_indices[i]];
+            bool pipeline_changed = packet.pipeline != bound_pipeline;
+            if (pipeline_changed)
+            {
+                out_command_buffer->bind_pipeline(packet.pipeline);
+                bound_pipeline = packet.pipeline;
+            }
+
+            // Vertex buffer strides come from the pipeline, so a new pipeline
+            // needs the buffer bound again
+            if (pipeline_changed || packet.vertex_buffer != bound_vertex_buffer || packet.vertex_offset != bound_vertex_offset)
+            {
+                out_command_buffer->bind_vertex_buffer(0, packet.vertex_buffer, packet.vertex_offset);
+                bound_vertex_buffer = packet.vertex_buffer;
+                bound_vertex_offset = packet.vertex_offset;
+            }
+
+            if (packet.index_buffer == IndexBuffer())
+            {
+                out_command_buffer->draw(packet.num_elements, packet.first_element);
+                continue;
+            }
+
+            if (packet.index_buffer != bound_index_buffer || packet.index_offset != bound_index_offset)
+            {
+                out_command_buffer->bind_index_buffer(packet.index_buffer, packet.index_offset);
+                bound_index_buffer = packet.index_buffer;
+                bound_index_offset = packet.index_offset;
+            }
+            out_command_buffer->draw_indexed(packet.num_elements, packet.first_element);
+        }
+    }
+}
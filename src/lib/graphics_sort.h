@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include "graphics_commands.h"
+#include "utils_sort.h"
+
+namespace Graphics
+{
+    // 64 bit draw sort keys. Draws are submitted in ascending key order, so
+    // the most significant fields decide the most. Both layouts put the layer
+    // on top so layers always draw in order.
+    //
+    // Opaque, front to back so early depth testing rejects as much as
+    // possible, after grouping by state:
+    //   | layer 8 | pipeline 16 | texture set 16 | depth 24 |
+    // Transparent, back to front for correct blending, state only breaks ties:
+    //   | layer 8 | inverted depth 24 | pipeline 16 | texture set 16 |
+    enum SortKeyLayout
+    {
+        SORT_KEY_OPAQUE,
+        SORT_KEY_TRANSPARENT
+    };
+
+    #define SORT_KEY_LAYER_BITS 8
+    #define SORT_KEY_PIPELINE_BITS 16
+    #define SORT_KEY_TEXTURE_SET_BITS 16
+    #define SORT_KEY_DEPTH_BITS 24
+
+    // Depth is view depth normalized to [0, 1], clamped. Only the low bits of
+    // the pipeline id and texture set are used; a collision costs a state
+    // change, not correctness.
+    uint64_t make_sort_key(SortKeyLayout layout, uint32_t layer, uint32_t pipeline_id, uint32_t texture_set, float depth);
+
+    // A draw with all the state it needs, so draws can be reordered freely
+    struct DrawPacket
+    {
+        uint64_t sort_key;
+        Pipeline pipeline;
+        VertexBuffer vertex_buffer;
+        size_t vertex_offset;
+        IndexBuffer index_buffer; // Null handle for non-indexed draws
+        size_t index_offset;
+        size_t num_elements; // Vertices or indices
+        size_t first_element;
+    };
+
+    // Draws collected by one thread. Like command buffers, any thread can fill
+    // one in, one thread at a time.
+    class DrawList
+    {
+    public:
+        void add(const DrawPacket& packet) { m_packets.push_back(packet); }
+        // clear() keeps the capacity, so steady state frames don't allocate
+        void reset() { m_packets.clear(); }
+
+        size_t size() const { return m_packets.size(); }
+        const DrawPacket* packets() const { return m_packets.data(); }
+    private:
+        std::vector<DrawPacket> m_packets;
+    };
+
+    // Merges draw lists, radix sorts them by key and records the result into
+    // a command buffer, only binding state when it changes from the previous
+    // draw. Keeps its sort buffers and worker threads between frames.
+    class DrawSorter
+    {
+    public:
+        DrawSorter(size_t num_threads = 1);
+
+        void sort(DrawList** draw_lists, size_t num_draw_lists, CommandBuffer* out_command_buffer);
+    private:
+        Utils::SortWorkers m_workers;
+        std::vector<const DrawPacket*> m_packets;
+        std::vector<uint64_t> m_keys;
+        std::vector<uint32_t> m_indices;
+        std::vector<uint64_t> m_scratch_keys;
+        std::vector<uint32_t> m_scratch_indices;
+    };
+}
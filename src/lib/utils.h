@@ -1,20 +1,61 @@
 #pragma once
 #include <cstdio>
+#include <cstdlib>
+#include <cstdint>
 #include <vector>
-#include <queue>
+#include <memory>
+#include <atomic>
+#include <functional>
+
+#include "utils_log.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define UTILS_SSE2 1
+#include <emmintrin.h>
+#endif
 
 namespace Utils
 {
-#define LOG(logtype, format, ...) \
+// format has to be a string literal, the logger keeps a pointer to it and
+// formats on its own thread later. See utils_log.h.
+#define LOG(level, channel, format, ...) \
     do \
     { \
-        fprintf(stderr, logtype " %s::%s, line %d: ", __FILE__, __FUNCTION__, __LINE__); \
-        fprintf(stderr, format "\n", ##__VA_ARGS__);                              \
+        if (Utils::log_channel_enabled(level, channel)) \
+        { \
+            static const Utils::LogSite log_site = { level, channel, __FILE__, __FUNCTION__, __LINE__, "" format }; \
+            Utils::log_write(&log_site, ##__VA_ARGS__); \
+        } \
     } while (false);
 
-#define LOG_ERROR(format, ...) LOG("ERROR", format, ##__VA_ARGS__)
-#define LOG_WARNING(format, ...) LOG("WARNING", format, ##__VA_ARGS__)
-#define LOG_INFO(format, ...) LOG("INFO", format, ##__VA_ARGS__)
+// Disabled levels expand to an empty statement, so their arguments are never
+// evaluated
+#define LOG_DISABLED(...) do {} while (false);
+
+#define LOG_ERROR_CH(channel, format, ...) LOG(LOG_LEVEL_ERROR, channel, format, ##__VA_ARGS__)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARNING
+#define LOG_WARNING_CH(channel, format, ...) LOG(LOG_LEVEL_WARNING, channel, format, ##__VA_ARGS__)
+#else
+#define LOG_WARNING_CH(...) LOG_DISABLED()
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO_CH(channel, format, ...) LOG(LOG_LEVEL_INFO, channel, format, ##__VA_ARGS__)
+#else
+#define LOG_INFO_CH(...) LOG_DISABLED()
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_VERBOSE
+#define LOG_VERBOSE_CH(channel, format, ...) LOG(LOG_LEVEL_VERBOSE, channel, format, ##__VA_ARGS__)
+#else
+#define LOG_VERBOSE_CH(...) LOG_DISABLED()
+#endif
+
+#define LOG_ERROR(format, ...) LOG_ERROR_CH(LOG_CHANNEL_GENERAL, format, ##__VA_ARGS__)
+#define LOG_WARNING(format, ...) LOG_WARNING_CH(LOG_CHANNEL_GENERAL, format, ##__VA_ARGS__)
+#define LOG_INFO(format, ...) LOG_INFO_CH(LOG_CHANNEL_GENERAL, format, ##__VA_ARGS__)
+#define LOG_VERBOSE(format, ...) LOG_VERBOSE_CH(LOG_CHANNEL_GENERAL, format, ##__VA_ARGS__)
     
 #define RUNTIME_ERROR(format, ...)                             \
     do                                                         \
@@ -27,102 +68,745 @@ namespace Utils
 #define ASSERT_MSG(cond, msg, ...) if (!(cond)) { RUNTIME_ERROR("Assertion failed: " #cond ". " msg, ##__VA_ARGS__) };
 #define ASSERT(cond) ASSERT_MSG(cond, "")
 
+    // 64 bit FNV-1a. Not cryptographic, just quick and well spread, for
+    // hashing configs into cache keys. Chain calls by passing the previous
+    // result in as hash.
+    #define UTILS_FNV1A_OFFSET 0xcbf29ce484222325ull
+    #define UTILS_FNV1A_PRIME 0x100000001b3ull
+
+    inline uint64_t hash_fnv1a(const void* data, size_t size, uint64_t hash = UTILS_FNV1A_OFFSET)
+    {
+        const uint8_t* bytes = (const uint8_t*) data;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= UTILS_FNV1A_PRIME;
+        }
+        return hash;
+    }
+
+    // Widens first so the hash doesn't depend on the size of size_t or enums
+    inline uint64_t hash_fnv1a_u64(uint64_t value, uint64_t hash = UTILS_FNV1A_OFFSET)
+    {
+        return hash_fnv1a(&value, sizeof(value), hash);
+    }
+
     // Shit ass implementation of a weak ref manager
     // uses std for convenience, profile this if you think it's actually a problem
+    // Packed into 64 bits: the slot index, then a 24 bit generation and an 8
+    // bit type tag. The generation and type together make up the check word
+    // the slot has to match, so stale refs and refs of the wrong type are
+    // both caught by one 32 bit compare.
     struct WeakRef
     {
         uint32_t index;
-        uint32_t generation;
+        uint32_t generation : 24;
+        uint32_t type : 8;
+    };
+    static_assert(sizeof(WeakRef) == sizeof(uint64_t), "WeakRef should pack into 64 bits");
+
+    #define WEAKREF_GENERATION_MASK 0x00FFFFFFu
+    #define WEAKREF_TYPE_SHIFT 24
+
+    inline uint32_t weakref_check(const WeakRef& ref)
+    {
+        return ref.generation | ((uint32_t) ref.type << WEAKREF_TYPE_SHIFT);
+    }
+
+    // The whole ref as one integer, for hashing, sorting and serializing
+    inline uint64_t weakref_bits(const WeakRef& ref)
+    {
+        return ref.index | ((uint64_t) weakref_check(ref) << 32);
+    }
+
+    inline WeakRef weakref_from_bits(uint64_t bits)
+    {
+        WeakRef ref;
+        ref.index = (uint32_t) bits;
+        ref.generation = (bits >> 32) & WEAKREF_GENERATION_MASK;
+        ref.type = bits >> (32 + WEAKREF_TYPE_SHIFT);
+        return ref;
+    }
+
+    inline bool operator==(const WeakRef& a, const WeakRef& b)
+    {
+        return weakref_bits(a) == weakref_bits(b);
+    }
+
+    inline bool operator!=(const WeakRef& a, const WeakRef& b)
+    {
+        return weakref_bits(a) != weakref_bits(b);
+    }
+
+    // Check word with the generation bumped and the type kept
+    inline uint32_t weakref_next_check(uint32_t check)
+    {
+        return (check & ~WEAKREF_GENERATION_MASK) | ((check + 1) & WEAKREF_GENERATION_MASK);
+    }
+
+    inline uint32_t count_bits(uint64_t bits)
+    {
+        bits = bits - ((bits >> 1) & 0x5555555555555555ull);
+        bits = (bits & 0x3333333333333333ull) + ((bits >> 2) & 0x3333333333333333ull);
+        bits = (bits + (bits >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+        return (uint32_t) ((bits * 0x0101010101010101ull) >> 56);
+    }
+
+    // Index of the lowest set bit. bits must not be zero.
+    inline uint32_t lowest_bit_index(uint64_t bits)
+    {
+        return count_bits((bits & (0 - bits)) - 1);
+    }
+
+    #define WEAKREF_INVALID_INDEX UINT32_MAX
+    #define WEAKREF_BATCH_SIZE 64
+
+    // Compares a batch of up to WEAKREF_BATCH_SIZE refs against the
+    // check words currently in their slots. Bit i of the result is set if
+    // ref i is out of bounds or stale.
+    inline uint64_t weakref_invalid_mask(
+        const uint32_t* indices,
+        const uint32_t* ref_checks,
+        const uint32_t* slot_checks,
+        uint32_t num_slots,
+        size_t count)
+    {
+        uint64_t mask = 0;
+        size_t i = 0;
+#ifdef UTILS_SSE2
+        // SSE2 only has signed compares, so flip the sign bit to compare the
+        // indices as unsigned
+        const __m128i sign_bit = _mm_set1_epi32((int) 0x80000000);
+        const __m128i limit = _mm_xor_si128(_mm_set1_epi32((int) num_slots), sign_bit);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i index = _mm_xor_si128(_mm_loadu_si128((const __m128i*) &indices[i]), sign_bit);
+            __m128i in_bounds = _mm_cmplt_epi32(index, limit);
+            __m128i same_check = _mm_cmpeq_epi32(
+                _mm_loadu_si128((const __m128i*) &ref_checks[i]),
+                _mm_loadu_si128((const __m128i*) &slot_checks[i]));
+            int valid_bits = _mm_movemask_ps(_mm_castsi128_ps(_mm_and_si128(in_bounds, same_check)));
+            mask |= (uint64_t) (~valid_bits & 0xF) << i;
+        }
+#endif
+        for (; i < count; i++)
+        {
+            bool valid = indices[i] < num_slots && ref_checks[i] == slot_checks[i];
+            mask |= (uint64_t) !valid << i;
+        }
+        return mask;
+    }
+
+    // Storage policies for WeakRefManager. A policy provides a Container<U>
+    // with size(), operator[] and a grow-only resize(), and decides how much
+    // the manager grows by when it runs out of free indices.
+
+    // One contiguous array. Growing reallocates and copies every slot, which
+    // invalidates any pointer get() has handed out.
+    struct WeakRefVectorStorage
+    {
+        template <typename U>
+        using Container = std::vector<U>;
+
+        static uint32_t next_reserve_size(uint32_t reserve_size)
+        {
+            return reserve_size > 0 ? reserve_size * 2 : 1;
+        }
+    };
+
+    // Fixed size pages that never move once allocated. Pointers from get()
+    // stay valid until the ref is removed, and growing costs one page
+    // allocation no matter how big the manager already is.
+    template <uint32_t slots_per_page = 1024>
+    struct WeakRefPagedStorage
+    {
+        template <typename U>
+        class Container
+        {
+        public:
+            Container() : num_elements(0) {}
+
+            size_t size() const { return num_elements; }
+
+            U& operator[](size_t i) { return pages[i / slots_per_page][i % slots_per_page]; }
+            const U& operator[](size_t i) const { return pages[i / slots_per_page][i % slots_per_page]; }
+
+            void resize(size_t new_size)
+            {
+                ASSERT(new_size >= num_elements);
+                while (pages.size() * slots_per_page < new_size)
+                    pages.emplace_back(new U[slots_per_page]());
+                num_elements = new_size;
+            }
+        private:
+            std::vector<std::unique_ptr<U[]>> pages;
+            size_t num_elements;
+        };
+
+        static uint32_t next_reserve_size(uint32_t reserve_size)
+        {
+            return (reserve_size / slots_per_page + 1) * slots_per_page;
+        }
+    };
+
+    // Validation policies for WeakRefManager lookups. remove() always checks
+    // its ref, the policies only change what get() does.
+
+    // Full check, and every invalid ref gets logged
+    struct CheckedRefValidation
+    {
+        static const bool check_refs = true;
+        static const bool log_invalid_refs = true;
+    };
+
+    // Same check, but branch free and silent. Invalid refs still come back as
+    // null, the lookup is just an indexed load and a select.
+    struct FastRefValidation
+    {
+        static const bool check_refs = true;
+        static const bool log_invalid_refs = false;
     };
 
-    template <typename T>
+    // No check, get() is a plain indexed load. Only for refs that are known
+    // to be valid.
+    struct UncheckedRefValidation
+    {
+        static const bool check_refs = false;
+        static const bool log_invalid_refs = false;
+    };
+
+#ifdef NDEBUG
+    typedef FastRefValidation DefaultRefValidation;
+#else
+    typedef CheckedRefValidation DefaultRefValidation;
+#endif
+
+    template <typename T, typename Storage = WeakRefVectorStorage, typename Validation = DefaultRefValidation>
     class WeakRefManager
     {
     public:
         // Reserve size is basically a soft cap. If you add more refs past it,
         // the manager expands to accomodate
         WeakRefManager(uint32_t in_reserve_size, uint32_t in_min_free_indices = 1024)
-            : reserve_size(in_reserve_size)
+            : free_head(WEAKREF_INVALID_INDEX)
+            , free_tail(WEAKREF_INVALID_INDEX)
+            , num_free(0)
+            , reserve_size(0)
             , min_free_indices(in_min_free_indices)
         {
-            grow(reserve_size);
+            // Always have at least one slot, lookups rely on slot 0 existing
+            grow(in_reserve_size > 0 ? in_reserve_size : 1);
         }
 
-        WeakRef add(T val)
+        // type is stamped into the ref, and refs only resolve with the type
+        // they were added with
+        WeakRef add(T val, uint8_t type = 0)
         {
-            if (free_indices.size() < min_free_indices)
+            if (num_free < min_free_indices || num_free == 0)
             {
-                grow(reserve_size * 2);
+                grow(Storage::next_reserve_size(reserve_size));
             }
 
-            uint32_t index = free_indices.front();
-            free_indices.pop();
-            uint8_t generation = generations[index];
-            data[index] = val;
+            // Pop the head of the free list
+            uint32_t index = free_head;
+            Slot& slot = slots[index];
+            free_head = slot.next_free;
+            if (free_head == WEAKREF_INVALID_INDEX)
+                free_tail = WEAKREF_INVALID_INDEX;
+            num_free--;
+
+            // Generation 0 is never handed out, so a default constructed
+            // WeakRef can't resolve to anything. Skip it when the generation
+            // wraps around too.
+            uint32_t generation = slot.check & WEAKREF_GENERATION_MASK;
+            if (generation == 0)
+                generation = 1;
+
+            slot.value = val;
+            slot.check = generation | ((uint32_t) type << WEAKREF_TYPE_SHIFT);
             return (WeakRef) {
                 index,
-                generation
+                generation,
+                type
             };
         }
 
-        bool ref_is_valid(WeakRef& ref)
+        bool ref_is_valid(const WeakRef& ref)
         {
-            uint8_t current_generation = generations[ref.index];
-            return ref.index < data.size() && current_generation == ref.generation;
+            return ref.index < slots.size() && slots[ref.index].check == weakref_check(ref);
         }
 
         void remove(WeakRef ref)
         {
             if (!ref_is_valid(ref))
             {
-                log_invalid_ref_warning(ref);
+                if (Validation::log_invalid_refs)
+                    log_invalid_ref_warning(ref);
                 return;
             }
 
-            free_indices.push(ref.index);
-            generations[ref.index]++;
+            Slot& slot = slots[ref.index];
+            slot.check = weakref_next_check(slot.check);
+            push_free(ref.index);
         }
 
         T* get(WeakRef ref)
         {
+            if (!Validation::check_refs)
+                return &slots[ref.index].value;
+
+            if (!Validation::log_invalid_refs)
+            {
+                // Out of bounds refs read slot 0 and fail the index compare,
+                // then the pointer is masked to null instead of branching
+                uint32_t index = ref.index < slots.size() ? ref.index : 0;
+                Slot& slot = slots[index];
+                uintptr_t valid = (index == ref.index) & (slot.check == weakref_check(ref));
+                return (T*) ((uintptr_t) &slot.value & (0 - valid));
+            }
+
             if (!ref_is_valid(ref))
             {
                 log_invalid_ref_warning(ref);
                 return nullptr;
             }
 
-            return &data[ref.index];
+            return &slots[ref.index].value;
+        }
+
+        // Returns fallback for invalid refs. Never logs or branches whatever
+        // the validation policy, so it's meant for small T like indices.
+        T get_or(WeakRef ref, T fallback)
+        {
+            uint32_t index = ref.index < slots.size() ? ref.index : 0;
+            const Slot& slot = slots[index];
+            bool valid = (index == ref.index) & (slot.check == weakref_check(ref));
+            return valid ? slot.value : fallback;
+        }
+
+        // Batched versions of add, get and remove. Invalid refs are reported
+        // through out_invalid_mask instead of being logged one at a time. Bit i
+        // of the mask is set if refs[i] was invalid, so the mask needs
+        // (num_refs + 63) / 64 words. Both return the number of invalid refs.
+
+        void add_many(const T* vals, size_t num_vals, WeakRef* out_refs, uint8_t type = 0)
+        {
+            while (num_free < min_free_indices + num_vals || num_free == 0)
+            {
+                grow(Storage::next_reserve_size(reserve_size));
+            }
+
+            for (size_t i = 0; i < num_vals; i++)
+                out_refs[i] = add(vals[i], type);
+        }
+
+        // out_values[i] is null for invalid refs
+        size_t get_many(const WeakRef* refs, size_t num_refs, T** out_values, uint64_t* out_invalid_mask)
+        {
+            uint32_t indices[WEAKREF_BATCH_SIZE];
+            uint32_t ref_checks[WEAKREF_BATCH_SIZE];
+            uint32_t slot_checks[WEAKREF_BATCH_SIZE];
+            uint32_t num_slots = slots.size();
+            size_t num_invalid = 0;
+
+            for (size_t batch_start = 0; batch_start < num_refs; batch_start += WEAKREF_BATCH_SIZE)
+            {
+                size_t count = num_refs - batch_start < WEAKREF_BATCH_SIZE ? num_refs - batch_start : WEAKREF_BATCH_SIZE;
+                const WeakRef* batch = &refs[batch_start];
+
+                // Gather. Out of bounds refs read slot 0 and get masked out.
+                for (size_t i = 0; i < count; i++)
+                {
+                    uint32_t index = batch[i].index;
+                    Slot& slot = slots[index < num_slots ? index : 0];
+                    indices[i] = index;
+                    ref_checks[i] = weakref_check(batch[i]);
+                    slot_checks[i] = slot.check;
+                    out_values[batch_start + i] = &slot.value;
+                }
+
+                uint64_t mask = weakref_invalid_mask(indices, ref_checks, slot_checks, num_slots, count);
+                for (uint64_t bits = mask; bits; bits &= bits - 1)
+                    out_values[batch_start + lowest_bit_index(bits)] = nullptr;
+
+                out_invalid_mask[batch_start / WEAKREF_BATCH_SIZE] = mask;
+                num_invalid += count_bits(mask);
+            }
+
+            return num_invalid;
+        }
+
+        size_t remove_many(const WeakRef* refs, size_t num_refs, uint64_t* out_invalid_mask)
+        {
+            size_t num_invalid = 0;
+            for (size_t i = 0; i < (num_refs + WEAKREF_BATCH_SIZE - 1) / WEAKREF_BATCH_SIZE; i++)
+                out_invalid_mask[i] = 0;
+
+            // Checked one at a time so a ref that shows up twice in the batch
+            // only gets removed once
+            for (size_t i = 0; i < num_refs; i++)
+            {
+                if (!ref_is_valid(refs[i]))
+                {
+                    out_invalid_mask[i / WEAKREF_BATCH_SIZE] |= (uint64_t) 1 << (i % WEAKREF_BATCH_SIZE);
+                    num_invalid++;
+                    continue;
+                }
+
+                slots[refs[i].index].check = weakref_next_check(slots[refs[i].index].check);
+                push_free(refs[i].index);
+            }
+
+            return num_invalid;
         }
     private:
-        std::vector<T> data;
-        std::vector<uint8_t> generations;
-        std::queue<size_t> free_indices;
+        // The free list is threaded through the slots, so a free slot's
+        // next_free points at the next free slot. Indices are reused in FIFO
+        // order, which keeps the generations from wrapping around on a slot
+        // that's being churned. check holds the generation and type tag in
+        // the same layout as the top half of a WeakRef.
+        struct Slot
+        {
+            T value;
+            uint32_t next_free;
+            uint32_t check;
+        };
+
+        typename Storage::template Container<Slot> slots;
+        uint32_t free_head;
+        uint32_t free_tail;
+        uint32_t num_free;
 
         uint32_t reserve_size;
         uint32_t min_free_indices;
 
         void log_invalid_ref_warning(const WeakRef& ref)
         {
-            uint8_t current_generation = generations[ref.index];
-            LOG_WARNING("Invalid ref. Index should be less than %llu, is %u. Generation should be %d, is %d", data.size(), ref.index, current_generation, ref.generation);
+            if (ref.index >= slots.size())
+            {
+                LOG_WARNING_CH(LOG_CHANNEL_UTILS, "Invalid ref. Index should be less than %zu, is %u", slots.size(), ref.index);
+                return;
+            }
+
+            uint32_t current_check = slots[ref.index].check;
+            LOG_WARNING_CH(LOG_CHANNEL_UTILS, "Invalid ref. Generation should be %u, is %u. Type should be %u, is %u",
+                current_check & WEAKREF_GENERATION_MASK, (uint32_t) ref.generation,
+                current_check >> WEAKREF_TYPE_SHIFT, (uint32_t) ref.type);
+        }
+
+        void push_free(uint32_t index)
+        {
+            slots[index].next_free = WEAKREF_INVALID_INDEX;
+            if (free_tail == WEAKREF_INVALID_INDEX)
+                free_head = index;
+            else
+                slots[free_tail].next_free = index;
+            free_tail = index;
+            num_free++;
         }
 
-        void grow(size_t new_reserve_size)
+        void grow(uint32_t new_reserve_size)
         {
             ASSERT(new_reserve_size >= reserve_size);
+            uint32_t old_size = slots.size();
             reserve_size = new_reserve_size;
-            data.reserve(reserve_size);
-            generations.reserve(reserve_size);
+            slots.resize(reserve_size);
+
+            // Never issued slots start at generation 1, a check word no
+            // default or forged generation 0 ref can match
+            for (uint32_t i = old_size; i < reserve_size; i++)
+            {
+                slots[i].check = 1;
+                push_free(i);
+            }
+        }
+    };
+    // Slot map flavour of WeakRefManager. Live values are kept packed in a
+    // dense array and the refs index a sparse table of dense positions, so
+    // for_each walks live values linearly without stepping over dead slots.
+    // Removal moves the last value into the hole, so pointers from get() are
+    // only good until the next remove.
+    template <typename T, typename Validation = DefaultRefValidation>
+    class DenseWeakRefManager
+    {
+    public:
+        DenseWeakRefManager(uint32_t in_reserve_size, uint32_t in_min_free_indices = 1024)
+            : sparse(in_reserve_size, in_min_free_indices)
+        {
+            values.reserve(in_reserve_size);
+            dense_refs.reserve(in_reserve_size);
+        }
+
+        WeakRef add(T val, uint8_t type = 0)
+        {
+            WeakRef ref = sparse.add(values.size(), type);
+            values.push_back(val);
+            dense_refs.push_back(ref);
+            return ref;
+        }
+
+        bool ref_is_valid(const WeakRef& ref)
+        {
+            return sparse.ref_is_valid(ref);
+        }
+
+        void remove(WeakRef ref)
+        {
+            if (!sparse.ref_is_valid(ref))
+            {
+                // Let the sparse manager log it if the policy wants logging
+                sparse.remove(ref);
+                return;
+            }
+            uint32_t* dense_index = sparse.get(ref);
+            if (!dense_index_matches(ref, *dense_index))
+            {
+                LOG_WARNING_CH(LOG_CHANNEL_UTILS, "Invalid ref. Dense index %u doesn't belong to ref %u", *dense_index, ref.index);
+                return;
+            }
+
+            // Fill the hole with the last value and repoint its sparse slot
+            uint32_t last_index = values.size() - 1;
+            if (*dense_index != last_index)
+            {
+                values[*dense_index] = values[last_index];
+                dense_refs[*dense_index] = dense_refs[last_index];
+                *sparse.get(dense_refs[*dense_index]) = *dense_index;
+            }
+
+            values.pop_back();
+            dense_refs.pop_back();
+            sparse.remove(ref);
+        }
+
+        T* get(WeakRef ref)
+        {
+            if (!Validation::check_refs)
+                return &values[*sparse.get(ref)];
+
+            if (!Validation::log_invalid_refs)
+            {
+                uint32_t dense_index = sparse.get_or(ref, WEAKREF_INVALID_INDEX);
+                uintptr_t valid = dense_index_matches(ref, dense_index);
+                T* value = values.data() + (dense_index & (0 - (uint32_t) valid));
+                return (T*) ((uintptr_t) value & (0 - valid));
+            }
+
+            uint32_t* dense_index = sparse.get(ref);
+            if (!dense_index)
+                return nullptr;
+            if (!dense_index_matches(ref, *dense_index))
+            {
+                LOG_WARNING_CH(LOG_CHANNEL_UTILS, "Invalid ref. Dense index %u doesn't belong to ref %u", *dense_index, ref.index);
+                return nullptr;
+            }
+
+            return &values[*dense_index];
+        }
+
+        size_t size() const
+        {
+            return values.size();
+        }
+
+        // Calls func(const WeakRef& ref, T& value) for every live value, in
+        // dense order. Don't add or remove from inside func.
+        template <typename Func>
+        void for_each(Func func)
+        {
+            for (size_t i = 0; i < values.size(); i++)
+                func(dense_refs[i], values[i]);
+        }
+    private:
+        WeakRefManager<uint32_t, WeakRefVectorStorage, Validation> sparse;
+        std::vector<T> values;
+        std::vector<WeakRef> dense_refs;
+
+        // The sparse slot only says where the value should be. Don't trust
+        // it unless the dense side agrees the value there is this ref's.
+        bool dense_index_matches(const WeakRef& ref, uint32_t dense_index) const
+        {
+            return dense_index < values.size() && dense_refs[dense_index] == ref;
+        }
+    };
+    // Lock free flavour of WeakRefManager for refs that are added, resolved and
+    // removed from several threads at once. Slots live in pages that are never
+    // moved or freed, free indices sit on an atomic stack, and a slot's
+    // check word is bumped on both add and remove, so a live slot has an odd
+    // generation and get() only succeeds once add has published the value.
+    // As with the other managers, don't keep using a value after another
+    // thread might have removed its ref.
+    template <typename T, uint32_t slots_per_page = 1024, uint32_t max_pages = 4096>
+    class ConcurrentWeakRefManager
+    {
+    public:
+        ConcurrentWeakRefManager(uint32_t in_reserve_size)
+            : free_head(WEAKREF_INVALID_INDEX)
+            , num_reserved(0)
+        {
+            for (uint32_t i = 0; i < max_pages; i++)
+                pages[i].store(nullptr, std::memory_order_relaxed);
+
+            for (uint32_t i = 0; i * slots_per_page < in_reserve_size; i++)
+                ensure_page(i);
+        }
+
+        ~ConcurrentWeakRefManager()
+        {
+            for (uint32_t i = 0; i < max_pages; i++)
+                delete[] pages[i].load(std::memory_order_relaxed);
+        }
+
+        WeakRef add(T val, uint8_t type = 0)
+        {
+            uint32_t index = pop_free();
+            if (index == WEAKREF_INVALID_INDEX)
+                index = reserve_index();
+
+            Slot& slot = get_slot(index);
+            slot.value = val;
+
+            // Publish the value. Readers that see the new check word also see
+            // the value written above.
+            uint32_t generation = weakref_next_check(slot.check.load(std::memory_order_relaxed)) & WEAKREF_GENERATION_MASK;
+            slot.check.store(generation | ((uint32_t) type << WEAKREF_TYPE_SHIFT), std::memory_order_release);
+
+            return (WeakRef) {
+                index,
+                generation,
+                type
+            };
+        }
+
+        bool ref_is_valid(const WeakRef& ref)
+        {
+            // Live slots always have an odd generation, which also keeps
+            // never issued slots from matching a default WeakRef
+            Slot* slot = find_slot(ref.index);
+            return slot && (ref.generation & 1) && slot->check.load(std::memory_order_acquire) == weakref_check(ref);
+        }
+
+        // Returns false if the ref was already invalid, including when another
+        // thread removed it first
+        bool remove(WeakRef ref)
+        {
+            Slot* slot = find_slot(ref.index);
+            uint32_t expected_check = weakref_check(ref);
+            if (!slot || (ref.generation & 1) == 0 ||
+                !slot->check.compare_exchange_strong(expected_check, weakref_next_check(expected_check), std::memory_order_acq_rel))
+            {
+                LOG_WARNING_CH(LOG_CHANNEL_UTILS, "Invalid ref. Index is %u, generation is %u", ref.index, (uint32_t) ref.generation);
+                return false;
+            }
+
+            push_free(ref.index);
+            return true;
+        }
+
+        T* get(WeakRef ref)
+        {
+            if (!ref_is_valid(ref))
+            {
+                LOG_WARNING_CH(LOG_CHANNEL_UTILS, "Invalid ref. Index is %u, generation is %u", ref.index, (uint32_t) ref.generation);
+                return nullptr;
+            }
+
+            return &get_slot(ref.index).value;
+        }
+    private:
+        struct Slot
+        {
+            Slot() : value(), check(0), next_free(WEAKREF_INVALID_INDEX) {}
+
+            T value;
+            std::atomic<uint32_t> check;
+            std::atomic<uint32_t> next_free;
+        };
 
-            for (size_t i = data.size(); i < reserve_size; i++)
+        // Low 32 bits are the index at the top of the free stack, high 32 bits
+        // are bumped on every push and pop so a stale head can't win a CAS
+        alignas(64) std::atomic<uint64_t> free_head;
+        // Indices below this have been handed out at least once
+        alignas(64) std::atomic<uint32_t> num_reserved;
+        alignas(64) std::atomic<Slot*> pages[max_pages];
+
+        Slot& get_slot(uint32_t index)
+        {
+            return pages[index / slots_per_page].load(std::memory_order_acquire)[index % slots_per_page];
+        }
+
+        Slot* find_slot(uint32_t index)
+        {
+            if (index >= num_reserved.load(std::memory_order_acquire))
+                return nullptr;
+
+            Slot* page = pages[index / slots_per_page].load(std::memory_order_acquire);
+            return page ? &page[index % slots_per_page] : nullptr;
+        }
+
+        void ensure_page(uint32_t page_index)
+        {
+            if (pages[page_index].load(std::memory_order_acquire))
+                return;
+
+            // Several threads can race to allocate the same page. One wins,
+            // the rest throw theirs away.
+            Slot* new_page = new Slot[slots_per_page];
+            Slot* expected_page = nullptr;
+            if (!pages[page_index].compare_exchange_strong(expected_page, new_page, std::memory_order_acq_rel))
+                delete[] new_page;
+        }
+
+        uint32_t reserve_index()
+        {
+            uint32_t index = num_reserved.load(std::memory_order_relaxed);
+            do
             {
-                free_indices.push(i);
+                ASSERT_MSG(index < slots_per_page * max_pages, "ConcurrentWeakRefManager is full, max %u refs", slots_per_page * max_pages);
+                ensure_page(index / slots_per_page);
+            } while (!num_reserved.compare_exchange_weak(index, index + 1, std::memory_order_acq_rel));
 
-                T default_value;
-                data.push_back(default_value);
+            return index;
+        }
+
+        uint32_t pop_free()
+        {
+            uint64_t head = free_head.load(std::memory_order_acquire);
+            while (true)
+            {
+                uint32_t index = (uint32_t) head;
+                if (index == WEAKREF_INVALID_INDEX)
+                    return WEAKREF_INVALID_INDEX;
 
-                generations.push_back(0);
+                uint32_t next = get_slot(index).next_free.load(std::memory_order_relaxed);
+                uint64_t new_head = (((head >> 32) + 1) << 32) | next;
+                if (free_head.compare_exchange_weak(head, new_head, std::memory_order_acq_rel, std::memory_order_acquire))
+                    return index;
             }
         }
+
+        void push_free(uint32_t index)
+        {
+            Slot& slot = get_slot(index);
+            uint64_t head = free_head.load(std::memory_order_relaxed);
+            uint64_t new_head;
+            do
+            {
+                slot.next_free.store((uint32_t) head, std::memory_order_relaxed);
+                new_head = (((head >> 32) + 1) << 32) | index;
+            } while (!free_head.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed));
+        }
+    };
+}
+
+namespace std
+{
+    template <>
+    struct hash<Utils::WeakRef>
+    {
+        size_t operator()(const Utils::WeakRef& ref) const
+        {
+            return hash<uint64_t>()(Utils::weakref_bits(ref));
+        }
     };
 }
\ No newline at end of file
@@ -0,0 +1,524 @@
+#include "utils_log.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils
+{
+    std::atomic<uint32_t> log_enabled_channels(LOG_CHANNEL_ALL);
+
+////////////////////////////////////////////////////////////////////////////////
+// Rings
+////////////////////////////////////////////////////////////////////////////////
+
+    // Records are 16 byte aligned so a header always fits in the space left
+    // before the end of the ring. A header with a null site is padding the
+    // consumer skips over.
+    struct alignas(16) LogRecordHeader
+    {
+        const LogSite* site;
+        uint32_t size;
+    };
+
+    #define LOG_RECORD_ALIGNMENT 16
+    // Anything bigger gets dropped, so one message can't hog a whole ring
+    #define LOG_MAX_RECORD_SIZE (LOG_RING_SIZE / 4)
+
+    // Single producer, single consumer. head and tail count bytes ever
+    // written and read, and are on their own cache lines so the producer and
+    // consumer don't fight over them.
+    struct LogRing
+    {
+        LogRing()
+            : head(0)
+            , tail(0)
+            , retired(false)
+            , pending_head(0)
+        {
+        }
+
+        alignas(64) uint8_t data[LOG_RING_SIZE];
+        alignas(64) std::atomic<size_t> head;
+        alignas(64) std::atomic<size_t> tail;
+        std::atomic<bool> retired;
+
+        // Producer only: where the record being written ends
+        size_t pending_head;
+    };
+
+    struct Logger
+    {
+        Logger()
+            : output(stderr)
+            , num_dropped(0)
+            , running(false)
+        {
+        }
+
+        // Only held to register a new thread's ring, or for the consumer to
+        // swap the list out. Never held while formatting or writing.
+        std::mutex rings_mutex;
+        std::vector<LogRing*> rings;
+        // The list being drained, swapped with rings so neither reallocates
+        // once they've grown. Consumer only.
+        std::vector<LogRing*> draining_rings;
+
+        // Held while draining, so the background thread and log_flush never
+        // consume from the same ring at once
+        std::mutex drain_mutex;
+        FILE* output;
+
+        std::atomic<size_t> num_dropped;
+
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        std::atomic<bool> running;
+        std::thread thread;
+    };
+
+    static Logger* get_logger();
+
+    // Plain pointer with no destructor, so it's still safe to read from
+    // atexit handlers and static destructors that run after the guard below
+    static thread_local LogRing* thread_ring = nullptr;
+
+    // Marks the thread's ring retired when the thread exits, and forgets it,
+    // since the consumer frees it once it's been drained. Anything the thread
+    // logs after that gets a fresh ring.
+    struct LogThreadRingGuard
+    {
+        ~LogThreadRingGuard()
+        {
+            if (thread_ring)
+                thread_ring->retired.store(true, std::memory_order_release);
+            thread_ring = nullptr;
+        }
+    };
+
+    static LogRing* get_thread_ring()
+    {
+        if (!thread_ring)
+        {
+            // Constructed on the thread's first log. Once destroyed it isn't
+            // constructed again, so a ring registered during thread exit is
+            // never retired; it's drained but not freed.
+            static thread_local LogThreadRingGuard guard;
+            (void) guard;
+
+            Logger* logger = get_logger();
+            LogRing* ring = new LogRing();
+            {
+                std::lock_guard<std::mutex> lock(logger->rings_mutex);
+                logger->rings.push_back(ring);
+            }
+            thread_ring = ring;
+        }
+        return thread_ring;
+    }
+
+    static size_t align_record_size(size_t size)
+    {
+        return (size + LOG_RECORD_ALIGNMENT - 1) & ~(size_t) (LOG_RECORD_ALIGNMENT - 1);
+    }
+
+    uint8_t* log_begin_record(const LogSite* site, size_t args_size)
+    {
+        LogRing* ring = get_thread_ring();
+
+        size_t size = align_record_size(sizeof(LogRecordHeader) + args_size);
+        if (size > LOG_MAX_RECORD_SIZE)
+        {
+            get_logger()->num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        size_t head = ring->head.load(std::memory_order_relaxed);
+        size_t offset = head % LOG_RING_SIZE;
+
+        // Records don't wrap. If this one doesn't fit before the end of the
+        // ring, pad out the rest and start again at the beginning.
+        size_t padding = offset + size > LOG_RING_SIZE ? LOG_RING_SIZE - offset : 0;
+        size_t tail = ring->tail.load(std::memory_order_acquire);
+        if (head + padding + size - tail > LOG_RING_SIZE)
+        {
+            get_logger()->num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        if (padding)
+        {
+            LogRecordHeader* pad = (LogRecordHeader*) &ring->data[offset];
+            pad->site = nullptr;
+            pad->size = padding;
+            head += padding;
+            offset = 0;
+        }
+
+        LogRecordHeader* header = (LogRecordHeader*) &ring->data[offset];
+        header->site = site;
+        header->size = size;
+        // Padding is only published along with the record after it
+        ring->pending_head = head + size;
+        return (uint8_t*) (header + 1);
+    }
+
+    void log_end_record()
+    {
+        LogRing* ring = thread_ring;
+        ring->head.store(ring->pending_head, std::memory_order_release);
+
+        // Nobody's left to drain it after shutdown
+        if (!get_logger()->running.load(std::memory_order_relaxed))
+            log_flush();
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// Formatting
+////////////////////////////////////////////////////////////////////////////////
+
+    struct LogArg
+    {
+        LogArgType type;
+        union
+        {
+            int64_t i;
+            uint64_t u;
+            double d;
+        };
+        const char* string;
+        uint32_t length;
+    };
+
+    static const uint8_t* decode_arg(const uint8_t* in, const uint8_t* end, LogArg* arg)
+    {
+        if (in >= end)
+            return nullptr;
+
+        arg->type = (LogArgType) *in++;
+        if (arg->type == LOG_ARG_STRING)
+        {
+            memcpy(&arg->length, in, sizeof(arg->length));
+            arg->string = (const char*) in + sizeof(arg->length);
+            return in + sizeof(arg->length) + arg->length;
+        }
+
+        memcpy(&arg->u, in, sizeof(arg->u));
+        return in + sizeof(arg->u);
+    }
+
+    struct LineBuffer
+    {
+        char data[4096];
+        size_t length;
+
+        void append(const char* text, size_t text_length)
+        {
+            size_t space = sizeof(data) - 1 - length;
+            if (text_length > space)
+                text_length = space;
+            memcpy(&data[length], text, text_length);
+            length += text_length;
+        }
+
+        template <typename T>
+        void append_formatted(const char* spec, T value)
+        {
+            size_t space = sizeof(data) - length;
+            int written = snprintf(&data[length], space, spec, value);
+            if (written > 0)
+                length += (size_t) written < space ? written : space - 1;
+        }
+    };
+
+    static const char* level_name(int level)
+    {
+        switch (level)
+        {
+            case LOG_LEVEL_VERBOSE: return "VERBOSE";
+            case LOG_LEVEL_INFO: return "INFO";
+            case LOG_LEVEL_WARNING: return "WARNING";
+            case LOG_LEVEL_ERROR: return "ERROR";
+            default: return "LOG";
+        }
+    }
+
+    static const char* channel_name(uint32_t channel)
+    {
+        switch (channel)
+        {
+            case LOG_CHANNEL_GENERAL: return "general";
+            case LOG_CHANNEL_GRAPHICS: return "graphics";
+            case LOG_CHANNEL_IO: return "io";
+            case LOG_CHANNEL_UTILS: return "utils";
+            default: return "misc";
+        }
+    }
+
+    // Walks the printf style format string and formats one conversion at a
+    // time against the decoded arguments. Length modifiers in the format
+    // are ignored, every integer was widened to 64 bits when it was encoded.
+    static void format_record(LineBuffer* line, const LogSite* site, const uint8_t* args, const uint8_t* args_end)
+    {
+        const char* format = site->format;
+        while (*format)
+        {
+            const char* literal_end = strchr(format, '%');
+            if (!literal_end)
+            {
+                line->append(format, strlen(format));
+                break;
+            }
+            line->append(format, literal_end - format);
+            format = literal_end + 1;
+
+            if (*format == '%')
+            {
+                line->append("%", 1);
+                format++;
+                continue;
+            }
+
+            // Copy flags, width and precision, skip length modifiers
+            char spec[32] = "%";
+            size_t spec_length = 1;
+            while (*format && strchr("-+ #0123456789.", *format) && spec_length < sizeof(spec) - 4)
+                spec[spec_length++] = *format++;
+            while (*format && strchr("hlLqjzt", *format))
+                format++;
+
+            char conversion = *format;
+            if (!conversion)
+                break;
+            format++;
+
+            LogArg arg = LogArg();
+            args = decode_arg(args, args_end, &arg);
+            if (!args)
+            {
+                line->append("<missing>", 9);
+                args = args_end;
+                continue;
+            }
+
+            switch (conversion)
+            {
+                case 'd':
+                case 'i':
+                    memcpy(&spec[spec_length], "lld", 4);
+                    line->append_formatted(spec, (long long) arg.i);
+                    break;
+                case 'u':
+                case 'x':
+                case 'X':
+                case 'o':
+                    spec[spec_length++] = 'l';
+                    spec[spec_length++] = 'l';
+                    spec[spec_length++] = conversion;
+                    spec[spec_length] = '\0';
+                    line->append_formatted(spec, (unsigned long long) arg.u);
+                    break;
+                case 'f':
+                case 'F':
+                case 'e':
+                case 'E':
+                case 'g':
+                case 'G':
+                case 'a':
+                case 'A':
+                    spec[spec_length++] = conversion;
+                    spec[spec_length] = '\0';
+                    line->append_formatted(spec, arg.type == LOG_ARG_DOUBLE ? arg.d : (double) arg.i);
+                    break;
+                case 'c':
+                    spec[spec_length++] = 'c';
+                    spec[spec_length] = '\0';
+                    line->append_formatted(spec, (int) arg.i);
+                    break;
+                case 'p':
+                    spec[spec_length++] = 'p';
+                    spec[spec_length] = '\0';
+                    line->append_formatted(spec, (void*) (uintptr_t) arg.u);
+                    break;
+                case 's':
+                    if (arg.type != LOG_ARG_STRING)
+                    {
+                        line->append("<not a string>", 14);
+                        break;
+                    }
+                    // Strings aren't null terminated in the record, go through
+                    // a precision so snprintf still honours width and flags
+                    memcpy(&spec[spec_length], ".*s", 4);
+                    {
+                        size_t space = sizeof(line->data) - line->length;
+                        int written = snprintf(&line->data[line->length], space, spec, (int) arg.length, arg.string);
+                        if (written > 0)
+                            line->length += (size_t) written < space ? written : space - 1;
+                    }
+                    break;
+                default:
+                    line->append("<bad format>", 12);
+                    break;
+            }
+        }
+    }
+
+    // Consumes everything currently in the ring. Caller holds drain_mutex.
+    static bool drain_ring(Logger* logger, LogRing* ring)
+    {
+        size_t tail = ring->tail.load(std::memory_order_relaxed);
+        size_t head = ring->head.load(std::memory_order_acquire);
+        if (tail == head)
+            return false;
+
+        while (tail != head)
+        {
+            const LogRecordHeader* header = (const LogRecordHeader*) &ring->data[tail % LOG_RING_SIZE];
+            if (header->site)
+            {
+                const LogSite* site = header->site;
+                LineBuffer line;
+                line.length = 0;
+                line.append_formatted("%s ", level_name(site->level));
+                line.append_formatted("[%s] ", channel_name(site->channel));
+                line.append_formatted("%s::", site->file);
+                line.append_formatted("%s, ", site->function);
+                line.append_formatted("line %d: ", site->line);
+
+                const uint8_t* args = (const uint8_t*) (header + 1);
+                format_record(&line, site, args, (const uint8_t*) header + header->size);
+                line.append("\n", 1);
+                fwrite(line.data, 1, line.length, logger->output);
+            }
+            tail += header->size;
+        }
+
+        ring->tail.store(tail, std::memory_order_release);
+        return true;
+    }
+
+    // Returns whether anything was written
+    static bool drain_all(Logger* logger, bool free_retired_rings)
+    {
+        bool drained = false;
+
+        // Take the list so new threads can register while we write
+        std::vector<LogRing*>& rings = logger->draining_rings;
+        {
+            std::lock_guard<std::mutex> rings_lock(logger->rings_mutex);
+            rings.swap(logger->rings);
+        }
+
+        for (size_t i = 0; i < rings.size(); i++)
+        {
+            LogRing* ring = rings[i];
+
+            // Check before draining, a ring retired after the drain might
+            // have had one last record written to it
+            bool retired = ring->retired.load(std::memory_order_acquire);
+            drained |= drain_ring(logger, ring);
+
+            if (retired && free_retired_rings)
+            {
+                delete ring;
+                rings[i] = rings.back();
+                rings.pop_back();
+                i--;
+            }
+        }
+
+        // Put it back, along with any rings registered in the meantime
+        {
+            std::lock_guard<std::mutex> rings_lock(logger->rings_mutex);
+            rings.insert(rings.end(), logger->rings.begin(), logger->rings.end());
+            logger->rings.clear();
+            rings.swap(logger->rings);
+        }
+
+        static size_t num_dropped_reported = 0;
+        size_t num_dropped = logger->num_dropped.load(std::memory_order_relaxed);
+        if (num_dropped != num_dropped_reported)
+        {
+            fprintf(logger->output, "WARNING %zu log messages dropped\n", num_dropped - num_dropped_reported);
+            num_dropped_reported = num_dropped;
+            drained = true;
+        }
+
+        if (drained)
+            fflush(logger->output);
+        return drained;
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// Background thread
+////////////////////////////////////////////////////////////////////////////////
+
+    static void logger_thread(Logger* logger)
+    {
+        while (logger->running.load(std::memory_order_acquire))
+        {
+            bool drained;
+            {
+                std::lock_guard<std::mutex> lock(logger->drain_mutex);
+                drained = drain_all(logger, true);
+            }
+
+            if (!drained)
+            {
+                std::unique_lock<std::mutex> lock(logger->wake_mutex);
+                logger->wake.wait_for(lock, std::chrono::milliseconds(1));
+            }
+        }
+    }
+
+    static void shutdown_logger()
+    {
+        Logger* logger = get_logger();
+        logger->running.store(false, std::memory_order_release);
+        logger->wake.notify_one();
+        if (logger->thread.joinable())
+            logger->thread.join();
+
+        // Threads can still log from here on, log_write flushes those itself.
+        // Rings aren't freed, exiting threads may still touch theirs.
+        std::lock_guard<std::mutex> lock(logger->drain_mutex);
+        drain_all(logger, false);
+    }
+
+    static Logger* get_logger()
+    {
+        // Never destroyed, threads may log during static destruction
+        static Logger* logger = []() {
+            Logger* new_logger = new Logger();
+            new_logger->running.store(true, std::memory_order_release);
+            new_logger->thread = std::thread(logger_thread, new_logger);
+            atexit(shutdown_logger);
+            return new_logger;
+        }();
+        return logger;
+    }
+
+    void log_flush()
+    {
+        Logger* logger = get_logger();
+        std::lock_guard<std::mutex> lock(logger->drain_mutex);
+        drain_all(logger, false);
+    }
+
+    void log_set_output(FILE* output)
+    {
+        Logger* logger = get_logger();
+        std::lock_guard<std::mutex> lock(logger->drain_mutex);
+        drain_all(logger, false);
+        logger->output = output;
+    }
+
+    size_t log_num_dropped()
+    {
+        return get_logger()->num_dropped.load(std::memory_order_relaxed);
+    }
+}
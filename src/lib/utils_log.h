@@ -0,0 +1,210 @@
+#pragma once
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Asynchronous logger. A log call packs its arguments into a compact binary
+// record in a ring owned by the calling thread, and a background thread turns
+// records into text. Producers never lock or share cache lines with each
+// other. Format strings, file and function names aren't copied, only a
+// pointer to the call site's static LogSite is. String arguments are copied.
+
+#define LOG_LEVEL_VERBOSE 0
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_WARNING 2
+#define LOG_LEVEL_ERROR 3
+
+// Sites below this level compile to nothing, arguments and all. Errors are
+// always compiled in. Inline code in the headers logs too, so the level has
+// to be the same in every file: CMake's LOG_COMPILE_LEVEL option sets
+// LOG_BUILD_LEVEL for everything that links lib. Without it, it follows
+// NDEBUG.
+#ifdef LOG_COMPILE_LEVEL
+#error "Set the log level for the whole build with the LOG_COMPILE_LEVEL CMake option, not per file"
+#endif
+#ifdef LOG_BUILD_LEVEL
+#define LOG_COMPILE_LEVEL LOG_BUILD_LEVEL
+#elif defined(NDEBUG)
+#define LOG_COMPILE_LEVEL LOG_LEVEL_WARNING
+#else
+#define LOG_COMPILE_LEVEL LOG_LEVEL_VERBOSE
+#endif
+
+// Channels are bits in a runtime mask. Sites that survive compilation check
+// the mask before doing anything else.
+#define LOG_CHANNEL_GENERAL (1u << 0)
+#define LOG_CHANNEL_GRAPHICS (1u << 1)
+#define LOG_CHANNEL_IO (1u << 2)
+#define LOG_CHANNEL_UTILS (1u << 3)
+#define LOG_CHANNEL_ALL 0xFFFFFFFFu
+
+// Per thread ring size in bytes. Must be a power of two. When a ring is full
+// messages are dropped and counted rather than blocking the caller.
+#define LOG_RING_SIZE (64 * 1024)
+
+namespace Utils
+{
+    struct LogSite
+    {
+        int level;
+        uint32_t channel;
+        const char* file;
+        const char* function;
+        int line;
+        const char* format;
+    };
+
+    enum LogArgType : uint8_t
+    {
+        LOG_ARG_INT,
+        LOG_ARG_UINT,
+        LOG_ARG_DOUBLE,
+        LOG_ARG_STRING,
+        LOG_ARG_POINTER
+    };
+
+    // Reserves size bytes in the calling thread's ring. Returns null if the
+    // ring is full, in which case the message is dropped.
+    uint8_t* log_begin_record(const LogSite* site, size_t args_size);
+    void log_end_record();
+
+    // Blocks until every record written so far has been formatted and written
+    // out. Errors flush on their own so they're never lost to an exit().
+    void log_flush();
+
+    // Where formatted messages go, stderr by default
+    void log_set_output(FILE* output);
+
+    size_t log_num_dropped();
+
+    // Mask of LOG_CHANNEL_* bits that are logged. Errors ignore it.
+    extern std::atomic<uint32_t> log_enabled_channels;
+
+    inline bool log_channel_enabled(int level, uint32_t channel)
+    {
+        return level >= LOG_LEVEL_ERROR || (log_enabled_channels.load(std::memory_order_relaxed) & channel);
+    }
+
+    inline void log_set_enabled_channels(uint32_t channels)
+    {
+        log_enabled_channels.store(channels, std::memory_order_relaxed);
+    }
+
+    // Argument encoding. Every argument is a type byte followed by its payload.
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, size_t>::type
+    log_arg_size(T)
+    {
+        return 1 + sizeof(uint64_t);
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, size_t>::type
+    log_arg_size(T)
+    {
+        return 1 + sizeof(double);
+    }
+
+    template <typename T>
+    size_t log_arg_size(const T*)
+    {
+        return 1 + sizeof(uint64_t);
+    }
+
+    inline size_t log_arg_size(const char* value)
+    {
+        return 1 + sizeof(uint32_t) + (value ? strlen(value) : 0);
+    }
+
+    inline size_t log_arg_size(char* value)
+    {
+        return log_arg_size((const char*) value);
+    }
+
+    inline uint8_t* log_encode_raw(uint8_t* out, LogArgType type, const void* payload, size_t payload_size)
+    {
+        *out = type;
+        memcpy(out + 1, payload, payload_size);
+        return out + 1 + payload_size;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, uint8_t*>::type
+    log_encode_arg(uint8_t* out, T value)
+    {
+        if (std::is_signed<T>::value || std::is_enum<T>::value)
+        {
+            int64_t payload = (int64_t) value;
+            return log_encode_raw(out, LOG_ARG_INT, &payload, sizeof(payload));
+        }
+
+        uint64_t payload = (uint64_t) value;
+        return log_encode_raw(out, LOG_ARG_UINT, &payload, sizeof(payload));
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value, uint8_t*>::type
+    log_encode_arg(uint8_t* out, T value)
+    {
+        double payload = value;
+        return log_encode_raw(out, LOG_ARG_DOUBLE, &payload, sizeof(payload));
+    }
+
+    template <typename T>
+    uint8_t* log_encode_arg(uint8_t* out, const T* value)
+    {
+        uint64_t payload = (uint64_t) (uintptr_t) value;
+        return log_encode_raw(out, LOG_ARG_POINTER, &payload, sizeof(payload));
+    }
+
+    inline uint8_t* log_encode_arg(uint8_t* out, const char* value)
+    {
+        uint32_t length = value ? strlen(value) : 0;
+        out = log_encode_raw(out, LOG_ARG_STRING, &length, sizeof(length));
+        memcpy(out, value, length);
+        return out + length;
+    }
+
+    inline uint8_t* log_encode_arg(uint8_t* out, char* value)
+    {
+        return log_encode_arg(out, (const char*) value);
+    }
+
+    inline size_t log_args_size()
+    {
+        return 0;
+    }
+
+    template <typename Arg, typename... Args>
+    size_t log_args_size(Arg arg, Args... args)
+    {
+        return log_arg_size(arg) + log_args_size(args...);
+    }
+
+    inline void log_encode_args(uint8_t*)
+    {
+    }
+
+    template <typename Arg, typename... Args>
+    void log_encode_args(uint8_t* out, Arg arg, Args... args)
+    {
+        log_encode_args(log_encode_arg(out, arg), args...);
+    }
+
+    template <typename... Args>
+    void log_write(const LogSite* site, Args... args)
+    {
+        uint8_t* record = log_begin_record(site, log_args_size(args...));
+        if (record)
+        {
+            log_encode_args(record, args...);
+            log_end_record();
+        }
+
+        if (site->level >= LOG_LEVEL_ERROR)
+            log_flush();
+    }
+}
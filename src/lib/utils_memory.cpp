@@ -0,0 +1,166 @@
+#include "utils_memory.h"
+
+#include <atomic>
+#include <cstdlib>
+
+namespace Utils
+{
+////////////////////////////////////////////////////////////////////////////////
+// Allocation tracking
+////////////////////////////////////////////////////////////////////////////////
+
+    static std::atomic<size_t> tracked_allocations(0);
+
+    void* tracked_malloc(size_t size)
+    {
+        tracked_allocations.fetch_add(1, std::memory_order_relaxed);
+        void* result = malloc(size);
+        ASSERT_MSG(result, "Out of memory allocating %zu bytes", size);
+        return result;
+    }
+
+    void tracked_free(void* ptr)
+    {
+        free(ptr);
+    }
+
+    size_t num_tracked_allocations()
+    {
+        return tracked_allocations.load(std::memory_order_relaxed);
+    }
+
+    static size_t align_up(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// Linear arena
+////////////////////////////////////////////////////////////////////////////////
+
+    LinearArena::LinearArena(size_t in_block_size)
+        : current_block(0)
+        , current_offset(0)
+        , block_size(in_block_size)
+    {
+        Block first_block = { (uint8_t*) tracked_malloc(block_size), block_size };
+        blocks.push_back(first_block);
+    }
+
+    LinearArena::~LinearArena()
+    {
+        for (size_t i = 0; i < blocks.size(); i++)
+            tracked_free(blocks[i].data);
+    }
+
+    void* LinearArena::allocate(size_t size, size_t alignment)
+    {
+        ASSERT_MSG((alignment & (alignment - 1)) == 0, "Alignment %zu is not a power of two", alignment);
+        ASSERT_MSG(alignment <= UTILS_DEFAULT_ALIGNMENT, "Alignment %zu is more than the arena supports", alignment);
+
+        // Blocks are malloc'd, so aligning the offset aligns the address as
+        // long as alignment doesn't exceed malloc's
+        size_t offset = align_up(current_offset, alignment);
+        while (offset + size > blocks[current_block].size)
+        {
+            current_block++;
+            offset = 0;
+
+            // Out of blocks. Oversized requests get a block of their own.
+            if (current_block == blocks.size())
+            {
+                size_t new_block_size = size > block_size ? size : block_size;
+                Block new_block = { (uint8_t*) tracked_malloc(new_block_size), new_block_size };
+                blocks.push_back(new_block);
+            }
+        }
+
+        current_offset = offset + size;
+        return blocks[current_block].data + offset;
+    }
+
+    LinearArena::Marker LinearArena::mark() const
+    {
+        return { current_block, current_offset };
+    }
+
+    void LinearArena::rewind(const Marker& marker)
+    {
+        current_block = marker.block;
+        current_offset = marker.offset;
+    }
+
+    void LinearArena::reset()
+    {
+        current_block = 0;
+        current_offset = 0;
+    }
+
+    size_t LinearArena::bytes_reserved() const
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < blocks.size(); i++)
+            result += blocks[i].size;
+        return result;
+    }
+
+////////////////////////////////////////////////////////////////////////////////
+// Pool allocator
+////////////////////////////////////////////////////////////////////////////////
+
+    PoolAllocator::PoolAllocator(size_t in_element_size, size_t in_elements_per_page)
+        : free_list(nullptr)
+        , element_size(align_up(in_element_size > sizeof(FreeElement) ? in_element_size : sizeof(FreeElement), UTILS_DEFAULT_ALIGNMENT))
+        , elements_per_page(in_elements_per_page)
+    {
+        ASSERT_MSG(elements_per_page > 0, "Pool pages need at least one element");
+    }
+
+    PoolAllocator::~PoolAllocator()
+    {
+        for (size_t i = 0; i < pages.size(); i++)
+            tracked_free(pages[i]);
+    }
+
+    void* PoolAllocator::allocate()
+    {
+        std::lock_guard<std::mutex> lock(free_list_mutex);
+        if (!free_list)
+            grow();
+
+        FreeElement* element = free_list;
+        free_list = element->next;
+        return element;
+    }
+
+    void PoolAllocator::free(void* element)
+    {
+        if (!element)
+            return;
+
+        std::lock_guard<std::mutex> lock(free_list_mutex);
+        FreeElement* free_element = (FreeElement*) element;
+        free_element->next = free_list;
+        free_list = free_element;
+    }
+
+    size_t PoolAllocator::num_pages()
+    {
+        std::lock_guard<std::mutex> lock(free_list_mutex);
+        return pages.size();
+    }
+
+    void PoolAllocator::grow()
+    {
+        uint8_t* page = (uint8_t*) tracked_malloc(element_size * elements_per_page);
+        pages.push_back(page);
+
+        // Thread the new elements onto the free list in address order
+        for (size_t i = elements_per_page; i > 0; i--)
+        {
+            FreeElement* element = (FreeElement*) (page + (i - 1) * element_size);
+            element->next = free_list;
+            free_list = element;
+        }
+    }
+}
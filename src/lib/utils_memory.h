@@ -0,0 +1,132 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "utils.h"
+
+namespace Utils
+{
+    // Every heap allocation the allocators below make goes through these, so
+    // num_tracked_allocations() only moves when an arena or pool has to grow.
+    // Steady state frames should leave it alone.
+    void* tracked_malloc(size_t size);
+    void tracked_free(void* ptr);
+    size_t num_tracked_allocations();
+
+    #define UTILS_DEFAULT_ALIGNMENT alignof(std::max_align_t)
+
+    // Bump allocator. Individual allocations are never freed, the whole arena
+    // is reset (once per frame, say) or rewound to a marker. Blocks are kept
+    // around across resets, so once it has grown to fit a frame it stops
+    // touching the heap.
+    class LinearArena
+    {
+    public:
+        struct Marker
+        {
+            size_t block;
+            size_t offset;
+        };
+
+        LinearArena(size_t in_block_size);
+        ~LinearArena();
+
+        LinearArena(const LinearArena&) = delete;
+        LinearArena& operator=(const LinearArena&) = delete;
+
+        void* allocate(size_t size, size_t alignment = UTILS_DEFAULT_ALIGNMENT);
+
+        template <typename T>
+        T* allocate_array(size_t count)
+        {
+            return (T*) allocate(sizeof(T) * count, alignof(T));
+        }
+
+        Marker mark() const;
+        void rewind(const Marker& marker);
+        void reset();
+
+        size_t bytes_reserved() const;
+    private:
+        struct Block
+        {
+            uint8_t* data;
+            size_t size;
+        };
+
+        std::vector<Block> blocks;
+        size_t current_block;
+        size_t current_offset;
+        size_t block_size;
+    };
+
+    // Rewinds the arena to where it was when the scope started, so scratch
+    // memory used inside a function is handed straight back
+    class ScratchScope
+    {
+    public:
+        ScratchScope(LinearArena& in_arena)
+            : arena(in_arena)
+            , marker(in_arena.mark())
+        {
+        }
+
+        ~ScratchScope()
+        {
+            arena.rewind(marker);
+        }
+
+        ScratchScope(const ScratchScope&) = delete;
+        ScratchScope& operator=(const ScratchScope&) = delete;
+
+        void* allocate(size_t size, size_t alignment = UTILS_DEFAULT_ALIGNMENT)
+        {
+            return arena.allocate(size, alignment);
+        }
+
+        template <typename T>
+        T* allocate_array(size_t count)
+        {
+            return arena.allocate_array<T>(count);
+        }
+    private:
+        LinearArena& arena;
+        LinearArena::Marker marker;
+    };
+
+    // Fixed size elements with an intrusive free list. Grows a page at a time
+    // and never gives pages back until it's destroyed. allocate and free take
+    // a lock, so one pool can be shared by objects that live on different
+    // threads.
+    class PoolAllocator
+    {
+    public:
+        PoolAllocator(size_t in_element_size, size_t in_elements_per_page);
+        ~PoolAllocator();
+
+        PoolAllocator(const PoolAllocator&) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+
+        // Aligned to UTILS_DEFAULT_ALIGNMENT, and at least get_element_size() bytes
+        void* allocate();
+        void free(void* element);
+
+        size_t get_element_size() const { return element_size; }
+        size_t num_pages();
+    private:
+        struct FreeElement
+        {
+            FreeElement* next;
+        };
+
+        std::mutex free_list_mutex;
+        std::vector<uint8_t*> pages;
+        FreeElement* free_list;
+        size_t element_size;
+        size_t elements_per_page;
+
+        void grow();
+    };
+}
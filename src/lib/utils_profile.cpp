@@ -0,0 +1,165 @@
+#include "utils_profile.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Utils
+{
+    // Fields are relaxed atomics so a dump racing with the owning thread is
+    // well defined. On x86 they compile to plain loads and stores.
+    struct ProfileEvent
+    {
+        std::atomic<const char*> name;
+        std::atomic<uint64_t> start_ns;
+        std::atomic<uint64_t> end_ns;
+    };
+
+    struct ProfileRing
+    {
+        ProfileRing(uint32_t in_thread_id)
+            : num_recorded(0)
+            , thread_id(in_thread_id)
+        {
+        }
+
+        ProfileEvent events[PROFILE_RING_SIZE];
+        // Total events ever recorded. Only the owning thread writes it.
+        std::atomic<uint64_t> num_recorded;
+        uint32_t thread_id;
+    };
+
+    struct Profiler
+    {
+        // Only taken when a thread records its first zone and when dumping.
+        // Rings are never freed, a dump may run after their thread exits.
+        std::mutex rings_mutex;
+        std::vector<ProfileRing*> rings;
+
+        std::string exit_dump_path;
+    };
+
+    static Profiler& get_profiler()
+    {
+        // Never destroyed, threads may still record during static destruction
+        static Profiler* profiler = new Profiler();
+        return *profiler;
+    }
+
+    static thread_local ProfileRing* thread_ring = nullptr;
+
+    static ProfileRing* get_thread_ring()
+    {
+        if (!thread_ring)
+        {
+            Profiler& profiler = get_profiler();
+            std::lock_guard<std::mutex> lock(profiler.rings_mutex);
+            thread_ring = new ProfileRing(profiler.rings.size() + 1);
+            profiler.rings.push_back(thread_ring);
+        }
+        return thread_ring;
+    }
+
+    uint64_t profile_now_ns()
+    {
+        static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+    }
+
+    void profile_record(const char* name, uint64_t start_ns, uint64_t end_ns)
+    {
+        ProfileRing* ring = get_thread_ring();
+        uint64_t index = ring->num_recorded.load(std::memory_order_relaxed);
+
+        // Keeps the field stores below after the count published by the
+        // previous record, which is what a lapped dump checks against
+        std::atomic_thread_fence(std::memory_order_release);
+        ProfileEvent& event = ring->events[index % PROFILE_RING_SIZE];
+        event.name.store(name, std::memory_order_relaxed);
+        event.start_ns.store(start_ns, std::memory_order_relaxed);
+        event.end_ns.store(end_ns, std::memory_order_relaxed);
+
+        ring->num_recorded.store(index + 1, std::memory_order_release);
+    }
+
+    static void write_json_string(FILE* file, const char* text)
+    {
+        fputc('"', file);
+        for (const char* c = text; *c; c++)
+        {
+            if (*c == '"' || *c == '\\')
+                fputc('\\', file);
+            if ((unsigned char) *c >= 0x20)
+                fputc(*c, file);
+        }
+        fputc('"', file);
+    }
+
+    bool profile_dump(const char* path)
+    {
+        FILE* file = fopen(path, "w");
+        if (!file)
+            return false;
+
+        Profiler& profiler = get_profiler();
+        std::lock_guard<std::mutex> lock(profiler.rings_mutex);
+
+        fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+        bool first = true;
+        for (size_t r = 0; r < profiler.rings.size(); r++)
+        {
+            ProfileRing* ring = profiler.rings[r];
+            uint64_t end = ring->num_recorded.load(std::memory_order_acquire);
+            // The slot after the newest event is the next one written, so at
+            // most PROFILE_RING_SIZE - 1 events are safe to read
+            uint64_t begin = end >= PROFILE_RING_SIZE ? end - PROFILE_RING_SIZE + 1 : 0;
+
+            for (uint64_t i = begin; i < end; i++)
+            {
+                const ProfileEvent& event = ring->events[i % PROFILE_RING_SIZE];
+                const char* name = event.name.load(std::memory_order_relaxed);
+                uint64_t start_ns = event.start_ns.load(std::memory_order_relaxed);
+                uint64_t end_ns = event.end_ns.load(std::memory_order_relaxed);
+
+                // The owning thread may have lapped us while we were reading.
+                // It starts on event i + PROFILE_RING_SIZE, in this slot, as
+                // soon as the count reaches that. The fence keeps the field
+                // loads above from moving past the re-read.
+                std::atomic_thread_fence(std::memory_order_acquire);
+                uint64_t num_recorded = ring->num_recorded.load(std::memory_order_relaxed);
+                if (i + PROFILE_RING_SIZE <= num_recorded)
+                    continue;
+
+                fprintf(file, first ? "\n" : ",\n");
+                first = false;
+
+                // Chrome traces are in microseconds
+                fprintf(file, "{\"name\":");
+                write_json_string(file, name);
+                fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    ring->thread_id, start_ns / 1000.0, (end_ns - start_ns) / 1000.0);
+            }
+        }
+        fprintf(file, "\n]}\n");
+
+        fclose(file);
+        return true;
+    }
+
+    static void dump_at_exit()
+    {
+        profile_dump(get_profiler().exit_dump_path.c_str());
+    }
+
+    void profile_dump_at_exit(const char* path)
+    {
+        Profiler& profiler = get_profiler();
+        bool registered = !profiler.exit_dump_path.empty();
+        profiler.exit_dump_path = path;
+        if (!registered)
+            atexit(dump_at_exit);
+    }
+}
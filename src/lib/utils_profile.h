@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Scoped CPU profiling zones. Each thread records completed zones into its
+// own fixed size ring, so recording never locks and a long session keeps the
+// most recent PROFILE_RING_SIZE - 1 zones per thread. profile_dump writes
+// them out as a Chrome trace, which chrome://tracing and Perfetto both load.
+//
+// Define PROFILE_DISABLED to compile every PROFILE_SCOPE out.
+
+#define PROFILE_RING_SIZE (64 * 1024)
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef PROFILE_DISABLED
+// name has to be a string literal, only the pointer is recorded
+#define PROFILE_SCOPE(name) Utils::ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)("" name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+
+namespace Utils
+{
+    uint64_t profile_now_ns();
+    void profile_record(const char* name, uint64_t start_ns, uint64_t end_ns);
+
+    // Writes every thread's recorded zones to path. Safe to call while other
+    // threads are still recording, zones overwritten mid-dump are skipped.
+    // Returns false if the file couldn't be opened.
+    bool profile_dump(const char* path);
+
+    // Dumps to path when the process exits
+    void profile_dump_at_exit(const char* path);
+
+    class ProfileScope
+    {
+    public:
+        ProfileScope(const char* in_name)
+            : name(in_name)
+            , start_ns(profile_now_ns())
+        {
+        }
+
+        ~ProfileScope()
+        {
+            profile_record(name, start_ns, profile_now_ns());
+        }
+
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+    private:
+        const char* name;
+        uint64_t start_ns;
+    };
+}
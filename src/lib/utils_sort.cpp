@@ -0,0 +1,222 @@
+#include "utils_sort.h"
+#include "utils.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace Utils
+{
+    #define RADIX_SORT_BUCKETS 256
+
+    SortWorkers::SortWorkers(size_t num_threads)
+        : m_generation(0)
+        , m_num_running(0)
+        , m_quit(false)
+        , m_task(nullptr)
+        , m_context(nullptr)
+    {
+        for (size_t t = 1; t < num_threads; t++)
+            m_threads.emplace_back(&SortWorkers::worker_loop, this, t);
+    }
+
+    SortWorkers::~SortWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_wake.notify_all();
+        for (size_t t = 0; t < m_threads.size(); t++)
+            m_threads[t].join();
+    }
+
+    void SortWorkers::run(void (*task)(void* context, size_t thread_index), void* context)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ASSERT_MSG(m_num_running == 0, "Sort workers already running");
+            m_task = task;
+            m_context = context;
+            m_num_running = m_threads.size();
+            m_generation++;
+        }
+        m_wake.notify_all();
+
+        task(context, 0);
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_num_running == 0; });
+    }
+
+    void SortWorkers::worker_loop(size_t thread_index)
+    {
+        uint64_t seen_generation = 0;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            m_wake.wait(lock, [&]() { return m_quit || m_generation != seen_generation; });
+            if (m_quit)
+                return;
+            seen_generation = m_generation;
+
+            lock.unlock();
+            m_task(m_context, thread_index);
+            lock.lock();
+
+            if (--m_num_running == 0)
+                m_done.notify_one();
+        }
+    }
+
+    // All the threads of a sort meet here between phases. Yields rather than
+    // sleeping, phases are short and every thread is already awake.
+    class SortBarrier
+    {
+    public:
+        SortBarrier(size_t in_num_threads)
+            : num_threads(in_num_threads)
+            , num_arrived(0)
+            , generation(0)
+        {
+        }
+
+        void wait()
+        {
+            uint32_t current_generation = generation.load(std::memory_order_acquire);
+            if (num_arrived.fetch_add(1, std::memory_order_acq_rel) + 1 == num_threads)
+            {
+                num_arrived.store(0, std::memory_order_relaxed);
+                generation.fetch_add(1, std::memory_order_release);
+                return;
+            }
+            while (generation.load(std::memory_order_acquire) == current_generation)
+                std::this_thread::yield();
+        }
+    private:
+        size_t num_threads;
+        std::atomic<size_t> num_arrived;
+        std::atomic<uint32_t> generation;
+    };
+
+    struct RadixSortJob
+    {
+        uint64_t* keys[2];
+        uint32_t* values[2];
+        size_t count;
+        size_t num_threads;
+
+        // Per thread, written by that thread and read by all after a barrier
+        std::vector<size_t> histograms;
+        std::vector<uint64_t> key_or;
+        std::vector<uint64_t> key_and;
+
+        SortBarrier barrier;
+
+        RadixSortJob(size_t in_num_threads)
+            : num_threads(in_num_threads)
+            , histograms(in_num_threads * RADIX_SORT_BUCKETS)
+            , key_or(in_num_threads)
+            , key_and(in_num_threads)
+            , barrier(in_num_threads)
+        {
+        }
+    };
+
+    static void radix_sort_worker(void* context, size_t thread_index)
+    {
+        RadixSortJob* job = (RadixSortJob*) context;
+        const size_t begin = job->count * thread_index / job->num_threads;
+        const size_t end = job->count * (thread_index + 1) / job->num_threads;
+
+        // Find which bytes actually differ between keys
+        uint64_t key_or = 0;
+        uint64_t key_and = ~0ull;
+        for (size_t i = begin; i < end; i++)
+        {
+            key_or |= job->keys[0][i];
+            key_and &= job->keys[0][i];
+        }
+        job->key_or[thread_index] = key_or;
+        job->key_and[thread_index] = key_and;
+        job->barrier.wait();
+
+        for (size_t t = 0; t < job->num_threads; t++)
+        {
+            key_or |= job->key_or[t];
+            key_and &= job->key_and[t];
+        }
+        const uint64_t differing_bits = key_or ^ key_and;
+
+        size_t* histogram = &job->histograms[thread_index * RADIX_SORT_BUCKETS];
+        size_t offsets[RADIX_SORT_BUCKETS];
+        size_t source = 0;
+        for (size_t shift = 0; shift < 64; shift += 8)
+        {
+            if (((differing_bits >> shift) & 0xFF) == 0)
+                continue;
+
+            const uint64_t* source_keys = job->keys[source];
+            const uint32_t* source_values = job->values[source];
+            uint64_t* dest_keys = job->keys[source ^ 1];
+            uint32_t* dest_values = job->values[source ^ 1];
+
+            memset(histogram, 0, sizeof(size_t) * RADIX_SORT_BUCKETS);
+            for (size_t i = begin; i < end; i++)
+                histogram[(source_keys[i] >> shift) & 0xFF]++;
+            job->barrier.wait();
+
+            // This thread's elements of each bucket go after every element of
+            // the smaller buckets, and after earlier threads' elements of the
+            // same bucket. That keeps the sort stable.
+            size_t bucket_start = 0;
+            for (size_t bucket = 0; bucket < RADIX_SORT_BUCKETS; bucket++)
+            {
+                size_t offset = bucket_start;
+                for (size_t t = 0; t < job->num_threads; t++)
+                {
+                    size_t bucket_count = job->histograms[t * RADIX_SORT_BUCKETS + bucket];
+                    if (t < thread_index)
+                        offset += bucket_count;
+                    bucket_start += bucket_count;
+                }
+                offsets[bucket] = offset;
+            }
+
+            for (size_t i = begin; i < end; i++)
+            {
+                size_t dest = offsets[(source_keys[i] >> shift) & 0xFF]++;
+                dest_keys[dest] = source_keys[i];
+                dest_values[dest] = source_values[i];
+            }
+            // Nobody can start the next pass until every element has moved
+            job->barrier.wait();
+            source ^= 1;
+        }
+
+        // Odd number of passes leaves the result in scratch
+        if (source == 1)
+        {
+            memcpy(job->keys[0] + begin, job->keys[1] + begin, sizeof(uint64_t) * (end - begin));
+            memcpy(job->values[0] + begin, job->values[1] + begin, sizeof(uint32_t) * (end - begin));
+        }
+    }
+
+    void radix_sort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* scratch_keys, uint32_t* scratch_values, SortWorkers* workers)
+    {
+        size_t num_threads = 1;
+        if (workers && count >= RADIX_SORT_PARALLEL_THRESHOLD)
+            num_threads = workers->num_threads();
+
+        RadixSortJob job(num_threads);
+        job.keys[0] = keys;
+        job.keys[1] = scratch_keys;
+        job.values[0] = values;
+        job.values[1] = scratch_values;
+        job.count = count;
+
+        if (num_threads == 1)
+            radix_sort_worker(&job, 0);
+        else
+            workers->run(radix_sort_worker, &job);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Utils
+{
+    // Below this many keys the threads cost more than they save
+    #define RADIX_SORT_PARALLEL_THRESHOLD (16 * 1024)
+
+    // Threads kept alive between sorts, so sorting every frame doesn't start
+    // and join threads every frame. Owned by the caller, and runs one sort at
+    // a time.
+    class SortWorkers
+    {
+    public:
+        // Counts the calling thread, so starts num_threads - 1 threads
+        SortWorkers(size_t num_threads);
+        ~SortWorkers();
+        SortWorkers(const SortWorkers&) = delete;
+        SortWorkers& operator=(const SortWorkers&) = delete;
+
+        size_t num_threads() const { return m_threads.size() + 1; }
+        // Calls task(context, thread_index) on every thread, the caller's
+        // being index 0, and returns once they have all finished
+        void run(void (*task)(void* context, size_t thread_index), void* context);
+    private:
+        void worker_loop(size_t thread_index);
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        uint64_t m_generation; // Bumped for each run, workers wait for it to change
+        size_t m_num_running;
+        bool m_quit;
+        void (*m_task)(void* context, size_t thread_index);
+        void* m_context;
+    };
+
+    // LSD radix sort of 64 bit keys, a byte per pass, carrying a 32 bit value
+    // along with each key. Stable. Passes over bytes that are the same in
+    // every key are skipped, so keys that only use a few bits are cheap.
+    //
+    // scratch_keys and scratch_values must hold count elements each. With
+    // workers, large sorts are split across all of their threads.
+    void radix_sort(uint64_t* keys, uint32_t* values, size_t count, uint64_t* scratch_keys, uint32_t* scratch_values, SortWorkers* workers = nullptr);
+}
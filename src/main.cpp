@@ -1,12 +1,20 @@
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
  
 #define GLM_FORCE_RADIANS 1
 #include <SDL.h>
 #include <glad/glad.h>
+#include <physfs.h>
  
 #include "utils.h"
+#include "utils_profile.h"
 #include "graphics.h"
+#include "graphics_capture.h"
+#include "graphics_manifest.h"
+
+// Pipelines this run created, in the physfs write dir, prewarmed next run
+#define PIPELINE_MANIFEST_PATH "pipelines.manifest"
 
 void sdl_error(const char* message)
 {
@@ -15,6 +23,7 @@ void sdl_error(const char* message)
 
 void init_sdl()
 {
+    PROFILE_SCOPE("init_sdl");
     if (SDL_Init(SDL_INIT_VIDEO) < 0)
         sdl_error("Error initializing SDL");
     atexit(SDL_Quit);
@@ -28,6 +37,24 @@ void init_sdl()
     SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
 }
 
+void deinit_physfs()
+{
+    PHYSFS_deinit();
+}
+
+void init_physfs(const char* argv0)
+{
+    PROFILE_SCOPE("init_physfs");
+    if (!PHYSFS_init(argv0))
+        RUNTIME_ERROR("Error initializing physfs: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+    atexit(deinit_physfs);
+
+    // Caches and the like go in the per-user pref dir
+    const char* pref_dir = PHYSFS_getPrefDir("latencyhiding", "vulkan_bootstrap");
+    if (!pref_dir || !PHYSFS_setWriteDir(pref_dir))
+        LOG_WARNING("No writable pref dir: %s", PHYSFS_getErrorByCode(PHYSFS_getLastErrorCode()));
+}
+
 struct SDLWindow
 {
     SDL_Window* window;
@@ -43,6 +70,7 @@ SDLWindow create_sdl_window(
     bool fullscreen
 )
 {
+    PROFILE_SCOPE("create_sdl_window");
     SDLWindow new_window;
     Uint32 window_settings = SDL_WINDOW_OPENGL;
 
@@ -73,9 +101,47 @@ SDLWindow create_sdl_window(
 
 int main(int argc, char* argv[])
 {
+    // --trace <path> writes a Chrome trace of the run to path on exit
+    // --capture <path> records every backend call to path, for the replay tool
+    const char* capture_path = NULL;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--trace") == 0)
+            Utils::profile_dump_at_exit(argv[i + 1]);
+        else if (strcmp(argv[i], "--capture") == 0)
+            capture_path = argv[i + 1];
+    }
+
     init_sdl();
+    init_physfs(argv[0]);
+
+    const Graphics::BackendConfig backend_config = {
+        2048,
+        2048,
+        2048,
+        2048,
+        2,
+        "program_cache",
+        SDL_GL_GetProcAddress,
+        4 * 1024 * 1024
+    };
+    Graphics::Backend* gl_backend = Graphics::init_backend(Graphics::OPENGL_4, backend_config);
+    Graphics::Backend* backend = gl_backend;
+    Graphics::CaptureBackend* capture_backend = NULL;
+    if (capture_path)
+    {
+        capture_backend = new Graphics::CaptureBackend(gl_backend);
+        backend = capture_backend;
+    }
 
-    Graphics::Backend* backend = Graphics::init_backend(Graphics::OPENGL_4);
+    // Prewarming goes around the manifest so it only records what this run
+    // actually asked for
+    Graphics::Backend* prewarm_backend = backend;
+    Graphics::ManifestBackend manifest_backend(backend);
+    backend = &manifest_backend;
+    Graphics::PipelinePrewarmer prewarmer;
+    prewarmer.load_file(PIPELINE_MANIFEST_PATH);
+    bool prewarmed = false;
 
     SDLWindow window = create_sdl_window(
         "Test",
@@ -90,17 +156,35 @@ int main(int argc, char* argv[])
     SDL_Event event;
     while (!quit)
     {
-        while (SDL_PollEvent(&event))
+        PROFILE_SCOPE("Frame");
         {
-            if (event.type == SDL_QUIT)
+            PROFILE_SCOPE("Poll events");
+            while (SDL_PollEvent(&event))
             {
-                quit = true;
+                if (event.type == SDL_QUIT)
+                {
+                    quit = true;
+                }
             }
         }
-        SDL_GL_SwapWindow(window.window);
+        if (!prewarmed)
+            prewarmed = prewarmer.update(prewarm_backend, 8);
+        {
+            PROFILE_SCOPE("Swap");
+            SDL_GL_SwapWindow(window.window);
+        }
+        backend->end_frame();
     }
 
-    Graphics::deinit_backend(backend);
+    manifest_backend.write_to_file(PIPELINE_MANIFEST_PATH);
+    prewarmer.release(prewarm_backend);
+
+    if (capture_backend)
+    {
+        capture_backend->write_to_file(capture_path);
+        delete capture_backend;
+    }
+    Graphics::deinit_backend(gl_backend);
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <SDL.h>
+#include <glad/glad.h>
+
+#include "utils.h"
+#include "utils_profile.h"
+#include "graphics.h"
+#include "graphics_capture.h"
+
+// Replays a capture written with --capture and reports throughput, so
+// captures of real workloads can be compared between commits. The null
+// backend measures this layer alone; gl4 replays into a hidden window's
+// context and waits for the GPU at the end of each iteration.
+//
+// usage: replay [--backend null|gl4] <capture> [iterations]
+
+static bool read_file(const char* path, std::vector<uint8_t>* out_bytes)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file)
+        return false;
+
+    uint8_t buffer[64 * 1024];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        out_bytes->insert(out_bytes->end(), buffer, buffer + length);
+    fclose(file);
+    return true;
+}
+
+// GL4 has nothing to replay into without a current context, which has to
+// outlive the backend
+struct ReplayWindow
+{
+    SDL_Window* window;
+    SDL_GLContext context;
+};
+
+static ReplayWindow create_gl_context()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+        RUNTIME_ERROR("Error initializing SDL: %s", SDL_GetError());
+    atexit(SDL_Quit);
+
+    SDL_GL_LoadLibrary(NULL);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    ReplayWindow window;
+    window.window = SDL_CreateWindow("replay", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    window.context = window.window ? SDL_GL_CreateContext(window.window) : NULL;
+    if (!window.context)
+        RUNTIME_ERROR("GL context failed to create: %s", SDL_GetError());
+    gladLoadGLLoader(SDL_GL_GetProcAddress);
+    return window;
+}
+
+int main(int argc, char* argv[])
+{
+    Graphics::BackendType backend_type = Graphics::NULL_BACKEND;
+    int first_arg = 1;
+    if (argc > 2 && strcmp(argv[1], "--backend") == 0)
+    {
+        if (strcmp(argv[2], "gl4") == 0)
+            backend_type = Graphics::OPENGL_4;
+        else if (strcmp(argv[2], "null") != 0)
+            RUNTIME_ERROR("Unknown backend %s, expected null or gl4", argv[2]);
+        first_arg = 3;
+    }
+
+    if (argc <= first_arg)
+    {
+        fprintf(stderr, "usage: %s [--backend null|gl4] <capture> [iterations]\n", argv[0]);
+        return 1;
+    }
+    const char* capture_path = argv[first_arg];
+
+    std::vector<uint8_t> capture;
+    if (!read_file(capture_path, &capture))
+        RUNTIME_ERROR("Could not read capture %s", capture_path);
+
+    int iterations = argc > first_arg + 1 ? atoi(argv[first_arg + 1]) : 10;
+    if (iterations < 1)
+        iterations = 1;
+
+    ReplayWindow window = { NULL, NULL };
+    Graphics::BackendConfig backend_config = {
+        2048,
+        2048,
+        2048,
+        2048,
+        2,
+        NULL,
+        NULL,
+        0
+    };
+    if (backend_type == Graphics::OPENGL_4)
+    {
+        window = create_gl_context();
+        // Same ring as the app, so stream buffer uploads replay the same way
+        backend_config.gl_proc_loader = SDL_GL_GetProcAddress;
+        backend_config.upload_ring_size = 4 * 1024 * 1024;
+    }
+    Graphics::Backend* backend = Graphics::init_backend(backend_type, backend_config);
+
+    Graphics::ReplayStats stats;
+    uint64_t best_ns = UINT64_MAX;
+    uint64_t total_ns = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        uint64_t start_ns = Utils::profile_now_ns();
+        if (!Graphics::replay_capture(capture.data(), capture.size(), backend, &stats))
+            RUNTIME_ERROR("Replay of %s failed", capture_path);
+        // Count the driver's work too, not just queueing it up
+        if (window.context)
+            glFinish();
+        uint64_t elapsed_ns = Utils::profile_now_ns() - start_ns;
+
+        total_ns += elapsed_ns;
+        if (elapsed_ns < best_ns)
+            best_ns = elapsed_ns;
+    }
+
+    Graphics::deinit_backend(backend);
+    if (window.context)
+    {
+        SDL_GL_DeleteContext(window.context);
+        SDL_DestroyWindow(window.window);
+    }
+
+    size_t num_calls = 0;
+    for (size_t i = 0; i < Graphics::CAPTURE_OP_COUNT; i++)
+        num_calls += stats.num_calls[i];
+
+    printf("capture: %s (%zu bytes, %zu calls, %zu frames)\n", capture_path, capture.size(), num_calls, stats.num_frames);
+    printf("backend: %s\n", backend_type == Graphics::OPENGL_4 ? "gl4" : "null");
+    printf("iterations: %d\n", iterations);
+    printf("best: %.3f ms, mean: %.3f ms\n", best_ns / 1e6, total_ns / 1e6 / iterations);
+    printf("throughput: %.0f calls/s\n", best_ns > 0 ? num_calls / (best_ns / 1e9) : 0.0);
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <catch2/catch.hpp>
+#include <vector>
+#include "graphics_null.h"
+#include "graphics_capture.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+TEST_CASE("Null Backend Resource Creation", "[graphics][benchmark]")
+{
+    BackendConfig config = { 1024, 1024, 1024, 1024, 2 };
+    NullBackend backend(config);
+    Shader shader = create_test_shader(&backend);
+
+    VertexAttributeConfig attributes[1] = {
+        { VertexAttributeConfig::VEC4, 0, 0, false }
+    };
+    BufferType buffer_types[1] = { VERTEX };
+    PipelineConfig pipeline_config = {
+        &shader, 1,
+        attributes, 1,
+        buffer_types, 1,
+        nullptr, 0
+    };
+
+    float vertices[16] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+
+    BENCHMARK("Create/destroy vertex buffer")
+    {
+        VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+        backend.destroy_vertex_buffer(buffer);
+        return buffer;
+    };
+
+    BENCHMARK("Create/destroy shader")
+    {
+        Shader new_shader = create_test_shader(&backend);
+        backend.destroy_shader(new_shader);
+        return new_shader;
+    };
+
+    BENCHMARK("Create/destroy pipeline")
+    {
+        Pipeline pipeline = backend.create_pipeline(pipeline_config);
+        backend.destroy_pipeline(pipeline);
+        return pipeline;
+    };
+
+    // With a reference held elsewhere, creates hit the pipeline cache
+    Pipeline shared_pipeline = backend.create_pipeline(pipeline_config);
+    BENCHMARK("Create/destroy shared pipeline")
+    {
+        Pipeline pipeline = backend.create_pipeline(pipeline_config);
+        backend.destroy_pipeline(pipeline);
+        return pipeline;
+    };
+    backend.destroy_pipeline(shared_pipeline);
+
+    backend.destroy_shader(shader);
+}
+
+TEST_CASE("Null Backend Frame Churn", "[graphics][benchmark]")
+{
+    const size_t num_buffers = GENERATE(as<size_t>{}, 64, 1024);
+
+    BackendConfig config = { 1024, 1024, 1024, 1024, 2 };
+    NullBackend backend(config);
+    std::vector<VertexBuffer> buffers(num_buffers);
+
+    float vertices[16] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+
+    BENCHMARK("Recreate " + std::to_string(num_buffers) + " buffers per frame")
+    {
+        for (size_t i = 0; i < num_buffers; i++)
+            buffers[i] = backend.create_vertex_buffer(vertex_config);
+        for (size_t i = 0; i < num_buffers; i++)
+            backend.destroy_vertex_buffer(buffers[i]);
+        backend.end_frame();
+    };
+}
+
+TEST_CASE("Capture Overhead", "[graphics][capture][benchmark]")
+{
+    BackendConfig config = { 1024, 1024, 1024, 1024, 2 };
+    NullBackend backend(config);
+
+    float vertices[16] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+
+    BENCHMARK("Create/destroy vertex buffer, captured")
+    {
+        // Fresh capture per run so the stream doesn't grow without bound
+        CaptureBackend capture_backend(&backend);
+        VertexBuffer buffer = capture_backend.create_vertex_buffer(vertex_config);
+        capture_backend.destroy_vertex_buffer(buffer);
+        return buffer;
+    };
+}
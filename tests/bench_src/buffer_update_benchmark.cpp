@@ -0,0 +1,153 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include <vector>
+#include <SDL.h>
+#include <glad/glad.h>
+#include "graphics_gl4.h"
+
+using namespace Graphics;
+
+// Upload strategies only differ in how they deal with the GPU still reading
+// the buffer, so these need a real driver. Hidden from the default run since
+// they need a display too: run them with `benchmarks [gl]`, or the
+// run_gl_benchmarks target.
+
+struct BenchmarkWindow
+{
+    SDL_Window* window;
+    SDL_GLContext context;
+};
+
+static bool create_benchmark_window(BenchmarkWindow* out_window)
+{
+    if (SDL_Init(SDL_INIT_VIDEO) < 0)
+        return false;
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+    SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+
+    out_window->window = SDL_CreateWindow("buffer_update_benchmark", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+    out_window->context = out_window->window ? SDL_GL_CreateContext(out_window->window) : NULL;
+    if (!out_window->context)
+    {
+        if (out_window->window)
+            SDL_DestroyWindow(out_window->window);
+        SDL_Quit();
+        return false;
+    }
+    gladLoadGLLoader(SDL_GL_GetProcAddress);
+    return true;
+}
+
+static void destroy_benchmark_window(BenchmarkWindow& window)
+{
+    SDL_GL_DeleteContext(window.context);
+    SDL_DestroyWindow(window.window);
+    SDL_Quit();
+}
+
+static ShaderStageConfig passthrough_stages[2] = {
+    { VERTEX_SHADER,
+        "#version 430 core\n"
+        "layout(location = 0) in vec4 position;\n"
+        "out gl_PerVertex { vec4 gl_Position; };\n"
+        "void main() { gl_Position = position; }\n" },
+    { FRAGMENT_SHADER,
+        "#version 430 core\n"
+        "out vec4 color;\n"
+        "void main() { color = vec4(1.0); }\n" }
+};
+
+TEST_CASE("GL Upload Methods", "[graphics][.gl]")
+{
+    BenchmarkWindow window;
+    if (!create_benchmark_window(&window))
+    {
+        WARN("No GL 4.3 context, skipping: " << SDL_GetError());
+        return;
+    }
+
+    {
+        const BackendConfig config = { 64, 64, 64, 64, 2, nullptr, SDL_GL_GetProcAddress, 4 * 1024 * 1024 };
+        GL4Backend backend(config);
+
+        ShaderConfig shader_config = { passthrough_stages, 2 };
+        Shader shader = backend.create_shader(shader_config);
+        VertexAttributeConfig attributes[1] = { { VertexAttributeConfig::VEC4, 0, 0, false } };
+        BufferType buffer_types[1] = { VERTEX };
+        PipelineConfig pipeline_config = { &shader, 1, attributes, 1, buffer_types, 1, nullptr, 0 };
+        Pipeline pipeline = backend.create_pipeline(pipeline_config);
+
+        // 64K vertices a frame, enough that the GPU is still reading the
+        // last frame's when the next update comes in. They're all the same
+        // point, so the triangles cost nothing to raster.
+        const size_t num_vertices = 64 * 1024;
+        std::vector<float> vertices(num_vertices * 4, 0.5f);
+        const size_t size = vertices.size() * sizeof(float);
+        const size_t vertex_size = 4 * sizeof(float);
+        CommandBuffer command_buffer;
+        CommandBuffer* command_buffers[1] = { &command_buffer };
+
+        struct UploadCase
+        {
+            const char* name;
+            BufferUsage usage;
+            size_t offset;
+            GL4UploadMethod method;
+        };
+        // Partial updates leave out the first vertex, so every case moves
+        // about the same number of bytes
+        const UploadCase cases[] = {
+            { "SUB_DATA", BUFFER_USAGE_STATIC, 0, GL4_UPLOAD_SUB_DATA },
+            { "ORPHAN", BUFFER_USAGE_DYNAMIC, 0, GL4_UPLOAD_ORPHAN },
+            { "MAP_INVALIDATE", BUFFER_USAGE_STREAM, vertex_size, GL4_UPLOAD_MAP_INVALIDATE },
+            { "RING", BUFFER_USAGE_STREAM, 0, GL4_UPLOAD_RING }
+        };
+
+        for (const UploadCase& upload_case : cases)
+        {
+            REQUIRE(get_gl_upload_method(upload_case.usage, upload_case.offset, size - upload_case.offset, size, true) == upload_case.method);
+
+            VertexBufferConfig vertex_config = { vertices.data(), size, upload_case.usage };
+            VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+
+            BENCHMARK(std::string(upload_case.name) + ", " + std::to_string(size) + " bytes a frame")
+            {
+                backend.update_vertex_buffer(buffer, upload_case.offset, (const uint8_t*) vertices.data() + upload_case.offset, size - upload_case.offset);
+                command_buffer.reset();
+                command_buffer.bind_pipeline(pipeline);
+                command_buffer.bind_vertex_buffer(0, buffer);
+                command_buffer.draw(num_vertices);
+                backend.submit(command_buffers, 1);
+                backend.end_frame();
+                glFlush();
+            };
+
+            // Don't let one case's backlog land on the next
+            glFinish();
+            backend.destroy_vertex_buffer(buffer);
+            if (upload_case.method == GL4_UPLOAD_RING && backend.upload_ring_stats().num_allocations == 0)
+                WARN("No buffer storage, RING fell back to ORPHAN");
+        }
+
+        backend.destroy_pipeline(pipeline);
+        backend.destroy_shader(shader);
+    }
+
+    destroy_benchmark_window(window);
+}
+
+TEST_CASE("Upload Method Selection", "[graphics][benchmark]")
+{
+    BENCHMARK("get_gl_upload_method")
+    {
+        int total = 0;
+        for (size_t offset = 0; offset < 1024; offset += 64)
+        {
+            total += get_gl_upload_method(BUFFER_USAGE_STATIC, offset, 64, 1024, true);
+            total += get_gl_upload_method(BUFFER_USAGE_DYNAMIC, offset, 64, 1024, true);
+            total += get_gl_upload_method(BUFFER_USAGE_STREAM, offset, 64, 1024, true);
+        }
+        return total;
+    };
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+#include "graphics_commands.h"
+#include "graphics_null.h"
+
+using namespace Graphics;
+
+static void record_draws(CommandBuffer* command_buffer, const Pipeline& pipeline, const VertexBuffer& buffer, size_t num_draws)
+{
+    command_buffer->reset();
+    for (size_t i = 0; i < num_draws; i++)
+    {
+        command_buffer->bind_pipeline(pipeline);
+        command_buffer->bind_vertex_buffer(0, buffer);
+        command_buffer->draw(6);
+    }
+}
+
+TEST_CASE("Command Buffer Recording", "[command_buffer][benchmark]")
+{
+    const size_t num_threads = GENERATE(as<size_t>{}, 1, 2, 4, 8);
+    const size_t num_draws = 64 * 1024;
+    const size_t draws_per_thread = num_draws / num_threads;
+
+    Pipeline pipeline = {};
+    VertexBuffer buffer = {};
+    std::vector<CommandBuffer*> command_buffers;
+    for (size_t i = 0; i < num_threads; i++)
+        command_buffers.push_back(new CommandBuffer());
+
+    BENCHMARK(std::to_string(num_draws) + " draws across " + std::to_string(num_threads) + " threads")
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; t++)
+        {
+            threads.emplace_back([&, t]() {
+                record_draws(command_buffers[t], pipeline, buffer, draws_per_thread);
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+    };
+
+    for (size_t i = 0; i < num_threads; i++)
+        delete command_buffers[i];
+}
+
+TEST_CASE("Null Backend Submit", "[command_buffer][graphics][benchmark]")
+{
+    BackendConfig config = { 16, 16, 16, 16, 2 };
+    NullBackend backend(config);
+
+    ShaderStageConfig stages[1] = { { VERTEX_SHADER, "void main() {}" } };
+    ShaderConfig shader_config = { stages, 1 };
+    Shader shader = backend.create_shader(shader_config);
+    PipelineConfig pipeline_config = { &shader, 1, nullptr, 0, nullptr, 0, nullptr, 0 };
+    Pipeline pipeline = backend.create_pipeline(pipeline_config);
+    float vertices[9] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+
+    CommandBuffer command_buffer;
+    record_draws(&command_buffer, pipeline, buffer, 4096);
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+
+    BENCHMARK("Submit 4096 draws")
+    {
+        backend.submit(command_buffers, 1);
+    };
+
+    backend.destroy_vertex_buffer(buffer);
+    backend.destroy_pipeline(pipeline);
+    backend.destroy_shader(shader);
+}
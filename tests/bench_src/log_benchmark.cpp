@@ -0,0 +1,52 @@
+#include <catch2/catch.hpp>
+#include <thread>
+#include "utils.h"
+
+TEST_CASE("Log Call Cost", "[log][benchmark]")
+{
+    FILE* sink = tmpfile();
+    Utils::log_set_output(sink);
+
+    uint32_t index = 1234;
+    uint32_t generation = 56;
+
+    BENCHMARK("LOG_WARNING, ring buffer")
+    {
+        LOG_WARNING("Invalid ref. Index is %u, generation is %u", index, generation);
+    };
+
+    BENCHMARK("fprintf, like the old LOG macro")
+    {
+        fprintf(sink, "WARNING %s::%s, line %d: ", __FILE__, __FUNCTION__, __LINE__);
+        fprintf(sink, "Invalid ref. Index is %u, generation is %u\n", index, generation);
+    };
+
+    Utils::log_set_output(stderr);
+    fclose(sink);
+}
+
+TEST_CASE("Log Contention", "[log][benchmark]")
+{
+    const size_t num_threads = GENERATE(as<size_t>{}, 1, 4, 8);
+    const size_t num_messages = 256;
+
+    FILE* sink = tmpfile();
+    Utils::log_set_output(sink);
+
+    BENCHMARK(std::to_string(num_threads) + " threads logging " + std::to_string(num_messages) + " messages each")
+    {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < num_threads; t++)
+        {
+            threads.emplace_back([t, num_messages]() {
+                for (size_t i = 0; i < num_messages; i++)
+                    LOG_INFO("thread %zu message %zu", t, i);
+            });
+        }
+        for (std::thread& thread : threads)
+            thread.join();
+    };
+
+    Utils::log_set_output(stderr);
+    fclose(sink);
+}
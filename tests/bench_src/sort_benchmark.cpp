@@ -0,0 +1,50 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+#include "utils_sort.h"
+
+TEST_CASE("Sort Draw Keys", "[sort][benchmark]")
+{
+    const size_t count = GENERATE(as<size_t>{}, 1024, 64 * 1024, 1024 * 1024);
+
+    std::mt19937_64 rng(count);
+    std::vector<uint64_t> source_keys(count);
+    for (size_t i = 0; i < count; i++)
+        source_keys[i] = rng();
+
+    std::vector<uint64_t> keys(count);
+    std::vector<uint32_t> values(count);
+    std::vector<uint64_t> scratch_keys(count);
+    std::vector<uint32_t> scratch_values(count);
+    std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+
+    BENCHMARK("std::sort, " + std::to_string(count) + " keys")
+    {
+        for (size_t i = 0; i < count; i++)
+            pairs[i] = std::make_pair(source_keys[i], (uint32_t) i);
+        std::sort(pairs.begin(), pairs.end());
+        return pairs[0].second;
+    };
+
+    BENCHMARK("radix_sort, " + std::to_string(count) + " keys")
+    {
+        keys = source_keys;
+        for (size_t i = 0; i < count; i++)
+            values[i] = i;
+        Utils::radix_sort(keys.data(), values.data(), count, scratch_keys.data(), scratch_values.data());
+        return values[0];
+    };
+
+    const size_t num_threads = std::max(2u, std::thread::hardware_concurrency());
+    Utils::SortWorkers workers(num_threads);
+    BENCHMARK("radix_sort, " + std::to_string(count) + " keys, " + std::to_string(num_threads) + " threads")
+    {
+        keys = source_keys;
+        for (size_t i = 0; i < count; i++)
+            values[i] = i;
+        Utils::radix_sort(keys.data(), values.data(), count, scratch_keys.data(), scratch_values.data(), &workers);
+        return values[0];
+    };
+}
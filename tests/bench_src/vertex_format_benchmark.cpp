@@ -0,0 +1,46 @@
+#include <catch2/catch.hpp>
+#include "graphics_gl4.h"
+
+using namespace Graphics;
+
+TEST_CASE("Vertex Format Derivation", "[graphics][benchmark]")
+{
+    const size_t num_attributes = GENERATE(as<size_t>{}, 1, 4, 15);
+
+    VertexAttributeConfig attributes[GRAPHICS_MAX_VERTEX_ATTRIBS];
+    for (size_t i = 0; i < num_attributes; i++)
+    {
+        attributes[i].type = (VertexAttributeConfig::Type) (i % 4);
+        attributes[i].binding = 0;
+        attributes[i].location = i;
+        attributes[i].normalized = false;
+    }
+
+    GL4VertexFormat format;
+    BENCHMARK("get_gl_vertex_format, " + std::to_string(num_attributes) + " attributes")
+    {
+        get_gl_vertex_format(&format, attributes, num_attributes);
+        return format.stride;
+    };
+}
+
+TEST_CASE("Vertex Format Hashing", "[graphics][benchmark]")
+{
+    const size_t num_attributes = GENERATE(as<size_t>{}, 1, 4, 15);
+
+    VertexAttributeConfig attributes[GRAPHICS_MAX_VERTEX_ATTRIBS];
+    for (size_t i = 0; i < num_attributes; i++)
+    {
+        attributes[i].type = (VertexAttributeConfig::Type) (i % 4);
+        attributes[i].binding = 0;
+        attributes[i].location = i;
+        attributes[i].normalized = false;
+    }
+
+    GL4VertexFormat format;
+    get_gl_vertex_format(&format, attributes, num_attributes);
+    BENCHMARK("hash_gl_vertex_format, " + std::to_string(num_attributes) + " attributes")
+    {
+        return hash_gl_vertex_format(format);
+    };
+}
@@ -0,0 +1,290 @@
+#include <catch2/catch.hpp>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include "utils.h"
+
+// The std::queue backed free list WeakRefManager used to have, kept around
+// so the intrusive free list has something to be measured against
+template <typename T>
+class QueueWeakRefManager
+{
+public:
+    QueueWeakRefManager(uint32_t in_reserve_size, uint32_t in_min_free_indices = 1024)
+        : reserve_size(in_reserve_size)
+        , min_free_indices(in_min_free_indices)
+    {
+        grow(reserve_size);
+    }
+
+    Utils::WeakRef add(T val)
+    {
+        if (free_indices.size() < min_free_indices)
+        {
+            grow(reserve_size * 2);
+        }
+
+        uint32_t index = free_indices.front();
+        free_indices.pop();
+        data[index] = val;
+        return { index, generations[index] };
+    }
+
+    void remove(Utils::WeakRef ref)
+    {
+        if (ref.index >= data.size() || generations[ref.index] != ref.generation)
+            return;
+
+        free_indices.push(ref.index);
+        generations[ref.index]++;
+    }
+
+private:
+    std::vector<T> data;
+    std::vector<uint8_t> generations;
+    std::queue<size_t> free_indices;
+
+    uint32_t reserve_size;
+    uint32_t min_free_indices;
+
+    void grow(size_t new_reserve_size)
+    {
+        reserve_size = new_reserve_size;
+        for (size_t i = data.size(); i < reserve_size; i++)
+        {
+            free_indices.push(i);
+            data.push_back(T());
+            generations.push_back(0);
+        }
+    }
+};
+
+// Mimics a frame's worth of transient buffers: create a batch, then destroy it
+template <typename Manager>
+static size_t churn(Manager& manager, std::vector<Utils::WeakRef>& refs, size_t num_refs)
+{
+    refs.clear();
+    for (size_t i = 0; i < num_refs; i++)
+        refs.push_back(manager.add(i));
+
+    size_t checksum = 0;
+    for (size_t i = 0; i < num_refs; i++)
+    {
+        checksum += refs[i].index;
+        manager.remove(refs[i]);
+    }
+    return checksum;
+}
+
+TEST_CASE("Add/Remove Churn", "[weak_ref_manager][benchmark]")
+{
+    const size_t num_refs = GENERATE(as<size_t>{}, 16, 1024, 8192);
+
+    std::vector<Utils::WeakRef> refs;
+    refs.reserve(num_refs);
+
+    Utils::WeakRefManager<size_t> intrusive_manager(2048);
+    Utils::WeakRefManager<size_t, Utils::WeakRefPagedStorage<>> paged_manager(2048);
+    QueueWeakRefManager<size_t> queue_manager(2048);
+
+    BENCHMARK("Intrusive free list, " + std::to_string(num_refs) + " refs")
+    {
+        return churn(intrusive_manager, refs, num_refs);
+    };
+
+    BENCHMARK("Intrusive free list, paged, " + std::to_string(num_refs) + " refs")
+    {
+        return churn(paged_manager, refs, num_refs);
+    };
+
+    BENCHMARK("std::queue free list, " + std::to_string(num_refs) + " refs")
+    {
+        return churn(queue_manager, refs, num_refs);
+    };
+}
+
+// Growth cost of a manager that's already large: the vector storage copies the
+// whole table, the paged storage allocates a single page
+template <typename Manager>
+static void fill_past_reserve(size_t reserve_size)
+{
+    Manager manager(reserve_size, 1);
+    for (size_t i = 0; i <= reserve_size; i++)
+        manager.add(i);
+}
+
+TEST_CASE("Growth", "[weak_ref_manager][benchmark]")
+{
+    const size_t reserve_size = 1 << 16;
+
+    BENCHMARK("Vector storage, fill past reserve")
+    {
+        fill_past_reserve<Utils::WeakRefManager<size_t>>(reserve_size);
+    };
+
+    BENCHMARK("Paged storage, fill past reserve")
+    {
+        fill_past_reserve<Utils::WeakRefManager<size_t, Utils::WeakRefPagedStorage<>>>(reserve_size);
+    };
+}
+
+// Every thread churns its own refs through one shared manager
+template <typename Manager>
+static void concurrent_churn(Manager& manager, size_t num_threads, size_t num_refs_per_thread)
+{
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&]() {
+            std::vector<Utils::WeakRef> refs;
+            refs.reserve(num_refs_per_thread);
+            for (size_t i = 0; i < num_refs_per_thread; i++)
+                refs.push_back(manager.add(i));
+            for (size_t i = 0; i < num_refs_per_thread; i++)
+                manager.get(refs[i]);
+            for (size_t i = 0; i < num_refs_per_thread; i++)
+                manager.remove(refs[i]);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+// What loader threads have to do today, one mutex around the whole manager
+template <typename T>
+class MutexWeakRefManager
+{
+public:
+    MutexWeakRefManager(uint32_t reserve_size) : manager(reserve_size) {}
+
+    Utils::WeakRef add(T val)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return manager.add(val);
+    }
+
+    T* get(Utils::WeakRef ref)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return manager.get(ref);
+    }
+
+    void remove(Utils::WeakRef ref)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        manager.remove(ref);
+    }
+private:
+    std::mutex mutex;
+    Utils::WeakRefManager<T> manager;
+};
+
+TEST_CASE("Concurrent Churn Throughput", "[concurrent_weak_ref_manager][benchmark]")
+{
+    const size_t num_threads = GENERATE(as<size_t>{}, 1, 2, 4, 8);
+    const size_t num_refs_per_thread = 4096;
+
+    Utils::ConcurrentWeakRefManager<size_t> lock_free_manager(num_threads * num_refs_per_thread);
+    MutexWeakRefManager<size_t> mutex_manager(num_threads * num_refs_per_thread);
+
+    BENCHMARK("Lock free, " + std::to_string(num_threads) + " threads")
+    {
+        concurrent_churn(lock_free_manager, num_threads, num_refs_per_thread);
+    };
+
+    BENCHMARK("Global mutex, " + std::to_string(num_threads) + " threads")
+    {
+        concurrent_churn(mutex_manager, num_threads, num_refs_per_thread);
+    };
+}
+
+TEST_CASE("Resolve Cost By Batch Size", "[weak_ref_manager][benchmark]")
+{
+    const size_t batch_size = GENERATE(as<size_t>{}, 1, 16, 1024);
+
+    Utils::WeakRefManager<size_t> manager(4096);
+    std::vector<Utils::WeakRef> refs;
+    for (size_t i = 0; i < 4096; i++)
+        refs.push_back(manager.add(i));
+
+    // Resolve handles scattered around the table, like a draw would
+    std::vector<Utils::WeakRef> batch;
+    for (size_t i = 0; i < batch_size; i++)
+        batch.push_back(refs[(i * 2654435761u) % refs.size()]);
+
+    std::vector<size_t*> out_values(batch_size);
+    std::vector<uint64_t> invalid_mask((batch_size + 63) / 64);
+
+    BENCHMARK("get, batch of " + std::to_string(batch_size))
+    {
+        for (size_t i = 0; i < batch_size; i++)
+            out_values[i] = manager.get(batch[i]);
+        return out_values[0];
+    };
+
+    BENCHMARK("get_many, batch of " + std::to_string(batch_size))
+    {
+        return manager.get_many(&batch[0], batch_size, &out_values[0], &invalid_mask[0]);
+    };
+}
+
+template <typename Manager>
+static size_t resolve_all(Manager& manager, const std::vector<Utils::WeakRef>& refs)
+{
+    size_t checksum = 0;
+    for (size_t i = 0; i < refs.size(); i++)
+        checksum += (size_t) manager.get(refs[i]);
+    return checksum;
+}
+
+template <typename Manager>
+static std::vector<Utils::WeakRef> fill(Manager& manager, size_t num_refs)
+{
+    std::vector<Utils::WeakRef> refs;
+    for (size_t i = 0; i < num_refs; i++)
+        refs.push_back(manager.add(i));
+    return refs;
+}
+
+TEST_CASE("Lookup Cost By Validation Policy", "[weak_ref_manager][benchmark]")
+{
+    const size_t num_refs = 4096;
+
+    Utils::WeakRefManager<size_t, Utils::WeakRefVectorStorage, Utils::CheckedRefValidation> checked_manager(num_refs);
+    Utils::WeakRefManager<size_t, Utils::WeakRefVectorStorage, Utils::FastRefValidation> fast_manager(num_refs);
+    Utils::WeakRefManager<size_t, Utils::WeakRefVectorStorage, Utils::UncheckedRefValidation> unchecked_manager(num_refs);
+    Utils::DenseWeakRefManager<size_t, Utils::CheckedRefValidation> checked_dense_manager(num_refs);
+    Utils::DenseWeakRefManager<size_t, Utils::FastRefValidation> fast_dense_manager(num_refs);
+
+    std::vector<Utils::WeakRef> checked_refs = fill(checked_manager, num_refs);
+    std::vector<Utils::WeakRef> fast_refs = fill(fast_manager, num_refs);
+    std::vector<Utils::WeakRef> unchecked_refs = fill(unchecked_manager, num_refs);
+    std::vector<Utils::WeakRef> checked_dense_refs = fill(checked_dense_manager, num_refs);
+    std::vector<Utils::WeakRef> fast_dense_refs = fill(fast_dense_manager, num_refs);
+
+    BENCHMARK("Checked (debug default)")
+    {
+        return resolve_all(checked_manager, checked_refs);
+    };
+
+    BENCHMARK("Fast (release default)")
+    {
+        return resolve_all(fast_manager, fast_refs);
+    };
+
+    BENCHMARK("Unchecked")
+    {
+        return resolve_all(unchecked_manager, unchecked_refs);
+    };
+
+    BENCHMARK("Dense, checked (debug default)")
+    {
+        return resolve_all(checked_dense_manager, checked_dense_refs);
+    };
+
+    BENCHMARK("Dense, fast (release default)")
+    {
+        return resolve_all(fast_dense_manager, fast_dense_refs);
+    };
+}
@@ -0,0 +1,291 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include "graphics_capture.h"
+#include "graphics_null.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+static const BackendConfig test_config = { 16, 16, 16, 16, 2 };
+
+// Records a small workload: the test scene, drawn once, and destroyed again
+// across frames
+static void record_workload(Backend* backend)
+{
+    TestScene scene = create_test_scene(backend);
+
+    CommandBuffer command_buffer;
+    command_buffer.bind_pipeline(scene.pipeline);
+    command_buffer.bind_vertex_buffer(0, scene.vertex_buffer);
+    command_buffer.bind_index_buffer(scene.index_buffer);
+    command_buffer.draw_indexed(3);
+    command_buffer.draw(3);
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+    backend->submit(command_buffers, 1);
+    backend->end_frame();
+
+    backend->destroy_index_buffer(scene.index_buffer);
+    backend->end_frame();
+
+    backend->destroy_pipeline(scene.pipeline);
+    backend->destroy_shader(scene.shader);
+    backend->destroy_vertex_buffer(scene.vertex_buffer);
+}
+
+TEST_CASE("Capture Config Round Trip", "[capture]")
+{
+    CaptureWriter writer;
+
+    VertexAttributeConfig attributes[2] = {
+        { VertexAttributeConfig::VEC2, 0, 0, false },
+        { VertexAttributeConfig::VEC4, 1, 3, true }
+    };
+    BufferType buffer_types[2] = { VERTEX, VERTEX };
+    TextureType texture_types[1] = { TEXTURE_2D };
+    Shader shader = { Utils::weakref_from_bits(0x0500000100000007ull) };
+    PipelineConfig config = {
+        &shader, 1,
+        attributes, 2,
+        buffer_types, 2,
+        texture_types, 1
+    };
+    write_pipeline_config(writer, config);
+
+    Utils::LinearArena arena(1024);
+    CaptureReader reader(writer.bytes.data(), writer.bytes.size());
+    PipelineConfig read_config;
+    REQUIRE(read_pipeline_config(reader, arena, &read_config));
+    REQUIRE(reader.at_end());
+
+    REQUIRE(read_config.num_shaders == 1);
+    REQUIRE(read_config.shaders[0] == shader);
+    REQUIRE(read_config.num_attributes == 2);
+    REQUIRE(read_config.vertex_attributes[1].type == VertexAttributeConfig::VEC4);
+    REQUIRE(read_config.vertex_attributes[1].binding == 1);
+    REQUIRE(read_config.vertex_attributes[1].location == 3);
+    REQUIRE(read_config.vertex_attributes[1].normalized);
+    REQUIRE(read_config.num_buffers == 2);
+    REQUIRE(read_config.num_textures == 1);
+    REQUIRE(read_config.texture_types[0] == TEXTURE_2D);
+
+    // Truncated streams fail instead of reading garbage
+    CaptureReader truncated(writer.bytes.data(), writer.bytes.size() - 1);
+    REQUIRE_FALSE(read_pipeline_config(truncated, arena, &read_config));
+}
+
+TEST_CASE("Capture Replays Onto Another Backend", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+    record_workload(&capture_backend);
+
+    // Calls still reach the wrapped backend
+    REQUIRE(recorded_backend.frame_index() == 2);
+    REQUIRE(recorded_backend.num_buffers() == 0);
+
+    NullBackend replay_backend(test_config);
+    ReplayStats stats;
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, &stats));
+
+    REQUIRE(stats.num_frames == 2);
+    REQUIRE(stats.num_calls[CAPTURE_OP_CREATE_VERTEX_BUFFER] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_CREATE_INDEX_BUFFER] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_CREATE_SHADER] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_CREATE_PIPELINE] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_PIPELINE] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_SUBMIT] == 1);
+    REQUIRE(replay_backend.frame_index() == 2);
+    REQUIRE(replay_backend.num_buffers() == 0);
+    REQUIRE(replay_backend.num_shaders() == 0);
+    REQUIRE(replay_backend.num_pipelines() == 0);
+
+    // Replaying again onto the same backend works, handles get remapped
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, nullptr));
+    REQUIRE(replay_backend.frame_index() == 4);
+}
+
+TEST_CASE("Capture Replays Submitted Commands", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+
+    float vertices[9] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer vertex_buffer = capture_backend.create_vertex_buffer(vertex_config);
+    ShaderStageConfig stages[1] = { { VERTEX_SHADER, "void main() {}" } };
+    ShaderConfig shader_config = { stages, 1 };
+    Shader shader = capture_backend.create_shader(shader_config);
+    PipelineConfig pipeline_config = { &shader, 1, nullptr, 0, nullptr, 0, nullptr, 0 };
+    Pipeline pipeline = capture_backend.create_pipeline(pipeline_config);
+
+    CommandBuffer first;
+    first.bind_pipeline(pipeline);
+    first.bind_vertex_buffer(0, vertex_buffer, 12);
+    CommandBuffer second;
+    second.draw(3);
+    second.draw(3, 3);
+    // Never existed, stays invalid on replay
+    second.bind_pipeline({ Utils::weakref_from_bits(0x0500000100000009ull) });
+    CommandBuffer* command_buffers[2] = { &first, &second };
+    capture_backend.submit(command_buffers, 2);
+
+    NullBackend replay_backend(test_config);
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, nullptr));
+    REQUIRE(replay_backend.submit_stats().num_pipeline_binds == 1);
+    REQUIRE(replay_backend.submit_stats().num_buffer_binds == 1);
+    REQUIRE(replay_backend.submit_stats().num_draws == 2);
+    REQUIRE(replay_backend.submit_stats().num_invalid_commands == 1);
+
+    capture_backend.destroy_pipeline(pipeline);
+    capture_backend.destroy_shader(shader);
+    capture_backend.destroy_vertex_buffer(vertex_buffer);
+}
+
+TEST_CASE("Capture Replays Shared Pipelines", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+
+    ShaderStageConfig stages[1] = { { VERTEX_SHADER, "void main() {}" } };
+    ShaderConfig shader_config = { stages, 1 };
+    Shader shader = capture_backend.create_shader(shader_config);
+    PipelineConfig pipeline_config = { &shader, 1, nullptr, 0, nullptr, 0, nullptr, 0 };
+
+    // The same handle comes back twice and has to be destroyed twice
+    Pipeline first = capture_backend.create_pipeline(pipeline_config);
+    Pipeline second = capture_backend.create_pipeline(pipeline_config);
+    REQUIRE(first == second);
+    capture_backend.destroy_pipeline(first);
+    capture_backend.destroy_pipeline(second);
+    // One left alive for the replay to clean up
+    Pipeline third = capture_backend.create_pipeline(pipeline_config);
+    Pipeline fourth = capture_backend.create_pipeline(pipeline_config);
+
+    NullBackend replay_backend(test_config);
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, nullptr));
+    REQUIRE(replay_backend.num_pipelines() == 0);
+    REQUIRE(replay_backend.num_shaders() == 0);
+
+    capture_backend.destroy_pipeline(third);
+    capture_backend.destroy_pipeline(fourth);
+    capture_backend.destroy_shader(shader);
+}
+
+TEST_CASE("Capture Replay Cleans Up Leaked Resources", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+
+    float vertices[3] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer buffer = capture_backend.create_vertex_buffer(vertex_config);
+
+    NullBackend replay_backend(test_config);
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, nullptr));
+    REQUIRE(replay_backend.num_buffers() == 0);
+
+    capture_backend.destroy_vertex_buffer(buffer);
+}
+
+TEST_CASE("Capture Replay Rejects Bad Streams", "[capture]")
+{
+    NullBackend backend(test_config);
+
+    uint8_t garbage[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    REQUIRE_FALSE(replay_capture(garbage, sizeof(garbage), &backend, nullptr));
+
+    // A destroy cut off before its handle
+    CaptureWriter writer;
+    writer.write_u32(CAPTURE_MAGIC);
+    writer.write_u32(CAPTURE_VERSION);
+    writer.write_u8(CAPTURE_OP_DESTROY_SHADER);
+    writer.write_u32(42);
+    REQUIRE_FALSE(replay_capture(writer.bytes.data(), writer.bytes.size(), &backend, nullptr));
+    REQUIRE(backend.num_shaders() == 0);
+}
+
+TEST_CASE("Capture Replays Destroys Of Dead Handles", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+
+    float vertices[3] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer buffer = capture_backend.create_vertex_buffer(vertex_config);
+    // The second one is a bug in the recorded app, the backend warns and
+    // carries on. Replay has to as well.
+    capture_backend.destroy_vertex_buffer(buffer);
+    capture_backend.destroy_vertex_buffer(buffer);
+    // Never created at all
+    capture_backend.destroy_shader({Utils::weakref_from_bits(42)});
+    VertexBuffer other_buffer = capture_backend.create_vertex_buffer(vertex_config);
+    capture_backend.end_frame();
+
+    NullBackend replay_backend(test_config);
+    ReplayStats stats;
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, &stats));
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_VERTEX_BUFFER] == 2);
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_SHADER] == 1);
+    REQUIRE(stats.num_frames == 1);
+
+    capture_backend.destroy_vertex_buffer(other_buffer);
+}
+
+TEST_CASE("Capture Replays Dead Handles Into A Fresh Backend", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+
+    // Nothing created before or after, so the replay backend has never
+    // handed out a slot for these to land on
+    capture_backend.destroy_vertex_buffer({Utils::weakref_from_bits(0)});
+    capture_backend.destroy_index_buffer({Utils::weakref_from_bits(1)});
+    capture_backend.destroy_pipeline({Utils::weakref_from_bits(2)});
+    capture_backend.destroy_shader({Utils::weakref_from_bits(3)});
+    capture_backend.end_frame();
+
+    NullBackend replay_backend(test_config);
+    ReplayStats stats;
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, &stats));
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_VERTEX_BUFFER] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_INDEX_BUFFER] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_PIPELINE] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_DESTROY_SHADER] == 1);
+    REQUIRE(replay_backend.num_buffers() == 0);
+}
+
+TEST_CASE("Capture Replays Buffer Updates", "[capture]")
+{
+    NullBackend recorded_backend(test_config);
+    CaptureBackend capture_backend(&recorded_backend);
+
+    float vertices[6] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices), BUFFER_USAGE_STREAM };
+    VertexBuffer vertex_buffer = capture_backend.create_vertex_buffer(vertex_config);
+    uint16_t indices[4] = {};
+    IndexBufferConfig index_config = { UNSIGNED_SHORT, indices, 4, BUFFER_USAGE_DYNAMIC };
+    IndexBuffer index_buffer = capture_backend.create_index_buffer(index_config);
+
+    float new_vertices[2] = { 1, 2 };
+    capture_backend.update_vertex_buffer(vertex_buffer, sizeof(float), new_vertices, sizeof(new_vertices));
+    uint16_t new_indices[2] = { 3, 2 };
+    capture_backend.update_index_buffer(index_buffer, 2, new_indices, 2);
+    capture_backend.end_frame();
+
+    capture_backend.destroy_vertex_buffer(vertex_buffer);
+    capture_backend.destroy_index_buffer(index_buffer);
+
+    NullBackend replay_backend(test_config);
+    ReplayStats stats;
+    REQUIRE(replay_capture(capture_backend.capture().data(), capture_backend.capture().size(), &replay_backend, &stats));
+    REQUIRE(stats.num_calls[CAPTURE_OP_UPDATE_VERTEX_BUFFER] == 1);
+    REQUIRE(stats.num_calls[CAPTURE_OP_UPDATE_INDEX_BUFFER] == 1);
+
+    // Usage survives the trip too
+    CaptureWriter writer;
+    write_index_buffer_config(writer, index_config);
+    CaptureReader reader(writer.bytes.data(), writer.bytes.size());
+    IndexBufferConfig read_config;
+    REQUIRE(read_index_buffer_config(reader, &read_config));
+    REQUIRE(read_config.usage == BUFFER_USAGE_DYNAMIC);
+}
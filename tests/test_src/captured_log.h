@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include "utils.h"
+
+// Redirects the logger into a temp file for the duration of a test. Puts
+// the output and the enabled channels back afterwards, so a test that
+// filters channels doesn't leave the next one filtered.
+struct CapturedLog
+{
+    FILE* file;
+
+    CapturedLog()
+    {
+        file = tmpfile();
+        Utils::log_set_output(file);
+    }
+
+    ~CapturedLog()
+    {
+        Utils::log_set_output(stderr);
+        Utils::log_set_enabled_channels(LOG_CHANNEL_ALL);
+        fclose(file);
+    }
+
+    std::string read()
+    {
+        Utils::log_flush();
+        std::string result;
+        rewind(file);
+        char buffer[1024];
+        size_t length;
+        while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            result.append(buffer, length);
+        return result;
+    }
+};
@@ -0,0 +1,174 @@
+#include <catch2/catch.hpp>
+#include <thread>
+#include <vector>
+#include "graphics_commands.h"
+#include "graphics_null.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+static const BackendConfig test_config = { 16, 16, 16, 16, 2 };
+
+TEST_CASE("Command Buffer Records In Order", "[command_buffer]")
+{
+    CommandBuffer command_buffer;
+    Pipeline pipeline = { Utils::weakref_from_bits(1) };
+    VertexBuffer buffer = { Utils::weakref_from_bits(2) };
+
+    command_buffer.bind_pipeline(pipeline);
+    command_buffer.bind_vertex_buffer(3, buffer, 64);
+    command_buffer.draw(30, 6);
+    REQUIRE(command_buffer.num_commands() == 3);
+
+    const Command* command = command_buffer.first_command();
+    REQUIRE(command->type == COMMAND_BIND_PIPELINE);
+    REQUIRE(((const BindPipelineCommand*) command)->pipeline == pipeline);
+
+    command = command->next;
+    REQUIRE(command->type == COMMAND_BIND_VERTEX_BUFFER);
+    const BindVertexBufferCommand* bind = (const BindVertexBufferCommand*) command;
+    REQUIRE(bind->buffer == buffer);
+    REQUIRE(bind->binding == 3);
+    REQUIRE(bind->offset == 64);
+
+    command = command->next;
+    REQUIRE(command->type == COMMAND_DRAW);
+    REQUIRE(((const DrawCommand*) command)->num_vertices == 30);
+    REQUIRE(((const DrawCommand*) command)->first_vertex == 6);
+    REQUIRE(command->next == nullptr);
+
+    command_buffer.reset();
+    REQUIRE(command_buffer.num_commands() == 0);
+    REQUIRE(command_buffer.first_command() == nullptr);
+}
+
+TEST_CASE("Command Buffers Recorded On Worker Threads", "[command_buffer]")
+{
+    NullBackend backend(test_config);
+    TestScene scene = create_test_scene(&backend);
+
+    const size_t num_threads = 4;
+    const size_t draws_per_thread = 1000;
+    // Small blocks, so the threads all go back to the shared pool while
+    // recording
+    Utils::PoolAllocator block_pool(1024, 4);
+    std::vector<CommandBuffer*> command_buffers;
+    for (size_t i = 0; i < num_threads; i++)
+        command_buffers.push_back(new CommandBuffer(block_pool));
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&scene, &command_buffers, t, draws_per_thread]() {
+            CommandBuffer* command_buffer = command_buffers[t];
+            command_buffer->bind_pipeline(scene.pipeline);
+            command_buffer->bind_vertex_buffer(0, scene.vertex_buffer);
+            command_buffer->bind_index_buffer(scene.index_buffer);
+            for (size_t i = 0; i < draws_per_thread; i++)
+                command_buffer->draw_indexed(3);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    backend.submit(command_buffers.data(), command_buffers.size());
+    const NullSubmitStats& stats = backend.submit_stats();
+    REQUIRE(stats.num_draws == num_threads * draws_per_thread);
+    REQUIRE(stats.num_pipeline_binds == num_threads);
+    REQUIRE(stats.num_buffer_binds == 2 * num_threads);
+    REQUIRE(stats.num_invalid_commands == 0);
+
+    backend.end_frame();
+    REQUIRE(backend.submit_stats().num_draws == 0);
+
+    for (size_t i = 0; i < num_threads; i++)
+        delete command_buffers[i];
+    destroy_test_scene(&backend, scene);
+}
+
+TEST_CASE("Submit Skips Commands With Dead Handles", "[command_buffer]")
+{
+    NullBackend backend(test_config);
+    TestScene scene = create_test_scene(&backend);
+
+    CommandBuffer command_buffer;
+    // Indexed draw with nothing bound
+    command_buffer.draw_indexed(3);
+    command_buffer.bind_pipeline(scene.pipeline);
+    command_buffer.bind_vertex_buffer(0, scene.vertex_buffer);
+    command_buffer.draw(3);
+
+    destroy_test_scene(&backend, scene);
+
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+    backend.submit(command_buffers, 1);
+    REQUIRE(backend.submit_stats().num_draws == 0);
+    REQUIRE(backend.submit_stats().num_invalid_commands == 4);
+}
+
+TEST_CASE("Draws Without A Bound Pipeline Are Invalid", "[command_buffer]")
+{
+    NullBackend backend(test_config);
+
+    CommandBuffer command_buffer;
+    command_buffer.draw(3);
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+
+    // No pipeline ever created
+    backend.submit(command_buffers, 1);
+    REQUIRE(backend.submit_stats().num_draws == 0);
+    REQUIRE(backend.submit_stats().num_invalid_commands == 1);
+
+    // Created, but never bound
+    TestScene scene = create_test_scene(&backend);
+    backend.end_frame();
+    backend.submit(command_buffers, 1);
+    REQUIRE(backend.submit_stats().num_draws == 0);
+    REQUIRE(backend.submit_stats().num_invalid_commands == 1);
+
+    destroy_test_scene(&backend, scene);
+}
+
+TEST_CASE("Reset Command Buffers Don't Allocate", "[command_buffer]")
+{
+    Utils::PoolAllocator block_pool(1024, 4);
+    CommandBuffer command_buffer(block_pool);
+    Pipeline pipeline = {};
+
+    for (size_t i = 0; i < 500; i++)
+        command_buffer.bind_pipeline(pipeline);
+    command_buffer.reset();
+
+    size_t allocations = Utils::num_tracked_allocations();
+    for (size_t frame = 0; frame < 10; frame++)
+    {
+        for (size_t i = 0; i < 500; i++)
+            command_buffer.bind_pipeline(pipeline);
+        command_buffer.reset();
+    }
+    REQUIRE(Utils::num_tracked_allocations() == allocations);
+}
+
+TEST_CASE("Command Buffers Give Their Blocks Back", "[command_buffer]")
+{
+    Utils::PoolAllocator block_pool(1024, 4);
+    Pipeline pipeline = {};
+
+    auto record_frame = [&]() {
+        CommandBuffer command_buffer(block_pool);
+        for (size_t i = 0; i < 500; i++)
+            command_buffer.bind_pipeline(pipeline);
+        REQUIRE(command_buffer.num_commands() == 500);
+    };
+
+    record_frame();
+    size_t num_pages = block_pool.num_pages();
+    size_t allocations = Utils::num_tracked_allocations();
+    REQUIRE(num_pages > 1);
+
+    // A new command buffer every frame, recorded into the same blocks
+    for (size_t frame = 0; frame < 10; frame++)
+        record_frame();
+    REQUIRE(block_pool.num_pages() == num_pages);
+    REQUIRE(Utils::num_tracked_allocations() == allocations);
+}
@@ -0,0 +1,102 @@
+#include <catch2/catch.hpp>
+#include <thread>
+#include "utils.h"
+
+static const size_t num_threads = 8;
+
+TEST_CASE("Concurrent Add/Get/Remove Stress", "[concurrent_weak_ref_manager]")
+{
+    Utils::ConcurrentWeakRefManager<uint64_t, 64> manager(64);
+
+    const size_t num_iterations = 2000;
+    const size_t refs_per_iteration = 16;
+    std::atomic<size_t> num_failures(0);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&, t]() {
+            Utils::WeakRef refs[refs_per_iteration];
+            for (size_t i = 0; i < num_iterations; i++)
+            {
+                for (size_t r = 0; r < refs_per_iteration; r++)
+                    refs[r] = manager.add((t << 32) | r);
+
+                for (size_t r = 0; r < refs_per_iteration; r++)
+                {
+                    uint64_t* val = manager.get(refs[r]);
+                    if (!val || *val != ((t << 32) | r))
+                        num_failures++;
+                }
+
+                for (size_t r = 0; r < refs_per_iteration; r++)
+                {
+                    if (!manager.remove(refs[r]))
+                        num_failures++;
+                    if (manager.ref_is_valid(refs[r]))
+                        num_failures++;
+                }
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    REQUIRE(num_failures == 0);
+}
+
+TEST_CASE("Concurrent Removal Succeeds Once", "[concurrent_weak_ref_manager]")
+{
+    Utils::ConcurrentWeakRefManager<int> manager(1024);
+
+    const size_t num_refs = 1024;
+    std::vector<Utils::WeakRef> refs;
+    for (size_t i = 0; i < num_refs; i++)
+        refs.push_back(manager.add(i));
+
+    // Every thread tries to remove every ref, only one of them should win each
+    std::atomic<size_t> num_removed(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([&]() {
+            for (size_t i = 0; i < num_refs; i++)
+            {
+                if (manager.remove(refs[i]))
+                    num_removed++;
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+
+    REQUIRE(num_removed == num_refs);
+    for (size_t i = 0; i < num_refs; i++)
+        REQUIRE(!manager.ref_is_valid(refs[i]));
+}
+
+TEST_CASE("Concurrent Removal Frees WeakRefs", "[concurrent_weak_ref_manager]")
+{
+    Utils::ConcurrentWeakRefManager<int> manager(1);
+
+    auto old_ref = manager.add(888);
+    manager.remove(old_ref);
+
+    auto new_ref = manager.add(999);
+    REQUIRE(new_ref.index == old_ref.index);
+    REQUIRE(new_ref.generation != old_ref.generation);
+    REQUIRE(*manager.get(new_ref) == 999);
+    REQUIRE(manager.get(old_ref) == nullptr);
+}
+
+TEST_CASE("Concurrent Default WeakRefs Are Invalid", "[concurrent_weak_ref_manager]")
+{
+    Utils::ConcurrentWeakRefManager<int> manager(4);
+
+    Utils::WeakRef default_ref = {};
+    REQUIRE(!manager.ref_is_valid(default_ref));
+    REQUIRE(manager.get(default_ref) == nullptr);
+    REQUIRE(!manager.remove(default_ref));
+}
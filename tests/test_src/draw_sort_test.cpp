@@ -0,0 +1,107 @@
+#include <catch2/catch.hpp>
+#include "graphics_sort.h"
+#include "graphics_null.h"
+
+using namespace Graphics;
+
+TEST_CASE("Opaque Keys Sort By Layer, State, Then Front To Back", "[draw_sort]")
+{
+    uint64_t near_draw = make_sort_key(SORT_KEY_OPAQUE, 0, 1, 0, 0.1f);
+    uint64_t far_draw = make_sort_key(SORT_KEY_OPAQUE, 0, 1, 0, 0.9f);
+    uint64_t other_pipeline = make_sort_key(SORT_KEY_OPAQUE, 0, 2, 0, 0.0f);
+    uint64_t next_layer = make_sort_key(SORT_KEY_OPAQUE, 1, 0, 0, 0.0f);
+
+    REQUIRE(near_draw < far_draw);
+    REQUIRE(far_draw < other_pipeline);
+    REQUIRE(other_pipeline < next_layer);
+}
+
+TEST_CASE("Transparent Keys Sort Back To Front", "[draw_sort]")
+{
+    uint64_t near_draw = make_sort_key(SORT_KEY_TRANSPARENT, 0, 1, 0, 0.1f);
+    uint64_t far_draw = make_sort_key(SORT_KEY_TRANSPARENT, 0, 2, 0, 0.9f);
+    uint64_t next_layer = make_sort_key(SORT_KEY_TRANSPARENT, 1, 0, 0, 1.0f);
+
+    REQUIRE(far_draw < near_draw);
+    REQUIRE(near_draw < next_layer);
+
+    // Out of range depths clamp instead of spilling into other fields
+    REQUIRE(make_sort_key(SORT_KEY_TRANSPARENT, 0, 0, 0, 5.0f) == make_sort_key(SORT_KEY_TRANSPARENT, 0, 0, 0, 1.0f));
+    REQUIRE(make_sort_key(SORT_KEY_OPAQUE, 0, 0, 0, -1.0f) == make_sort_key(SORT_KEY_OPAQUE, 0, 0, 0, 0.0f));
+}
+
+TEST_CASE("Draw Sorter Groups State Changes", "[draw_sort]")
+{
+    BackendConfig config = { 16, 16, 16, 16, 2 };
+    NullBackend backend(config);
+
+    ShaderStageConfig stages[1] = { { VERTEX_SHADER, "void main() {}" } };
+    ShaderConfig shader_config = { stages, 1 };
+    Shader shader = backend.create_shader(shader_config);
+    // Different attributes so the backend doesn't share them
+    VertexAttributeConfig attributes[2] = {
+        { VertexAttributeConfig::VEC3, 0, 0, false },
+        { VertexAttributeConfig::VEC4, 0, 0, false }
+    };
+    PipelineConfig pipeline_configs[2] = {
+        { &shader, 1, &attributes[0], 1, nullptr, 0, nullptr, 0 },
+        { &shader, 1, &attributes[1], 1, nullptr, 0, nullptr, 0 }
+    };
+    Pipeline pipelines[2] = { backend.create_pipeline(pipeline_configs[0]), backend.create_pipeline(pipeline_configs[1]) };
+    REQUIRE(pipelines[0] != pipelines[1]);
+    float vertices[9] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer vertex_buffer = backend.create_vertex_buffer(vertex_config);
+
+    // Two threads' worth of draws, alternating pipelines
+    DrawList lists[2];
+    const size_t draws_per_list = 100;
+    for (size_t l = 0; l < 2; l++)
+    {
+        for (size_t i = 0; i < draws_per_list; i++)
+        {
+            size_t p = i % 2;
+            DrawPacket packet = {};
+            packet.sort_key = make_sort_key(SORT_KEY_OPAQUE, 0, p, 0, i / (float) draws_per_list);
+            packet.pipeline = pipelines[p];
+            packet.vertex_buffer = vertex_buffer;
+            packet.num_elements = 3;
+            // Tags the draw with its depth order so we can check it below
+            packet.first_element = i;
+            lists[l].add(packet);
+        }
+    }
+
+    DrawList* draw_lists[2] = { &lists[0], &lists[1] };
+    DrawSorter sorter;
+    CommandBuffer command_buffer;
+    sorter.sort(draw_lists, 2, &command_buffer);
+
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+    backend.submit(command_buffers, 1);
+    REQUIRE(backend.submit_stats().num_draws == 2 * draws_per_list);
+    REQUIRE(backend.submit_stats().num_pipeline_binds == 2);
+    REQUIRE(backend.submit_stats().num_buffer_binds == 2);
+    REQUIRE(backend.submit_stats().num_invalid_commands == 0);
+
+    // Within a pipeline, draws come out front to back
+    size_t last_first_element = 0;
+    size_t num_draws = 0;
+    for (const Command* command = command_buffer.first_command(); command; command = command->next)
+    {
+        if (command->type == COMMAND_BIND_PIPELINE)
+            last_first_element = 0;
+        if (command->type != COMMAND_DRAW)
+            continue;
+        const DrawCommand* draw = (const DrawCommand*) command;
+        REQUIRE(draw->first_vertex >= last_first_element);
+        last_first_element = draw->first_vertex;
+        num_draws++;
+    }
+    REQUIRE(num_draws == 2 * draws_per_list);
+
+    backend.destroy_vertex_buffer(vertex_buffer);
+    backend.destroy_pipeline(pipelines[0]);
+    backend.destroy_pipeline(pipelines[1]);
+    backend.destroy_shader(shader);
+}
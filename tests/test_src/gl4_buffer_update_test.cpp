@@ -0,0 +1,64 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include "graphics_gl4.h"
+#include "gl4_stubs.h"
+
+using namespace Graphics;
+
+TEST_CASE("Upload Method Per Usage", "[gl4_buffer_update]")
+{
+    // Static buffers always take the simple path
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_STATIC, 0, 1024, 1024, false) == GL4_UPLOAD_SUB_DATA);
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_STATIC, 256, 256, 1024, false) == GL4_UPLOAD_SUB_DATA);
+
+    // Whole rewrites orphan
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_DYNAMIC, 0, 1024, 1024, false) == GL4_UPLOAD_ORPHAN);
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_STREAM, 0, 1024, 1024, false) == GL4_UPLOAD_ORPHAN);
+
+    // Partial ones copy, or map when streaming
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_DYNAMIC, 256, 256, 1024, false) == GL4_UPLOAD_SUB_DATA);
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_STREAM, 256, 256, 1024, false) == GL4_UPLOAD_MAP_INVALIDATE);
+}
+
+TEST_CASE("GL4 Buffer Updates", "[gl4_buffer_update]")
+{
+    install_gl4_stubs();
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    GL4Backend backend(config);
+
+    uint8_t initial[16] = {};
+    uint8_t update[16];
+    for (size_t i = 0; i < sizeof(update); i++)
+        update[i] = i + 1;
+
+    SECTION("Stream")
+    {
+        VertexBufferConfig vertex_config = { initial, sizeof(initial), BUFFER_USAGE_STREAM };
+        VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+        REQUIRE(last_usage == GL_STREAM_DRAW);
+
+        backend.update_vertex_buffer(buffer, 4, update, 8);
+        REQUIRE(num_maps == 1);
+        backend.update_vertex_buffer(buffer, 0, update, sizeof(update));
+        REQUIRE(num_buffer_data == 2);
+        REQUIRE(memcmp(stub_storage.data(), update, sizeof(update)) == 0);
+        backend.destroy_vertex_buffer(buffer);
+    }
+
+    SECTION("Index")
+    {
+        IndexBufferConfig index_config = { UNSIGNED_SHORT, initial, 8 };
+        IndexBuffer buffer = backend.create_index_buffer(index_config);
+        REQUIRE(last_usage == GL_STATIC_DRAW);
+
+        // Indices, not bytes
+        backend.update_index_buffer(buffer, 2, update, 3);
+        REQUIRE(num_buffer_sub_data == 1);
+        REQUIRE(stub_storage[3] == 0);
+        REQUIRE(memcmp(stub_storage.data() + 4, update, 6) == 0);
+        REQUIRE(stub_storage[10] == 0);
+        backend.destroy_index_buffer(buffer);
+    }
+
+    backend.end_frame();
+}
@@ -0,0 +1,172 @@
+#include <catch2/catch.hpp>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <physfs.h>
+#include "graphics_gl4_program_cache.h"
+#include "gl4_stubs.h"
+
+using namespace Graphics;
+
+// Binaries are just the program name as bytes, and the driver accepts them
+// unless told not to
+static bool stub_accept_binaries = true;
+static GLint stub_link_status = GL_FALSE;
+static std::vector<uint8_t> stub_loaded_binary;
+
+static void APIENTRY stub_get_binary_programiv(GLuint, GLenum name, GLint* params)
+{
+    if (name == GL_PROGRAM_BINARY_LENGTH)
+        *params = sizeof(GLuint);
+    else if (name == GL_LINK_STATUS)
+        *params = stub_link_status;
+}
+
+static void APIENTRY stub_get_program_binary(GLuint program, GLsizei, GLsizei* length, GLenum* format, void* binary)
+{
+    memcpy(binary, &program, sizeof(program));
+    *length = sizeof(program);
+    *format = 0x1234;
+}
+
+static void APIENTRY stub_program_binary(GLuint, GLenum format, const void* binary, GLsizei length)
+{
+    stub_loaded_binary.assign((const uint8_t*) binary, (const uint8_t*) binary + length);
+    stub_link_status = stub_accept_binaries && format == 0x1234 ? GL_TRUE : GL_FALSE;
+}
+
+static void install_gl_stubs()
+{
+    install_gl4_stubs();
+    glad_glGetProgramiv = stub_get_binary_programiv;
+    glad_glGetProgramBinary = stub_get_program_binary;
+    glad_glProgramBinary = stub_program_binary;
+    stub_accept_binaries = true;
+    stub_link_status = GL_FALSE;
+    stub_loaded_binary.clear();
+}
+
+// Each test case gets a fresh write dir
+struct PhysfsScope
+{
+    PhysfsScope()
+    {
+        char dir_template[] = "/tmp/program_cache_test_XXXXXX";
+        REQUIRE(mkdtemp(dir_template));
+        dir = dir_template;
+        REQUIRE(PHYSFS_init(nullptr));
+        REQUIRE(PHYSFS_setWriteDir(dir.c_str()));
+    }
+    ~PhysfsScope()
+    {
+        PHYSFS_deinit();
+        std::string command = "rm -rf " + dir;
+        system(command.c_str());
+    }
+    std::string dir;
+};
+
+static ShaderStageConfig test_stages[] = {
+    { VERTEX_SHADER, "void main() { gl_Position = vec4(0.0); }" },
+    { FRAGMENT_SHADER, "out vec4 color; void main() { color = vec4(1.0); }" }
+};
+static const ShaderConfig test_config = { test_stages, 2 };
+
+TEST_CASE("Program Cache Round Trip", "[gl4_program_cache]")
+{
+    install_gl_stubs();
+    PhysfsScope physfs;
+    Utils::LinearArena arena(4096);
+
+    GL4ProgramCache cache;
+    cache.init("program_cache");
+    REQUIRE(cache.enabled());
+
+    uint64_t key = cache.program_key(test_config);
+    REQUIRE(cache.load_program(key, arena) == 0);
+    REQUIRE(cache.stats().num_misses == 1);
+
+    GLuint program = 42;
+    cache.store_program(key, program, arena);
+    REQUIRE(cache.stats().num_stored == 1);
+
+    // A later run finds it
+    GL4ProgramCache warm_cache;
+    warm_cache.init("program_cache");
+    REQUIRE(warm_cache.program_key(test_config) == key);
+    GLuint loaded = warm_cache.load_program(key, arena);
+    REQUIRE(loaded != 0);
+    REQUIRE(warm_cache.stats().num_hits == 1);
+    REQUIRE(stub_loaded_binary.size() == sizeof(program));
+    REQUIRE(memcmp(&stub_loaded_binary[0], &program, sizeof(program)) == 0);
+}
+
+TEST_CASE("Program Cache Keys", "[gl4_program_cache]")
+{
+    uint64_t key = hash_program_sources(test_config, 1);
+
+    SECTION("Driver")
+    {
+        REQUIRE(hash_program_sources(test_config, 2) != key);
+    }
+
+    SECTION("Source")
+    {
+        ShaderStageConfig stages[] = { test_stages[0], { FRAGMENT_SHADER, "out vec4 color; void main() { color = vec4(0.5); }" } };
+        ShaderConfig config = { stages, 2 };
+        REQUIRE(hash_program_sources(config, 1) != key);
+    }
+
+    SECTION("Stage")
+    {
+        ShaderStageConfig stages[] = { test_stages[0], { GEOMETRY_SHADER, test_stages[1].source } };
+        ShaderConfig config = { stages, 2 };
+        REQUIRE(hash_program_sources(config, 1) != key);
+    }
+}
+
+TEST_CASE("Program Cache Invalidation", "[gl4_program_cache]")
+{
+    install_gl_stubs();
+    PhysfsScope physfs;
+    Utils::LinearArena arena(4096);
+
+    GL4ProgramCache cache;
+    cache.init("program_cache");
+    uint64_t key = cache.program_key(test_config);
+    cache.store_program(key, 42, arena);
+
+    SECTION("Driver change")
+    {
+        stub_renderer = "Other Renderer";
+        GL4ProgramCache new_driver_cache;
+        new_driver_cache.init("program_cache");
+        uint64_t new_key = new_driver_cache.program_key(test_config);
+        REQUIRE(new_key != key);
+        REQUIRE(new_driver_cache.load_program(new_key, arena) == 0);
+        REQUIRE(new_driver_cache.stats().num_misses == 1);
+    }
+
+    SECTION("Driver rejects the binary")
+    {
+        stub_accept_binaries = false;
+        GL4ProgramCache warm_cache;
+        warm_cache.init("program_cache");
+        REQUIRE(warm_cache.load_program(key, arena) == 0);
+        REQUIRE(warm_cache.stats().num_rejected == 1);
+        REQUIRE(warm_cache.stats().num_misses == 1);
+    }
+}
+
+TEST_CASE("Program Cache Disabled", "[gl4_program_cache]")
+{
+    install_gl_stubs();
+    Utils::LinearArena arena(4096);
+
+    GL4ProgramCache cache;
+    cache.init(nullptr);
+    REQUIRE(!cache.enabled());
+    cache.store_program(cache.program_key(test_config), 42, arena);
+    REQUIRE(cache.stats().num_stored == 0);
+}
@@ -0,0 +1,110 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include "graphics_gl4.h"
+#include "gl4_stubs.h"
+
+using namespace Graphics;
+
+// Compiles always succeed; stub_complete decides whether they've finished yet
+static bool stub_complete = false;
+static size_t num_status_queries = 0;
+static GLuint stub_max_threads = 0;
+
+static void APIENTRY stub_get_counted_shaderiv(GLuint, GLenum name, GLint* params)
+{
+    if (name == GL_COMPILE_STATUS)
+        num_status_queries++;
+    *params = GL_TRUE;
+}
+
+static void APIENTRY stub_get_counted_programiv(GLuint, GLenum name, GLint* params)
+{
+    if (name == GL4_COMPLETION_STATUS_KHR)
+    {
+        *params = stub_complete ? GL_TRUE : GL_FALSE;
+        return;
+    }
+    if (name == GL_LINK_STATUS)
+        num_status_queries++;
+    *params = GL_TRUE;
+}
+
+static void APIENTRY stub_max_shader_compiler_threads(GLuint count) { stub_max_threads = count; }
+
+static void* stub_proc_loader(const char* name)
+{
+    if (strcmp(name, "glMaxShaderCompilerThreadsKHR") == 0)
+        return (void*) stub_max_shader_compiler_threads;
+    return nullptr;
+}
+
+static void install_gl_stubs()
+{
+    install_gl4_stubs();
+    glad_glGetShaderiv = stub_get_counted_shaderiv;
+    glad_glGetProgramiv = stub_get_counted_programiv;
+    stub_extensions.push_back("GL_KHR_parallel_shader_compile");
+    stub_complete = false;
+    num_status_queries = 0;
+    stub_max_threads = 0;
+}
+
+static ShaderStageConfig test_stages[] = {
+    { VERTEX_SHADER, "void main() { gl_Position = vec4(0.0); }" },
+    { FRAGMENT_SHADER, "out vec4 color; void main() { color = vec4(1.0); }" }
+};
+static const ShaderConfig test_config = { test_stages, 2 };
+static const BackendConfig test_config_backend = { 4, 4, 4, 4, 2, nullptr, stub_proc_loader };
+
+TEST_CASE("Shader Creation Doesn't Wait For The Compiler", "[gl4_shader_compile]")
+{
+    install_gl_stubs();
+    GL4Backend backend(test_config_backend);
+
+    Shader shader = backend.create_shader(test_config);
+    REQUIRE(num_status_queries == 0);
+    REQUIRE(stub_max_threads == GL4_MAX_SHADER_COMPILER_THREADS_ANY);
+
+    // Polling doesn't block while the driver is still busy
+    REQUIRE(!backend.is_shader_ready(shader));
+    REQUIRE(num_status_queries == 0);
+
+    stub_complete = true;
+    REQUIRE(backend.is_shader_ready(shader));
+    // Both stages and the link checked once, and the stages cleaned up
+    REQUIRE(num_status_queries == 3);
+    REQUIRE(num_deleted_shaders == 2);
+
+    REQUIRE(backend.is_shader_ready(shader));
+    REQUIRE(num_status_queries == 3);
+
+    backend.destroy_shader(shader);
+}
+
+TEST_CASE("Shader Readiness Without Parallel Compile", "[gl4_shader_compile]")
+{
+    install_gl_stubs();
+    stub_extensions.clear();
+    GL4Backend backend(test_config_backend);
+
+    Shader shader = backend.create_shader(test_config);
+    REQUIRE(num_status_queries == 0);
+    REQUIRE(stub_max_threads == 0);
+
+    // Can't ask without waiting, so asking finishes it
+    REQUIRE(backend.is_shader_ready(shader));
+    REQUIRE(num_status_queries == 3);
+
+    backend.destroy_shader(shader);
+}
+
+TEST_CASE("Destroying A Pending Shader", "[gl4_shader_compile]")
+{
+    install_gl_stubs();
+    GL4Backend backend(test_config_backend);
+
+    Shader shader = backend.create_shader(test_config);
+    backend.destroy_shader(shader);
+    REQUIRE(num_deleted_shaders == 2);
+    REQUIRE(!backend.is_shader_ready(shader));
+}
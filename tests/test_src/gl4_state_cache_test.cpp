@@ -0,0 +1,71 @@
+#include <catch2/catch.hpp>
+#include "graphics_gl4_state.h"
+#include "gl4_stubs.h"
+
+using namespace Graphics;
+
+TEST_CASE("State Cache Filters Redundant Binds", "[gl4_state_cache]")
+{
+    install_gl4_stubs();
+    GL4StateCache cache;
+
+    cache.bind_program_pipeline(1);
+    cache.bind_program_pipeline(1);
+    cache.bind_buffer(GL_ARRAY_BUFFER, 5);
+    cache.bind_buffer(GL_ARRAY_BUFFER, 5);
+    cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+    cache.bind_vertex_buffer(0, 5, 0, 12);
+    cache.bind_vertex_buffer(0, 5, 0, 12);
+    // Same buffer, different offset is a real change
+    cache.bind_vertex_buffer(0, 5, 48, 12);
+
+    REQUIRE(num_binds == 5);
+    REQUIRE(cache.stats().num_issued == 5);
+    REQUIRE(cache.stats().num_filtered == 3);
+
+    cache.reset_stats();
+    REQUIRE(cache.stats().num_issued == 0);
+    REQUIRE(cache.stats().num_filtered == 0);
+}
+
+TEST_CASE("State Cache Vertex Array Owns Its Bindings", "[gl4_state_cache]")
+{
+    install_gl4_stubs();
+    GL4StateCache cache;
+
+    cache.bind_vertex_array(1);
+    cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 7);
+    cache.bind_vertex_buffer(0, 8, 0, 16);
+    cache.bind_buffer(GL_ARRAY_BUFFER, 9);
+
+    // Switching VAOs swaps out the element array and vertex buffer bindings,
+    // but not the array buffer binding
+    cache.bind_vertex_array(2);
+    num_binds = 0;
+    cache.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, 7);
+    cache.bind_vertex_buffer(0, 8, 0, 16);
+    cache.bind_buffer(GL_ARRAY_BUFFER, 9);
+    REQUIRE(num_binds == 2);
+}
+
+TEST_CASE("State Cache Forgets Deleted Objects", "[gl4_state_cache]")
+{
+    install_gl4_stubs();
+    GL4StateCache cache;
+
+    cache.bind_buffer(GL_ARRAY_BUFFER, 3);
+    cache.bind_program_pipeline(4);
+
+    // The names get deleted and handed out again for new objects, which
+    // have to actually be bound
+    cache.forget_buffer(3);
+    cache.forget_program_pipeline(4);
+    num_binds = 0;
+    cache.bind_buffer(GL_ARRAY_BUFFER, 3);
+    cache.bind_program_pipeline(4);
+    REQUIRE(num_binds == 2);
+
+    cache.invalidate();
+    cache.bind_buffer(GL_ARRAY_BUFFER, 3);
+    REQUIRE(num_binds == 3);
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <cstring>
+#include <vector>
+#include <glad/glad.h>
+
+// No context in tests, so glad gets pointed at stubs instead of a driver.
+// install_gl4_stubs gives every entry point the GL4 code uses a stub that
+// does nothing, or just enough to pass for a driver, and counts what reaches
+// it. Tests then overwrite the glad_glXxx pointers whose behavior they're
+// testing.
+
+// Reset by install_gl4_stubs
+static GLuint stub_next_name = 1;
+// What GL_NUM_EXTENSIONS and glGetStringi report
+static std::vector<const char*> stub_extensions;
+static const char* stub_renderer = "Test Renderer";
+// Contents of the last buffer given storage. Maps and sub data land here.
+static std::vector<uint8_t> stub_storage;
+static GLenum last_usage = GL_NONE;
+static size_t num_binds = 0;
+static size_t num_buffer_data = 0;
+static size_t num_buffer_sub_data = 0;
+static size_t num_maps = 0;
+static size_t num_copies = 0;
+static size_t num_deleted_shaders = 0;
+static size_t num_vertex_arrays = 0;
+static size_t num_draws = 0;
+
+static void APIENTRY stub_get_integerv(GLenum name, GLint* data)
+{
+    switch (name)
+    {
+        case GL_NUM_EXTENSIONS: *data = stub_extensions.size(); break;
+        case GL_NUM_PROGRAM_BINARY_FORMATS: *data = 1; break;
+        default: *data = 0; break;
+    }
+}
+
+static const GLubyte* APIENTRY stub_get_string(GLenum name)
+{
+    switch (name)
+    {
+        case GL_VENDOR: return (const GLubyte*) "Test Vendor";
+        case GL_RENDERER: return (const GLubyte*) stub_renderer;
+        case GL_VERSION: return (const GLubyte*) "4.5 Test";
+        default: return nullptr;
+    }
+}
+
+static const GLubyte* APIENTRY stub_get_stringi(GLenum, GLuint index)
+{
+    return index < stub_extensions.size() ? (const GLubyte*) stub_extensions[index] : nullptr;
+}
+
+static void APIENTRY stub_gen_names(GLsizei count, GLuint* names)
+{
+    for (GLsizei i = 0; i < count; i++)
+        names[i] = stub_next_name++;
+}
+static void APIENTRY stub_delete_names(GLsizei, const GLuint*) {}
+
+static void APIENTRY stub_bind_buffer(GLenum, GLuint) { num_binds++; }
+static void APIENTRY stub_bind_vertex_array(GLuint) { num_binds++; }
+static void APIENTRY stub_bind_program_pipeline(GLuint) { num_binds++; }
+static void APIENTRY stub_bind_vertex_buffer(GLuint, GLuint, GLintptr, GLsizei) { num_binds++; }
+
+static void APIENTRY stub_buffer_data(GLenum, GLsizeiptr size, const void* data, GLenum usage)
+{
+    num_buffer_data++;
+    last_usage = usage;
+    stub_storage.assign(size, 0);
+    if (data)
+        memcpy(stub_storage.data(), data, size);
+}
+
+static void APIENTRY stub_buffer_sub_data(GLenum, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    num_buffer_sub_data++;
+    memcpy(stub_storage.data() + offset, data, size);
+}
+
+static void* APIENTRY stub_map_buffer_range(GLenum, GLintptr offset, GLsizeiptr size, GLbitfield)
+{
+    num_maps++;
+    if (stub_storage.size() < (size_t) (offset + size))
+        stub_storage.resize(offset + size);
+    return stub_storage.data() + offset;
+}
+
+static GLboolean APIENTRY stub_unmap_buffer(GLenum) { return GL_TRUE; }
+static void APIENTRY stub_copy_buffer_sub_data(GLenum, GLenum, GLintptr, GLintptr, GLsizeiptr) { num_copies++; }
+
+static GLuint APIENTRY stub_create_shader(GLenum) { return stub_next_name++; }
+static GLuint APIENTRY stub_create_program() { return stub_next_name++; }
+static void APIENTRY stub_shader_source(GLuint, GLsizei, const GLchar* const*, const GLint*) {}
+static void APIENTRY stub_compile_shader(GLuint) {}
+static void APIENTRY stub_program_parameteri(GLuint, GLenum, GLint) {}
+static void APIENTRY stub_attach_shader(GLuint, GLuint) {}
+static void APIENTRY stub_detach_shader(GLuint, GLuint) {}
+static void APIENTRY stub_link_program(GLuint) {}
+static void APIENTRY stub_delete_shader(GLuint) { num_deleted_shaders++; }
+static void APIENTRY stub_delete_program(GLuint) {}
+
+// Every compile, link and pipeline validation succeeds
+static void APIENTRY stub_get_shaderiv(GLuint, GLenum, GLint* params) { *params = GL_TRUE; }
+static void APIENTRY stub_get_programiv(GLuint, GLenum, GLint* params) { *params = GL_TRUE; }
+static void APIENTRY stub_get_program_pipelineiv(GLuint, GLenum, GLint* params) { *params = GL_TRUE; }
+static void APIENTRY stub_use_program_stages(GLuint, GLbitfield, GLuint) {}
+static void APIENTRY stub_validate_program_pipeline(GLuint) {}
+
+static void APIENTRY stub_gen_vertex_arrays(GLsizei count, GLuint* names)
+{
+    num_vertex_arrays += count;
+    stub_gen_names(count, names);
+}
+static void APIENTRY stub_enable_vertex_attrib_array(GLuint) {}
+static void APIENTRY stub_vertex_attrib_format(GLuint, GLint, GLenum, GLboolean, GLuint) {}
+static void APIENTRY stub_vertex_attrib_binding(GLuint, GLuint) {}
+
+static void APIENTRY stub_draw_arrays(GLenum, GLint, GLsizei) { num_draws++; }
+static void APIENTRY stub_draw_elements(GLenum, GLsizei, GLenum, const void*) { num_draws++; }
+
+static void install_gl4_stubs()
+{
+    glad_glGetIntegerv = stub_get_integerv;
+    glad_glGetString = stub_get_string;
+    glad_glGetStringi = stub_get_stringi;
+    glad_glGenBuffers = stub_gen_names;
+    glad_glGenVertexArrays = stub_gen_vertex_arrays;
+    glad_glGenProgramPipelines = stub_gen_names;
+    glad_glDeleteBuffers = stub_delete_names;
+    glad_glDeleteVertexArrays = stub_delete_names;
+    glad_glDeleteProgramPipelines = stub_delete_names;
+    glad_glDeleteTextures = stub_delete_names;
+    glad_glBindBuffer = stub_bind_buffer;
+    glad_glBindVertexArray = stub_bind_vertex_array;
+    glad_glBindProgramPipeline = stub_bind_program_pipeline;
+    glad_glBindVertexBuffer = stub_bind_vertex_buffer;
+    glad_glBufferData = stub_buffer_data;
+    glad_glBufferSubData = stub_buffer_sub_data;
+    glad_glMapBufferRange = stub_map_buffer_range;
+    glad_glUnmapBuffer = stub_unmap_buffer;
+    glad_glCopyBufferSubData = stub_copy_buffer_sub_data;
+    glad_glCreateShader = stub_create_shader;
+    glad_glCreateProgram = stub_create_program;
+    glad_glShaderSource = stub_shader_source;
+    glad_glCompileShader = stub_compile_shader;
+    glad_glProgramParameteri = stub_program_parameteri;
+    glad_glAttachShader = stub_attach_shader;
+    glad_glDetachShader = stub_detach_shader;
+    glad_glLinkProgram = stub_link_program;
+    glad_glDeleteShader = stub_delete_shader;
+    glad_glDeleteProgram = stub_delete_program;
+    glad_glGetShaderiv = stub_get_shaderiv;
+    glad_glGetProgramiv = stub_get_programiv;
+    glad_glGetProgramPipelineiv = stub_get_program_pipelineiv;
+    glad_glUseProgramStages = stub_use_program_stages;
+    glad_glValidateProgramPipeline = stub_validate_program_pipeline;
+    glad_glEnableVertexAttribArray = stub_enable_vertex_attrib_array;
+    glad_glVertexAttribFormat = stub_vertex_attrib_format;
+    glad_glVertexAttribBinding = stub_vertex_attrib_binding;
+    glad_glDrawArrays = stub_draw_arrays;
+    glad_glDrawElements = stub_draw_elements;
+
+    stub_next_name = 1;
+    stub_extensions.clear();
+    stub_renderer = "Test Renderer";
+    stub_storage.clear();
+    last_usage = GL_NONE;
+    num_binds = 0;
+    num_buffer_data = 0;
+    num_buffer_sub_data = 0;
+    num_maps = 0;
+    num_copies = 0;
+    num_deleted_shaders = 0;
+    num_vertex_arrays = 0;
+    num_draws = 0;
+}
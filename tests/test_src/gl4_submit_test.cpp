@@ -0,0 +1,64 @@
+#include <catch2/catch.hpp>
+#include "graphics_gl4.h"
+#include "graphics_commands.h"
+#include "gl4_stubs.h"
+#include "captured_log.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+TEST_CASE("Submit Without A Bound Pipeline", "[gl4_submit]")
+{
+    install_gl4_stubs();
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    GL4Backend backend(config);
+
+    CommandBuffer command_buffer;
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+    command_buffer.draw(3);
+
+    // No pipelines at all yet
+    backend.submit(command_buffers, 1);
+    REQUIRE(num_draws == 0);
+
+    // Pipelines exist, none of them bound. Nothing to warn about either,
+    // there's no handle to be invalid.
+    TestScene scene = create_test_scene(&backend);
+    {
+        CapturedLog log;
+        backend.submit(command_buffers, 1);
+        REQUIRE(log.read().find("Invalid ref") == std::string::npos);
+    }
+    REQUIRE(num_draws == 0);
+
+    command_buffer.reset();
+    command_buffer.bind_pipeline(scene.pipeline);
+    command_buffer.draw(3);
+    backend.submit(command_buffers, 1);
+    REQUIRE(num_draws == 1);
+
+    destroy_test_scene(&backend, scene);
+}
+
+TEST_CASE("Indexed Draws Need An Index Buffer", "[gl4_submit]")
+{
+    install_gl4_stubs();
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    GL4Backend backend(config);
+    TestScene scene = create_test_scene(&backend);
+
+    CommandBuffer command_buffer;
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+    command_buffer.bind_pipeline(scene.pipeline);
+    command_buffer.draw_indexed(3);
+    backend.submit(command_buffers, 1);
+    REQUIRE(num_draws == 0);
+
+    command_buffer.reset();
+    command_buffer.bind_index_buffer(scene.index_buffer);
+    command_buffer.draw_indexed(3);
+    backend.submit(command_buffers, 1);
+    REQUIRE(num_draws == 1);
+
+    destroy_test_scene(&backend, scene);
+}
@@ -0,0 +1,259 @@
+#include <catch2/catch.hpp>
+#include <cstring>
+#include "graphics_gl4.h"
+#include "graphics_commands.h"
+#include "gl4_stubs.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+// Mapped memory is plain host memory, fences are just numbers, and
+// stub_gpu_behind decides whether a fence has signaled by the time the ring
+// asks
+static bool stub_gpu_behind = false;
+static size_t num_fences = 0;
+static size_t num_live_fences = 0;
+static GLbitfield last_storage_flags = 0;
+
+// Buffer data would move the ring's mapping out from under it
+static void APIENTRY stub_count_buffer_data(GLenum, GLsizeiptr, const void*, GLenum) { num_buffer_data++; }
+
+static void APIENTRY stub_buffer_storage(GLenum, GLsizeiptr size, const void*, GLbitfield flags)
+{
+    stub_storage.assign(size, 0);
+    last_storage_flags = flags;
+}
+
+static GLsync APIENTRY stub_fence_sync(GLenum, GLbitfield)
+{
+    num_live_fences++;
+    return (GLsync) ++num_fences;
+}
+
+static void APIENTRY stub_delete_sync(GLsync) { num_live_fences--; }
+
+static GLenum APIENTRY stub_client_wait_sync(GLsync, GLbitfield, GLuint64 timeout)
+{
+    // A real wait always ends with the GPU caught up
+    return stub_gpu_behind && timeout == 0 ? GL_TIMEOUT_EXPIRED : GL_CONDITION_SATISFIED;
+}
+
+static void* stub_proc_loader(const char* name)
+{
+    if (strcmp(name, "glBufferStorage") == 0)
+        return (void*) stub_buffer_storage;
+    return nullptr;
+}
+
+static void install_gl_stubs()
+{
+    install_gl4_stubs();
+    glad_glBufferData = stub_count_buffer_data;
+    glad_glFenceSync = stub_fence_sync;
+    glad_glDeleteSync = stub_delete_sync;
+    glad_glClientWaitSync = stub_client_wait_sync;
+    stub_extensions.push_back("GL_ARB_buffer_storage");
+    stub_gpu_behind = false;
+    num_fences = 0;
+    num_live_fences = 0;
+    last_storage_flags = 0;
+}
+
+TEST_CASE("Upload Ring Regions", "[gl4_upload_ring]")
+{
+    install_gl_stubs();
+    GL4StateCache state_cache;
+    GL4UploadRing ring;
+    REQUIRE(ring.init(1000, 3, stub_buffer_storage, state_cache));
+    REQUIRE((last_storage_flags & GL4_MAP_PERSISTENT_BIT) != 0);
+    REQUIRE((last_storage_flags & GL4_MAP_COHERENT_BIT) != 0);
+    REQUIRE(stub_storage.size() == 3 * 1024);
+
+    size_t offset = 1;
+    REQUIRE(ring.allocate(100, &offset) == stub_storage.data());
+    REQUIRE(offset == 0);
+    REQUIRE(ring.allocate(100, &offset));
+    REQUIRE(offset == GL4_UPLOAD_RING_ALIGNMENT);
+
+    // Doesn't spill into the next frame's region
+    REQUIRE(!ring.allocate(900, &offset));
+    REQUIRE(ring.stats().num_overflows == 1);
+
+    ring.end_frame();
+    REQUIRE(num_fences == 1);
+    REQUIRE(ring.allocate(100, &offset));
+    REQUIRE(offset == 1024);
+    REQUIRE(ring.in_current_region(offset));
+    ring.end_frame();
+    // Nothing written, nothing to fence
+    ring.end_frame();
+    REQUIRE(num_fences == 2);
+
+    // Back at the first region, with the GPU still on it
+    stub_gpu_behind = true;
+    REQUIRE(ring.allocate(100, &offset));
+    REQUIRE(offset == 0);
+    REQUIRE(ring.stats().num_waits == 1);
+    REQUIRE(num_live_fences == 1);
+
+    // Same frame, already waited
+    REQUIRE(ring.allocate(100, &offset));
+    REQUIRE(ring.stats().num_waits == 1);
+    REQUIRE(ring.stats().num_allocations == 5);
+
+    ring.release(state_cache);
+    REQUIRE(num_live_fences == 0);
+    REQUIRE(!ring.enabled());
+}
+
+TEST_CASE("Upload Ring Without Buffer Storage", "[gl4_upload_ring]")
+{
+    install_gl_stubs();
+    GL4StateCache state_cache;
+    GL4UploadRing ring;
+    REQUIRE(!ring.init(1000, 3, nullptr, state_cache));
+    REQUIRE(!ring.enabled());
+    REQUIRE(!ring.init(0, 3, stub_buffer_storage, state_cache));
+    REQUIRE(!ring.enabled());
+}
+
+static const BackendConfig test_config = { 4, 4, 4, 4, 2, nullptr, stub_proc_loader, 4096 };
+
+TEST_CASE("Stream Buffers Upload Through The Ring", "[gl4_upload_ring]")
+{
+    install_gl_stubs();
+    GL4Backend backend(test_config);
+
+    uint8_t vertices[64] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices), BUFFER_USAGE_STREAM };
+    VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+    REQUIRE(num_buffer_data == 1);
+    REQUIRE(get_gl_upload_method(BUFFER_USAGE_STREAM, 0, 64, 64, true) == GL4_UPLOAD_RING);
+
+    SECTION("Full rewrites")
+    {
+        for (size_t i = 0; i < sizeof(vertices); i++)
+            vertices[i] = i;
+        backend.update_vertex_buffer(buffer, 0, vertices, sizeof(vertices));
+        // Only the ring's own mapping, done once
+        REQUIRE(num_maps == 1);
+        REQUIRE(num_buffer_data == 1);
+        REQUIRE(backend.upload_ring_stats().num_allocations == 1);
+        REQUIRE(memcmp(stub_storage.data(), vertices, sizeof(vertices)) == 0);
+
+        backend.end_frame();
+        backend.update_vertex_buffer(buffer, 0, vertices, sizeof(vertices));
+        REQUIRE(num_maps == 1);
+        REQUIRE(backend.upload_ring_stats().num_allocations == 2);
+    }
+
+    SECTION("Partial update after a full one")
+    {
+        backend.update_vertex_buffer(buffer, 0, vertices, sizeof(vertices));
+        // The rest of the contents come back from the ring first
+        backend.update_vertex_buffer(buffer, 16, vertices, 16);
+        REQUIRE(num_copies == 1);
+        REQUIRE(backend.upload_ring_stats().num_allocations == 1);
+    }
+
+    SECTION("Ring full")
+    {
+        uint8_t big[8192] = {};
+        VertexBufferConfig big_config = { big, sizeof(big), BUFFER_USAGE_STREAM };
+        VertexBuffer big_buffer = backend.create_vertex_buffer(big_config);
+        backend.update_vertex_buffer(big_buffer, 0, big, sizeof(big));
+        REQUIRE(backend.upload_ring_stats().num_overflows == 1);
+        // Orphaned instead
+        REQUIRE(num_buffer_data == 3);
+        backend.destroy_vertex_buffer(big_buffer);
+    }
+
+    backend.destroy_vertex_buffer(buffer);
+}
+
+TEST_CASE("Stale Buffers Leave The Ring", "[gl4_upload_ring]")
+{
+    install_gl_stubs();
+    GL4Backend backend(test_config);
+
+    uint8_t vertices[64] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices), BUFFER_USAGE_STREAM };
+    VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+    backend.update_vertex_buffer(buffer, 0, vertices, sizeof(vertices));
+
+    // Two frames in flight, so the ring has three regions and comes back to
+    // this one on the third end_frame
+    backend.end_frame();
+    backend.end_frame();
+    REQUIRE(num_copies == 0);
+    backend.end_frame();
+    REQUIRE(num_copies == 1);
+    // Fenced again to cover the copy
+    REQUIRE(num_fences == 2);
+
+    // Already home, so only once
+    backend.end_frame();
+    backend.end_frame();
+    backend.end_frame();
+    REQUIRE(num_copies == 1);
+
+    backend.destroy_vertex_buffer(buffer);
+}
+
+static size_t num_vertex_buffer_binds = 0;
+static void APIENTRY stub_count_bind_vertex_buffer(GLuint, GLuint, GLintptr, GLsizei) { num_vertex_buffer_binds++; }
+
+TEST_CASE("Destroyed Ring Buffers Aren't Rebound", "[gl4_upload_ring]")
+{
+    install_gl_stubs();
+    glad_glBindVertexBuffer = stub_count_bind_vertex_buffer;
+    num_vertex_buffer_binds = 0;
+    GL4Backend backend(test_config);
+
+    // Same shader, another vertex format, so binding it switches VAOs and
+    // the bound vertex buffers get applied to the new one
+    TestScene scene = create_test_scene(&backend);
+    VertexAttributeConfig attributes[1] = { { VertexAttributeConfig::VEC2, 0, 0, false } };
+    BufferType buffer_types[1] = { VERTEX };
+    PipelineConfig other_config = { &scene.shader, 1, attributes, 1, buffer_types, 1, nullptr, 0 };
+    Pipeline other_pipeline = backend.create_pipeline(other_config);
+
+    uint8_t vertices[64] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices), BUFFER_USAGE_STREAM };
+    VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+    backend.update_vertex_buffer(buffer, 0, vertices, sizeof(vertices));
+    REQUIRE(backend.upload_ring_stats().num_allocations == 1);
+
+    CommandBuffer command_buffer;
+    CommandBuffer* command_buffers[1] = { &command_buffer };
+    command_buffer.bind_pipeline(scene.pipeline);
+    command_buffer.bind_vertex_buffer(0, buffer);
+    backend.submit(command_buffers, 1);
+    REQUIRE(num_vertex_buffer_binds == 1);
+
+    // The binding points into the ring, which outlives the buffer
+    backend.destroy_vertex_buffer(buffer);
+    command_buffer.reset();
+    command_buffer.bind_pipeline(other_pipeline);
+    backend.submit(command_buffers, 1);
+    REQUIRE(num_vertex_buffer_binds == 1);
+
+    backend.destroy_pipeline(other_pipeline);
+    destroy_test_scene(&backend, scene);
+}
+
+TEST_CASE("No Ring Without Buffer Storage", "[gl4_upload_ring]")
+{
+    install_gl_stubs();
+    stub_extensions.clear();
+    GL4Backend backend(test_config);
+
+    uint8_t vertices[64] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices), BUFFER_USAGE_STREAM };
+    VertexBuffer buffer = backend.create_vertex_buffer(vertex_config);
+    backend.update_vertex_buffer(buffer, 0, vertices, sizeof(vertices));
+    REQUIRE(num_buffer_data == 2);
+    REQUIRE(backend.upload_ring_stats().num_allocations == 0);
+
+    backend.destroy_vertex_buffer(buffer);
+}
@@ -0,0 +1,143 @@
+#include <catch2/catch.hpp>
+#include "graphics_gl4.h"
+#include "gl4_stubs.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+static void fill_attributes(VertexAttributeConfig* attributes, size_t num_attributes)
+{
+    for (size_t i = 0; i < num_attributes; i++)
+    {
+        attributes[i].type = (VertexAttributeConfig::Type) (i % 4);
+        attributes[i].binding = 0;
+        attributes[i].location = i;
+        attributes[i].normalized = false;
+    }
+}
+
+TEST_CASE("Vertex Format Offsets And Stride", "[gl4_vertex_format]")
+{
+    VertexAttributeConfig attributes[3];
+    fill_attributes(attributes, 3);
+
+    GL4VertexFormat format;
+    get_gl_vertex_format(&format, attributes, 3);
+
+    // float, vec2, vec3 packed back to back
+    REQUIRE(format.num_attributes == 3);
+    REQUIRE(format.attributes[0].offset == 0);
+    REQUIRE(format.attributes[1].offset == 4);
+    REQUIRE(format.attributes[2].offset == 12);
+    REQUIRE(format.attributes[2].size == 3);
+    REQUIRE(format.stride == 24);
+}
+
+TEST_CASE("Vertex Format Hash", "[gl4_vertex_format]")
+{
+    VertexAttributeConfig attributes[4];
+    fill_attributes(attributes, 4);
+
+    GL4VertexFormat a;
+    GL4VertexFormat b;
+    get_gl_vertex_format(&a, attributes, 4);
+    get_gl_vertex_format(&b, attributes, 4);
+    // Formats from identical configs share a VAO
+    REQUIRE(hash_gl_vertex_format(a) == hash_gl_vertex_format(b));
+
+    SECTION("Attribute count")
+    {
+        get_gl_vertex_format(&b, attributes, 3);
+        REQUIRE(hash_gl_vertex_format(a) != hash_gl_vertex_format(b));
+    }
+
+    SECTION("Attribute type")
+    {
+        attributes[3].type = VertexAttributeConfig::FLOAT;
+        get_gl_vertex_format(&b, attributes, 4);
+        REQUIRE(hash_gl_vertex_format(a) != hash_gl_vertex_format(b));
+    }
+
+    SECTION("Attribute location")
+    {
+        attributes[0].location = 7;
+        get_gl_vertex_format(&b, attributes, 4);
+        REQUIRE(hash_gl_vertex_format(a) != hash_gl_vertex_format(b));
+    }
+
+    SECTION("Normalization")
+    {
+        attributes[1].normalized = true;
+        get_gl_vertex_format(&b, attributes, 4);
+        REQUIRE(hash_gl_vertex_format(a) != hash_gl_vertex_format(b));
+    }
+}
+
+TEST_CASE("Vertex Format Match", "[gl4_vertex_format]")
+{
+    VertexAttributeConfig attributes[4];
+    fill_attributes(attributes, 4);
+
+    GL4VertexFormat a;
+    GL4VertexFormat b;
+    get_gl_vertex_format(&a, attributes, 4);
+    get_gl_vertex_format(&b, attributes, 4);
+    // Attributes past num_attributes don't count
+    b.attributes[5].location = 42;
+    REQUIRE(gl_vertex_formats_match(a, b));
+
+    SECTION("Attribute count")
+    {
+        get_gl_vertex_format(&b, attributes, 3);
+        REQUIRE(!gl_vertex_formats_match(a, b));
+    }
+
+    SECTION("Attribute binding")
+    {
+        attributes[2].binding = 1;
+        get_gl_vertex_format(&b, attributes, 4);
+        REQUIRE(!gl_vertex_formats_match(a, b));
+    }
+
+    SECTION("Normalization")
+    {
+        attributes[1].normalized = true;
+        get_gl_vertex_format(&b, attributes, 4);
+        REQUIRE(!gl_vertex_formats_match(a, b));
+    }
+}
+
+TEST_CASE("Pipelines Share Vertex Formats", "[gl4_vertex_format]")
+{
+    install_gl4_stubs();
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    GL4Backend backend(config);
+
+    Shader shaders[2] = { create_test_shader(&backend), create_test_shader(&backend) };
+    // Different shader lists, so these are different pipelines
+    VertexAttributeConfig attributes[2];
+    fill_attributes(attributes, 2);
+    BufferType buffer_types[1] = { VERTEX };
+    PipelineConfig first_config = { &shaders[0], 1, attributes, 2, buffer_types, 1, nullptr, 0 };
+    PipelineConfig second_config = { shaders, 2, attributes, 2, buffer_types, 1, nullptr, 0 };
+    PipelineConfig third_config = { &shaders[0], 1, attributes, 1, buffer_types, 1, nullptr, 0 };
+
+    Pipeline first = backend.create_pipeline(first_config);
+    Pipeline second = backend.create_pipeline(second_config);
+    REQUIRE(first != second);
+    REQUIRE(num_vertex_arrays == 1);
+
+    Pipeline third = backend.create_pipeline(third_config);
+    REQUIRE(num_vertex_arrays == 2);
+
+    // The format outlives the first pipeline using it
+    backend.destroy_pipeline(first);
+    Pipeline again = backend.create_pipeline(first_config);
+    REQUIRE(num_vertex_arrays == 2);
+
+    backend.destroy_pipeline(again);
+    backend.destroy_pipeline(second);
+    backend.destroy_pipeline(third);
+    backend.destroy_shader(shaders[0]);
+    backend.destroy_shader(shaders[1]);
+}
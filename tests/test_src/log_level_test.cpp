@@ -0,0 +1,47 @@
+#include <catch2/catch.hpp>
+#include <string>
+#include "utils.h"
+#include "captured_log.h"
+
+static int num_evaluations = 0;
+
+static int count_evaluation()
+{
+    return ++num_evaluations;
+}
+
+TEST_CASE("Disabled Levels Don't Evaluate Arguments", "[log]")
+{
+    CapturedLog log;
+    num_evaluations = 0;
+
+    LOG_DISABLED("%d", count_evaluation());
+    REQUIRE(num_evaluations == 0);
+
+    // The level is pinned for the whole build, so what's compiled out here
+    // depends on the configuration
+    LOG_VERBOSE("%d", count_evaluation());
+    LOG_INFO_CH(LOG_CHANNEL_GRAPHICS, "%d", count_evaluation());
+    int num_compiled_in = (LOG_COMPILE_LEVEL <= LOG_LEVEL_VERBOSE) + (LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO);
+    REQUIRE(num_evaluations == num_compiled_in);
+
+    LOG_ERROR("enabled %d", count_evaluation());
+    REQUIRE(num_evaluations == num_compiled_in + 1);
+    REQUIRE(log.read().find("enabled " + std::to_string(num_compiled_in + 1)) != std::string::npos);
+}
+
+TEST_CASE("Channel Mask Filters At Runtime", "[log]")
+{
+    CapturedLog log;
+    num_evaluations = 0;
+
+    Utils::log_set_enabled_channels(LOG_CHANNEL_ALL & ~LOG_CHANNEL_GRAPHICS);
+    LOG_WARNING_CH(LOG_CHANNEL_GRAPHICS, "graphics %d", count_evaluation());
+    LOG_WARNING_CH(LOG_CHANNEL_IO, "io %d", count_evaluation());
+    REQUIRE(num_evaluations == 1);
+
+    std::string output = log.read();
+    REQUIRE(output.find("graphics") == std::string::npos);
+    REQUIRE(output.find("[io]") != std::string::npos);
+    REQUIRE(output.find("io 1") != std::string::npos);
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "utils.h"
+#include "captured_log.h"
+
+TEST_CASE("Log Formats Arguments", "[log]")
+{
+    CapturedLog log;
+
+    const char* name = "pipeline";
+    char buffer[] = "mutable";
+    uint8_t generation = 200;
+    size_t count = 123456789012ull;
+    LOG_INFO("%s %s %d %u %zu %llu %5.2f %x %c %%", name, buffer, -42, generation, count, count, 3.14159, 255u, 'z');
+
+    std::string output = log.read();
+    REQUIRE(output.find("INFO ") == 0);
+    REQUIRE(output.find("pipeline mutable -42 200 123456789012 123456789012  3.14 ff z %\n") != std::string::npos);
+}
+
+TEST_CASE("Log Copies String Arguments", "[log]")
+{
+    CapturedLog log;
+
+    {
+        std::string transient = "gone by the time it's formatted";
+        LOG_WARNING("%s", transient.c_str());
+        transient.assign(transient.size(), 'x');
+    }
+
+    REQUIRE(log.read().find("gone by the time it's formatted") != std::string::npos);
+}
+
+TEST_CASE("Log From Many Threads", "[log]")
+{
+    CapturedLog log;
+
+    const int num_threads = 8;
+    const int num_messages = 200;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_threads; t++)
+    {
+        threads.emplace_back([t]() {
+            for (int i = 0; i < num_messages; i++)
+                LOG_INFO("thread %d message %d", t, i);
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    std::string output = log.read();
+    size_t num_lines = 0;
+    for (size_t i = 0; i < output.size(); i++)
+        num_lines += output[i] == '\n';
+
+    // Every message made it, or the dropped ones were reported
+    REQUIRE(num_lines + Utils::log_num_dropped() >= (size_t) (num_threads * num_messages));
+    REQUIRE(output.find("thread 7 message 199\n") != std::string::npos);
+}
+
+// Logs from a thread_local destructor that runs after the logger has
+// retired the thread's ring
+struct LogOnThreadExit
+{
+    ~LogOnThreadExit()
+    {
+        // Long enough for the background thread to free the retired ring
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        LOG_INFO("logged after the ring was retired");
+    }
+};
+
+TEST_CASE("Log After Thread Ring Retired", "[log]")
+{
+    CapturedLog log;
+
+    std::thread thread([]() {
+        // Constructed before the first log, so destroyed after the logger's
+        // own thread_local
+        static thread_local LogOnThreadExit on_exit;
+        (void) on_exit;
+        LOG_INFO("first message");
+    });
+    thread.join();
+
+    std::string output = log.read();
+    REQUIRE(output.find("first message") != std::string::npos);
+    REQUIRE(output.find("logged after the ring was retired") != std::string::npos);
+}
@@ -0,0 +1,173 @@
+#include <catch2/catch.hpp>
+#include "graphics_manifest.h"
+#include "graphics_null.h"
+
+using namespace Graphics;
+
+static const BackendConfig test_config = { 16, 16, 16, 16, 2 };
+
+static ShaderStageConfig test_stages[2] = {
+    { VERTEX_SHADER, "void main() {}" },
+    { FRAGMENT_SHADER, "out vec4 color; void main() { color = vec4(1.0); }" }
+};
+static const ShaderConfig test_shader_config = { test_stages, 2 };
+
+static VertexAttributeConfig test_attributes[2] = {
+    { VertexAttributeConfig::VEC3, 0, 0, false },
+    { VertexAttributeConfig::VEC2, 0, 1, false }
+};
+static BufferType test_buffer_types[1] = { VERTEX };
+
+// What a game would do on startup: make a shader and a few pipelines from it
+static void create_test_pipelines(Backend* backend, Shader* out_shader, Pipeline* out_pipelines, size_t num_pipelines)
+{
+    *out_shader = backend->create_shader(test_shader_config);
+    for (size_t i = 0; i < num_pipelines; i++)
+    {
+        PipelineConfig config = {
+            out_shader, 1,
+            test_attributes, i + 1 > 2 ? 2 : i + 1,
+            test_buffer_types, 1,
+            nullptr, 0
+        };
+        out_pipelines[i] = backend->create_pipeline(config);
+    }
+}
+
+static void destroy_test_pipelines(Backend* backend, Shader shader, Pipeline* pipelines, size_t num_pipelines)
+{
+    for (size_t i = 0; i < num_pipelines; i++)
+        backend->destroy_pipeline(pipelines[i]);
+    backend->destroy_shader(shader);
+}
+
+TEST_CASE("Manifest Records Unique Configs", "[manifest]")
+{
+    NullBackend null_backend(test_config);
+    ManifestBackend backend(&null_backend);
+
+    Shader shader;
+    Pipeline pipelines[3];
+    create_test_pipelines(&backend, &shader, pipelines, 3);
+
+    // The same shader again, and a repeat of the second pipeline
+    Shader same_shader = backend.create_shader(test_shader_config);
+    REQUIRE(same_shader == shader);
+    REQUIRE(backend.num_shaders() == 1);
+    REQUIRE(backend.num_pipelines() == 2);
+
+    // Still one reference left to the shared handle
+    backend.destroy_shader(same_shader);
+    REQUIRE(backend.num_shader_handles() == 1);
+    destroy_test_pipelines(&backend, shader, pipelines, 3);
+    REQUIRE(null_backend.num_shaders() == 0);
+    REQUIRE(null_backend.num_pipelines() == 0);
+    // The manifest keeps the config, not the handle
+    REQUIRE(backend.num_shader_handles() == 0);
+    REQUIRE(backend.num_shaders() == 1);
+}
+
+TEST_CASE("Manifest Handle Map Stays Bounded", "[manifest]")
+{
+    NullBackend null_backend(test_config);
+    ManifestBackend backend(&null_backend);
+
+    // Each round frees the slot and gets it back under a new generation
+    for (size_t i = 0; i < 100; i++)
+    {
+        Shader shader;
+        Pipeline pipelines[1];
+        create_test_pipelines(&backend, &shader, pipelines, 1);
+        destroy_test_pipelines(&backend, shader, pipelines, 1);
+    }
+    REQUIRE(backend.num_shader_handles() == 0);
+    REQUIRE(backend.num_shaders() == 1);
+    REQUIRE(backend.num_pipelines() == 1);
+}
+
+TEST_CASE("Prewarmed Pipelines Are Reused", "[manifest]")
+{
+    std::vector<uint8_t> manifest;
+    {
+        NullBackend null_backend(test_config);
+        ManifestBackend backend(&null_backend);
+        Shader shader;
+        Pipeline pipelines[2];
+        create_test_pipelines(&backend, &shader, pipelines, 2);
+        destroy_test_pipelines(&backend, shader, pipelines, 2);
+        manifest = backend.manifest();
+    }
+
+    // Next run
+    NullBackend backend(test_config);
+    PipelinePrewarmer prewarmer;
+    REQUIRE(prewarmer.load(manifest.data(), manifest.size()));
+    REQUIRE(prewarmer.num_pipelines() == 2);
+
+    SECTION("Everything at once")
+    {
+        REQUIRE(prewarmer.update(&backend, 16));
+    }
+
+    SECTION("A pipeline per update")
+    {
+        REQUIRE(!prewarmer.update(&backend, 1));
+        REQUIRE(prewarmer.num_created() == 1);
+        REQUIRE(prewarmer.update(&backend, 1));
+    }
+
+    REQUIRE(prewarmer.num_created() == 2);
+    REQUIRE(backend.num_shaders() == 1);
+    REQUIRE(backend.num_pipelines() == 2);
+
+    // The game gets the prewarmed objects back instead of new ones
+    Shader shader;
+    Pipeline pipelines[2];
+    create_test_pipelines(&backend, &shader, pipelines, 2);
+    REQUIRE(backend.num_shaders() == 1);
+    REQUIRE(backend.num_pipelines() == 2);
+
+    // And they outlive the prewarmer's references
+    prewarmer.release(&backend);
+    REQUIRE(backend.get_pipeline(pipelines[0]));
+    REQUIRE(backend.get_pipeline(pipelines[1]));
+
+    destroy_test_pipelines(&backend, shader, pipelines, 2);
+    REQUIRE(backend.num_shaders() == 0);
+    REQUIRE(backend.num_pipelines() == 0);
+}
+
+TEST_CASE("Malformed Manifests", "[manifest]")
+{
+    NullBackend null_backend(test_config);
+    ManifestBackend backend(&null_backend);
+    Shader shader;
+    Pipeline pipelines[1];
+    create_test_pipelines(&backend, &shader, pipelines, 1);
+    destroy_test_pipelines(&backend, shader, pipelines, 1);
+    std::vector<uint8_t> manifest = backend.manifest();
+
+    PipelinePrewarmer prewarmer;
+
+    SECTION("Bad magic")
+    {
+        manifest[0] ^= 0xFF;
+        REQUIRE(!prewarmer.load(manifest.data(), manifest.size()));
+    }
+
+    SECTION("Truncated")
+    {
+        REQUIRE(!prewarmer.load(manifest.data(), manifest.size() - 1));
+    }
+
+    SECTION("Unknown record")
+    {
+        manifest.push_back(0xFF);
+        REQUIRE(!prewarmer.load(manifest.data(), manifest.size()));
+    }
+
+    // Nothing half loaded is left behind to prewarm
+    REQUIRE(prewarmer.num_pipelines() == 0);
+    REQUIRE(prewarmer.update(&null_backend, 16));
+    REQUIRE(null_backend.num_shaders() == 0);
+}
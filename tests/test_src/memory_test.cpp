@@ -0,0 +1,170 @@
+#include <catch2/catch.hpp>
+#include <atomic>
+#include <new>
+#include <vector>
+#include "utils_memory.h"
+#include "graphics_null.h"
+#include "test_scene.h"
+
+// Count every global heap allocation in this test, not just the ones the
+// allocators track themselves
+static std::atomic<size_t> num_heap_allocations(0);
+
+void* operator new(size_t size)
+{
+    num_heap_allocations++;
+    void* result = malloc(size);
+    if (!result)
+        throw std::bad_alloc();
+    return result;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+TEST_CASE("Arena Allocations Are Aligned And Distinct", "[memory]")
+{
+    Utils::LinearArena arena(256);
+
+    uint8_t* a = (uint8_t*) arena.allocate(3, 1);
+    uint32_t* b = arena.allocate_array<uint32_t>(4);
+    double* c = arena.allocate_array<double>(2);
+
+    REQUIRE((uintptr_t) b % alignof(uint32_t) == 0);
+    REQUIRE((uintptr_t) c % alignof(double) == 0);
+    REQUIRE((uint8_t*) b >= a + 3);
+    REQUIRE((uint8_t*) c >= (uint8_t*) (b + 4));
+}
+
+TEST_CASE("Arena Grows Past Its Block Size", "[memory]")
+{
+    Utils::LinearArena arena(64);
+
+    // Bigger than a block, and enough small ones to spill into a new block
+    void* big = arena.allocate(1024);
+    REQUIRE(big);
+    for (int i = 0; i < 32; i++)
+        REQUIRE(arena.allocate(16));
+
+    REQUIRE(arena.bytes_reserved() >= 1024 + 32 * 16);
+}
+
+TEST_CASE("Scratch Scopes Rewind The Arena", "[memory]")
+{
+    Utils::LinearArena arena(1024);
+
+    void* before = arena.allocate(8);
+    void* inside;
+    {
+        Utils::ScratchScope scratch(arena);
+        inside = scratch.allocate(8);
+    }
+    void* after = arena.allocate(8);
+
+    REQUIRE(before != inside);
+    REQUIRE(after == inside);
+}
+
+TEST_CASE("Pool Reuses Freed Elements", "[memory]")
+{
+    Utils::PoolAllocator pool(24, 4);
+    REQUIRE(pool.get_element_size() % UTILS_DEFAULT_ALIGNMENT == 0);
+
+    std::vector<void*> elements;
+    for (int i = 0; i < 10; i++)
+        elements.push_back(pool.allocate());
+    REQUIRE(pool.num_pages() == 3);
+
+    void* freed = elements[5];
+    pool.free(freed);
+    REQUIRE(pool.allocate() == freed);
+    REQUIRE(pool.num_pages() == 3);
+}
+
+TEST_CASE("Steady State Frames Don't Allocate", "[memory]")
+{
+    using namespace Graphics;
+
+    BackendConfig config = { 64, 64, 64, 64, 2 };
+    NullBackend backend(config);
+    TestScene scene = create_test_scene(&backend);
+    Utils::LinearArena frame_arena(4096);
+
+    const size_t num_buffers = 16;
+    const size_t num_vertices = 64;
+    size_t num_draws = 0;
+    size_t num_invalid_commands = 0;
+
+    // What a frame of a streaming renderer asks of the backend: transient
+    // vertex buffers made, filled and dropped again, a shader looked up in
+    // the cache, and command buffers recorded from scratch and submitted
+    auto run_frame = [&]() {
+        frame_arena.reset();
+
+        float* vertices = frame_arena.allocate_array<float>(num_vertices * 3);
+        VertexBufferConfig vertex_config = { vertices, num_vertices * 3 * sizeof(float), BUFFER_USAGE_STREAM };
+        VertexBuffer* buffers = frame_arena.allocate_array<VertexBuffer>(num_buffers);
+        for (size_t i = 0; i < num_buffers; i++)
+        {
+            buffers[i] = backend.create_vertex_buffer(vertex_config);
+            backend.update_vertex_buffer(buffers[i], 0, vertices, 3 * sizeof(float));
+        }
+
+        Shader shader = create_test_shader(&backend);
+
+        {
+            // More than one block's worth of commands in the first buffer
+            CommandBuffer command_buffers[2];
+            for (size_t i = 0; i < num_buffers; i++)
+            {
+                CommandBuffer& command_buffer = command_buffers[i % 2];
+                command_buffer.bind_pipeline(scene.pipeline);
+                command_buffer.bind_vertex_buffer(0, buffers[i]);
+                command_buffer.bind_index_buffer(scene.index_buffer);
+                for (size_t j = 0; j < 256; j++)
+                    command_buffer.draw_indexed(3);
+            }
+            CommandBuffer* submitted[2] = { &command_buffers[0], &command_buffers[1] };
+            backend.submit(submitted, 2);
+        }
+
+        {
+            Utils::ScratchScope scratch(frame_arena);
+            scratch.allocate_array<uint32_t>(1000);
+        }
+
+        backend.destroy_shader(shader);
+        for (size_t i = 0; i < num_buffers; i++)
+            backend.destroy_vertex_buffer(buffers[i]);
+
+        num_draws = backend.submit_stats().num_draws;
+        num_invalid_commands = backend.submit_stats().num_invalid_commands;
+        backend.end_frame();
+    };
+
+    // Warm up until everything has grown to fit
+    run_frame();
+    run_frame();
+    run_frame();
+
+    size_t tracked_before = Utils::num_tracked_allocations();
+    size_t heap_before = num_heap_allocations;
+    for (int i = 0; i < 100; i++)
+        run_frame();
+    size_t tracked_after = Utils::num_tracked_allocations();
+    size_t heap_after = num_heap_allocations;
+
+    REQUIRE(num_draws == num_buffers * 256);
+    REQUIRE(num_invalid_commands == 0);
+    REQUIRE(tracked_after == tracked_before);
+    REQUIRE(heap_after == heap_before);
+
+    destroy_test_scene(&backend, scene);
+}
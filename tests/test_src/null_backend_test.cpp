@@ -0,0 +1,290 @@
+#include <catch2/catch.hpp>
+#include "graphics.h"
+#include "graphics_null.h"
+#include "test_scene.h"
+
+using namespace Graphics;
+
+TEST_CASE("Null Backend Init", "[graphics]")
+{
+    Backend* backend = init_backend(NULL_BACKEND);
+    REQUIRE(backend);
+    REQUIRE(init_backend(NULL_BACKEND) == backend);
+    deinit_backend(backend);
+
+    // deinit forgets the singleton, so we get a fresh backend back
+    Backend* new_backend = init_backend(NULL_BACKEND);
+    REQUIRE(new_backend);
+    REQUIRE(static_cast<NullBackend*>(new_backend)->num_buffers() == 0);
+    deinit_backend(new_backend);
+}
+
+TEST_CASE("Null Backend Buffers", "[graphics]")
+{
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    NullBackend backend(config);
+
+    float vertices[12] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer vertex_buffer = backend.create_vertex_buffer(vertex_config);
+
+    uint16_t indices[6] = {};
+    IndexBufferConfig index_config = { UNSIGNED_SHORT, indices, 6 };
+    IndexBuffer index_buffer = backend.create_index_buffer(index_config);
+
+    REQUIRE(backend.num_buffers() == 2);
+    REQUIRE(backend.get_buffer(vertex_buffer.handle)->type == VERTEX);
+    REQUIRE(backend.get_buffer(vertex_buffer.handle)->size == sizeof(vertices));
+    REQUIRE(backend.get_buffer(index_buffer.handle)->type == INDEX);
+    REQUIRE(backend.get_buffer(index_buffer.handle)->size == sizeof(indices));
+
+    backend.destroy_vertex_buffer(vertex_buffer);
+    REQUIRE(backend.num_buffers() == 1);
+
+    // Destroying twice is a logged no-op
+    backend.destroy_vertex_buffer(vertex_buffer);
+    REQUIRE(backend.num_buffers() == 1);
+
+    backend.destroy_index_buffer(index_buffer);
+    REQUIRE(backend.num_buffers() == 0);
+}
+
+TEST_CASE("Null Backend Pipelines", "[graphics]")
+{
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    NullBackend backend(config);
+
+    Shader shader = create_test_shader(&backend);
+    REQUIRE(backend.num_shaders() == 1);
+    REQUIRE(backend.is_shader_ready(shader));
+
+    VertexAttributeConfig attributes[2] = {
+        { VertexAttributeConfig::VEC3, 0, 0, false },
+        { VertexAttributeConfig::VEC2, 0, 1, false }
+    };
+    BufferType buffer_types[1] = { VERTEX };
+    PipelineConfig pipeline_config = {
+        &shader, 1,
+        attributes, 2,
+        buffer_types, 1,
+        nullptr, 0
+    };
+    Pipeline pipeline = backend.create_pipeline(pipeline_config);
+    REQUIRE(backend.num_pipelines() == 1);
+
+    const NullPipeline* pipeline_obj = backend.get_pipeline(pipeline);
+    REQUIRE(pipeline_obj);
+    REQUIRE(pipeline_obj->stride == 5 * sizeof(float));
+    REQUIRE(pipeline_obj->num_attributes == 2);
+    REQUIRE(pipeline_obj->stage_bitfield == (VERTEX_SHADER | FRAGMENT_SHADER));
+
+    backend.destroy_pipeline(pipeline);
+    backend.destroy_shader(shader);
+    REQUIRE(backend.num_pipelines() == 0);
+    REQUIRE(backend.num_shaders() == 0);
+    REQUIRE(backend.get_pipeline(pipeline) == nullptr);
+    REQUIRE(!backend.is_shader_ready(shader));
+
+    backend.end_frame();
+    REQUIRE(backend.frame_index() == 1);
+}
+
+TEST_CASE("Null Backend Handles Are Typed", "[graphics]")
+{
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    NullBackend backend(config);
+
+    float vertices[4] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    VertexBuffer vertex_buffer = backend.create_vertex_buffer(vertex_config);
+    Shader shader = create_test_shader(&backend);
+
+    // Both live in slot 0 of their tables, but a shader handle passed off as
+    // a buffer carries the wrong type tag and must not resolve
+    REQUIRE(shader.handle.index == vertex_buffer.handle.index);
+    VertexBuffer wrong_type = { shader.handle };
+    backend.destroy_vertex_buffer(wrong_type);
+    REQUIRE(backend.num_buffers() == 1);
+
+    backend.destroy_vertex_buffer(vertex_buffer);
+    backend.destroy_shader(shader);
+    REQUIRE(backend.num_buffers() == 0);
+    REQUIRE(backend.num_shaders() == 0);
+}
+
+TEST_CASE("Null Backend Shares Identical Pipelines", "[graphics]")
+{
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    NullBackend backend(config);
+    Shader shader = create_test_shader(&backend);
+
+    VertexAttributeConfig attributes[1] = {
+        { VertexAttributeConfig::VEC3, 0, 0, false }
+    };
+    BufferType buffer_types[1] = { VERTEX };
+    PipelineConfig pipeline_config = {
+        &shader, 1,
+        attributes, 1,
+        buffer_types, 1,
+        nullptr, 0
+    };
+
+    Pipeline first = backend.create_pipeline(pipeline_config);
+    Pipeline second = backend.create_pipeline(pipeline_config);
+    REQUIRE(first == second);
+    REQUIRE(backend.num_pipelines() == 1);
+
+    // Any difference in the config gets its own pipeline
+    attributes[0].normalized = true;
+    Pipeline third = backend.create_pipeline(pipeline_config);
+    REQUIRE(third != first);
+    REQUIRE(backend.num_pipelines() == 2);
+
+    // Shared pipelines live until the last reference is destroyed
+    backend.destroy_pipeline(first);
+    REQUIRE(backend.get_pipeline(second));
+    backend.destroy_pipeline(second);
+    REQUIRE(backend.get_pipeline(second) == nullptr);
+    REQUIRE(backend.num_pipelines() == 1);
+
+    // And a new one gets made once it's gone
+    attributes[0].normalized = false;
+    Pipeline fourth = backend.create_pipeline(pipeline_config);
+    REQUIRE(fourth != first);
+    REQUIRE(backend.num_pipelines() == 2);
+
+    backend.destroy_pipeline(third);
+    backend.destroy_pipeline(fourth);
+    backend.destroy_shader(shader);
+}
+
+TEST_CASE("Pipeline Config Hash", "[graphics]")
+{
+    Shader shaders[2] = { { Utils::weakref_from_bits(1) }, { Utils::weakref_from_bits(2) } };
+    VertexAttributeConfig attributes[2] = {
+        { VertexAttributeConfig::VEC3, 0, 0, false },
+        { VertexAttributeConfig::VEC2, 0, 1, false }
+    };
+    BufferType buffer_types[1] = { VERTEX };
+    TextureType texture_types[1] = { TEXTURE_2D };
+    PipelineConfig config = { shaders, 1, attributes, 2, buffer_types, 1, texture_types, 1 };
+    const uint64_t hash = hash_pipeline_config(config);
+
+    // Pointers don't matter, contents do
+    VertexAttributeConfig attributes_copy[2] = { attributes[0], attributes[1] };
+    PipelineConfig copy = config;
+    copy.vertex_attributes = attributes_copy;
+    REQUIRE(hash_pipeline_config(copy) == hash);
+
+    copy.shaders = &shaders[1];
+    REQUIRE(hash_pipeline_config(copy) != hash);
+    copy.shaders = shaders;
+
+    attributes_copy[1].location = 2;
+    REQUIRE(hash_pipeline_config(copy) != hash);
+    attributes_copy[1].location = 1;
+
+    copy.num_textures = 0;
+    REQUIRE(hash_pipeline_config(copy) != hash);
+    copy.num_textures = 1;
+
+    // Cache hits are checked against the whole config, not just the hash
+    PipelineConfigKey key;
+    make_pipeline_config_key(config, &key);
+    REQUIRE(pipeline_config_matches(key, copy));
+
+    attributes_copy[0].normalized = true;
+    REQUIRE_FALSE(pipeline_config_matches(key, copy));
+    attributes_copy[0].normalized = false;
+
+    copy.shaders = &shaders[1];
+    REQUIRE_FALSE(pipeline_config_matches(key, copy));
+    copy.shaders = shaders;
+
+    copy.num_buffers = 0;
+    REQUIRE_FALSE(pipeline_config_matches(key, copy));
+}
+
+TEST_CASE("Null Backend Shares Identical Shaders", "[graphics]")
+{
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    NullBackend backend(config);
+
+    Shader first = create_test_shader(&backend);
+    Shader second = create_test_shader(&backend);
+    REQUIRE(first == second);
+    REQUIRE(backend.num_shaders() == 1);
+
+    ShaderStageConfig stages[1] = { { VERTEX_SHADER, "void main() { gl_Position = vec4(1.0); }" } };
+    ShaderConfig other_config = { stages, 1 };
+    Shader other = backend.create_shader(other_config);
+    REQUIRE(other != first);
+    REQUIRE(backend.num_shaders() == 2);
+
+    backend.destroy_shader(first);
+    REQUIRE(backend.is_shader_ready(second));
+    backend.destroy_shader(second);
+    REQUIRE(!backend.is_shader_ready(second));
+    backend.destroy_shader(other);
+    REQUIRE(backend.num_shaders() == 0);
+}
+
+TEST_CASE("Shader Config Key", "[graphics]")
+{
+    ShaderStageConfig stages[2] = {
+        { VERTEX_SHADER, "void main() {}" },
+        { FRAGMENT_SHADER, "void main() {}" }
+    };
+    ShaderConfig config = { stages, 2 };
+    ShaderConfigKey key;
+    make_shader_config_key(config, &key);
+
+    // Sources are compared by contents, not pointer
+    char source_copy[] = "void main() {}";
+    ShaderStageConfig stages_copy[2] = { stages[0], { FRAGMENT_SHADER, source_copy } };
+    ShaderConfig copy = { stages_copy, 2 };
+    REQUIRE(shader_config_matches(key, copy));
+
+    source_copy[0] = 'V';
+    REQUIRE_FALSE(shader_config_matches(key, copy));
+    source_copy[0] = 'v';
+
+    stages_copy[1].stage = GEOMETRY_SHADER;
+    REQUIRE_FALSE(shader_config_matches(key, copy));
+    stages_copy[1].stage = FRAGMENT_SHADER;
+
+    copy.num_stages = 1;
+    REQUIRE_FALSE(shader_config_matches(key, copy));
+}
+
+TEST_CASE("Null Backend Buffer Updates", "[graphics]")
+{
+    BackendConfig config = { 4, 4, 4, 4, 2 };
+    NullBackend backend(config);
+
+    float vertices[8] = {};
+    VertexBufferConfig vertex_config = { vertices, sizeof(vertices), BUFFER_USAGE_STREAM };
+    VertexBuffer vertex_buffer = backend.create_vertex_buffer(vertex_config);
+    uint32_t indices[6] = {};
+    IndexBufferConfig index_config = { UNSIGNED_INT, indices, 6 };
+    IndexBuffer index_buffer = backend.create_index_buffer(index_config);
+
+    backend.update_vertex_buffer(vertex_buffer, 0, vertices, sizeof(vertices));
+    backend.update_vertex_buffer(vertex_buffer, 4 * sizeof(float), vertices, 4 * sizeof(float));
+    // Index updates are counted in indices
+    backend.update_index_buffer(index_buffer, 4, indices, 2);
+
+    const NullBuffer* vertex_obj = backend.get_buffer(vertex_buffer.handle);
+    REQUIRE(vertex_obj->usage == BUFFER_USAGE_STREAM);
+    REQUIRE(vertex_obj->num_updates == 2);
+    REQUIRE(vertex_obj->bytes_updated == 12 * sizeof(float));
+
+    // Static unless asked otherwise
+    const NullBuffer* index_obj = backend.get_buffer(index_buffer.handle);
+    REQUIRE(index_obj->usage == BUFFER_USAGE_STATIC);
+    REQUIRE(index_obj->num_updates == 1);
+    REQUIRE(index_obj->bytes_updated == 2 * sizeof(uint32_t));
+
+    backend.destroy_vertex_buffer(vertex_buffer);
+    backend.destroy_index_buffer(index_buffer);
+}
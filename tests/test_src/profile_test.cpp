@@ -0,0 +1,79 @@
+#include <catch2/catch.hpp>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "utils_profile.h"
+
+static std::string read_file(const char* path)
+{
+    std::string result;
+    FILE* file = fopen(path, "r");
+    REQUIRE(file);
+    char buffer[4096];
+    size_t length;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        result.append(buffer, length);
+    fclose(file);
+    return result;
+}
+
+static size_t count_occurrences(const std::string& text, const std::string& pattern)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+        count++;
+    return count;
+}
+
+TEST_CASE("Profile Scopes Dump As Chrome Trace", "[profile]")
+{
+    {
+        PROFILE_SCOPE("outer \"quoted\"");
+        {
+            PROFILE_SCOPE("inner");
+        }
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+    {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 10; i++)
+            {
+                PROFILE_SCOPE("worker zone");
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    const char* path = "profile_test_trace.json";
+    REQUIRE(Utils::profile_dump(path));
+    std::string trace = read_file(path);
+    remove(path);
+
+    REQUIRE(trace.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[") == 0);
+    REQUIRE(trace.find("\"name\":\"outer \\\"quoted\\\"\"") != std::string::npos);
+    REQUIRE(count_occurrences(trace, "\"name\":\"inner\"") == 1);
+    REQUIRE(count_occurrences(trace, "\"name\":\"worker zone\"") == 40);
+    REQUIRE(count_occurrences(trace, "\"ph\":\"X\"") == 42);
+}
+
+TEST_CASE("Profile Ring Keeps The Latest Zones", "[profile]")
+{
+    std::thread thread([]() {
+        for (int i = 0; i < PROFILE_RING_SIZE + 100; i++)
+        {
+            PROFILE_SCOPE("wrapped zone");
+        }
+    });
+    thread.join();
+
+    const char* path = "profile_test_wrapped.json";
+    REQUIRE(Utils::profile_dump(path));
+    std::string trace = read_file(path);
+    remove(path);
+
+    // The oldest slot may be mid-write, so the dump leaves it out
+    REQUIRE(count_occurrences(trace, "\"name\":\"wrapped zone\"") == PROFILE_RING_SIZE - 1);
+}
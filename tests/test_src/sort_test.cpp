@@ -0,0 +1,93 @@
+#include <catch2/catch.hpp>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <vector>
+#include "utils_sort.h"
+
+// Sorts with radix_sort and checks against std::stable_sort on the same pairs
+static void check_radix_sort(std::vector<uint64_t> keys, Utils::SortWorkers* workers)
+{
+    const size_t count = keys.size();
+    std::vector<uint32_t> values(count);
+    for (size_t i = 0; i < count; i++)
+        values[i] = i;
+
+    std::vector<std::pair<uint64_t, uint32_t>> expected(count);
+    for (size_t i = 0; i < count; i++)
+        expected[i] = std::make_pair(keys[i], values[i]);
+    std::stable_sort(expected.begin(), expected.end(), [](const std::pair<uint64_t, uint32_t>& a, const std::pair<uint64_t, uint32_t>& b) {
+        return a.first < b.first;
+    });
+
+    std::vector<uint64_t> scratch_keys(count);
+    std::vector<uint32_t> scratch_values(count);
+    Utils::radix_sort(keys.data(), values.data(), count, scratch_keys.data(), scratch_values.data(), workers);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        REQUIRE(keys[i] == expected[i].first);
+        REQUIRE(values[i] == expected[i].second);
+    }
+}
+
+TEST_CASE("Radix Sort Matches Stable Sort", "[sort]")
+{
+    const size_t num_threads = GENERATE(as<size_t>{}, 1, 3, 8);
+    const size_t count = GENERATE(as<size_t>{}, 0, 1, 1000, RADIX_SORT_PARALLEL_THRESHOLD * 4 + 7);
+
+    std::mt19937_64 rng(count * 31 + num_threads);
+    std::vector<uint64_t> keys(count);
+    Utils::SortWorkers workers(num_threads);
+
+    SECTION("Random keys")
+    {
+        for (size_t i = 0; i < count; i++)
+            keys[i] = rng();
+        check_radix_sort(keys, &workers);
+    }
+
+    SECTION("Few distinct keys, stability matters")
+    {
+        for (size_t i = 0; i < count; i++)
+            keys[i] = (rng() % 4) << 40;
+        check_radix_sort(keys, &workers);
+    }
+
+    SECTION("Already sorted and reversed")
+    {
+        for (size_t i = 0; i < count; i++)
+            keys[i] = i * 0x10001ull;
+        check_radix_sort(keys, &workers);
+        std::reverse(keys.begin(), keys.end());
+        check_radix_sort(keys, &workers);
+    }
+}
+
+TEST_CASE("Radix Sort Odd Number Of Passes", "[sort]")
+{
+    // Only the low byte differs, so the one pass leaves the result in
+    // scratch and it has to be copied back
+    std::vector<uint64_t> keys;
+    for (size_t i = 0; i < 300; i++)
+        keys.push_back(0xABCD000000000000ull | ((i * 37) & 0xFF));
+    check_radix_sort(keys, nullptr);
+}
+
+static void count_thread(void* context, size_t thread_index)
+{
+    std::atomic<size_t>* counts = (std::atomic<size_t>*) context;
+    counts[thread_index]++;
+}
+
+TEST_CASE("Sort Workers Are Reused Across Runs", "[sort]")
+{
+    Utils::SortWorkers workers(4);
+    REQUIRE(workers.num_threads() == 4);
+
+    std::atomic<size_t> counts[4] = {};
+    for (size_t run = 0; run < 100; run++)
+        workers.run(count_thread, counts);
+    for (size_t t = 0; t < 4; t++)
+        REQUIRE(counts[t] == 100);
+}
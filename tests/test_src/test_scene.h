@@ -0,0 +1,63 @@
+#pragma once
+
+#include "graphics.h"
+
+// What most backend tests need before they can draw anything: a shader, a
+// pipeline taking one vec3 attribute from binding 0, and a triangle's worth
+// of vertex and index buffer. Written against Backend, so the null backend,
+// a CaptureBackend wrapping it or a GL4Backend on stubs all work.
+
+struct TestScene
+{
+    Graphics::Shader shader;
+    Graphics::Pipeline pipeline;
+    Graphics::VertexBuffer vertex_buffer;
+    Graphics::IndexBuffer index_buffer;
+};
+
+// Identical sources every call, so repeated shaders hit the shader cache
+static Graphics::Shader create_test_shader(Graphics::Backend* backend)
+{
+    Graphics::ShaderStageConfig stages[2] = {
+        { Graphics::VERTEX_SHADER, "void main() {}" },
+        { Graphics::FRAGMENT_SHADER, "void main() {}" }
+    };
+    Graphics::ShaderConfig config = { stages, 2 };
+    return backend->create_shader(config);
+}
+
+static TestScene create_test_scene(Graphics::Backend* backend)
+{
+    TestScene scene;
+    scene.shader = create_test_shader(backend);
+
+    Graphics::VertexAttributeConfig attributes[1] = {
+        { Graphics::VertexAttributeConfig::VEC3, 0, 0, false }
+    };
+    Graphics::BufferType buffer_types[1] = { Graphics::VERTEX };
+    Graphics::PipelineConfig pipeline_config = {
+        &scene.shader, 1,
+        attributes, 1,
+        buffer_types, 1,
+        nullptr, 0
+    };
+    scene.pipeline = backend->create_pipeline(pipeline_config);
+
+    float vertices[9] = { 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+    Graphics::VertexBufferConfig vertex_config = { vertices, sizeof(vertices) };
+    scene.vertex_buffer = backend->create_vertex_buffer(vertex_config);
+
+    uint16_t indices[3] = { 0, 1, 2 };
+    Graphics::IndexBufferConfig index_config = { Graphics::UNSIGNED_SHORT, indices, 3 };
+    scene.index_buffer = backend->create_index_buffer(index_config);
+
+    return scene;
+}
+
+static void destroy_test_scene(Graphics::Backend* backend, const TestScene& scene)
+{
+    backend->destroy_index_buffer(scene.index_buffer);
+    backend->destroy_vertex_buffer(scene.vertex_buffer);
+    backend->destroy_pipeline(scene.pipeline);
+    backend->destroy_shader(scene.shader);
+}
@@ -72,7 +72,263 @@ TEST_CASE("No Free Indices Grows Manager", "[weak_ref_manager]")
     auto old_ref = manager.add(888);
     auto new_ref = manager.add(999);
     REQUIRE(new_ref.index == old_ref.index + 1);
-    REQUIRE(new_ref.generation == 0);
+    REQUIRE(new_ref.generation == 1);
     REQUIRE(*manager.get(new_ref) == 999);
     REQUIRE(*manager.get(old_ref) == 888);
-}
\ No newline at end of file
+}
+
+TEST_CASE("Paged Storage Keeps Pointers Stable", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int, Utils::WeakRefPagedStorage<16>> manager(16, 1);
+
+    auto first_ref = manager.add(888);
+    int* first_val = manager.get(first_ref);
+    REQUIRE(first_val);
+
+    for (int i = 0; i < 1024; i++)
+        manager.add(i);
+
+    REQUIRE(manager.get(first_ref) == first_val);
+    REQUIRE(*first_val == 888);
+}
+
+TEST_CASE("Paged Storage Grows By One Page", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int, Utils::WeakRefPagedStorage<4>> manager(4, 1);
+
+    std::vector<Utils::WeakRef> refs;
+    for (int i = 0; i < 5; i++)
+        refs.push_back(manager.add(i));
+
+    REQUIRE(refs[4].index == 4);
+    REQUIRE(refs[4].generation == 1);
+    for (int i = 0; i < 5; i++)
+        REQUIRE(*manager.get(refs[i]) == i);
+}
+
+TEST_CASE("Dense Manager Add/Get/Remove", "[weak_ref_manager]")
+{
+    Utils::DenseWeakRefManager<int> manager(4, 1);
+
+    std::vector<Utils::WeakRef> refs;
+    for (int i = 0; i < 64; i++)
+        refs.push_back(manager.add(i));
+
+    // Remove every other value, which shuffles the dense array around
+    for (int i = 0; i < 64; i += 2)
+        manager.remove(refs[i]);
+
+    REQUIRE(manager.size() == 32);
+    for (int i = 0; i < 64; i++)
+    {
+        int* val = manager.get(refs[i]);
+        if (i % 2 == 0)
+        {
+            REQUIRE(!val);
+        }
+        else
+        {
+            REQUIRE(val);
+            REQUIRE(*val == i);
+        }
+    }
+}
+
+TEST_CASE("Dense Manager Iterates Live Values", "[weak_ref_manager]")
+{
+    Utils::DenseWeakRefManager<int> manager(16, 1);
+
+    std::vector<Utils::WeakRef> refs;
+    for (int i = 0; i < 16; i++)
+        refs.push_back(manager.add(i));
+
+    manager.remove(refs[0]);
+    manager.remove(refs[7]);
+    manager.remove(refs[15]);
+
+    int sum = 0;
+    size_t count = 0;
+    manager.for_each([&](const Utils::WeakRef& ref, int& val) {
+        REQUIRE(manager.get(ref) == &val);
+        sum += val;
+        count++;
+    });
+
+    REQUIRE(count == 13);
+    REQUIRE(sum == (15 * 16) / 2 - 7 - 15);
+}
+
+TEST_CASE("Batched Add/Get/Remove", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int> manager(16, 4);
+
+    const size_t num_refs = GENERATE(as<size_t>{}, 1, 3, 16, 64, 65, 1024);
+    std::vector<int> vals(num_refs);
+    for (size_t i = 0; i < num_refs; i++)
+        vals[i] = i;
+
+    std::vector<Utils::WeakRef> refs(num_refs);
+    manager.add_many(&vals[0], num_refs, &refs[0]);
+
+    std::vector<int*> out_values(num_refs);
+    std::vector<uint64_t> invalid_mask((num_refs + 63) / 64);
+    REQUIRE(manager.get_many(&refs[0], num_refs, &out_values[0], &invalid_mask[0]) == 0);
+    for (size_t i = 0; i < num_refs; i++)
+    {
+        REQUIRE(out_values[i]);
+        REQUIRE(*out_values[i] == (int) i);
+    }
+
+    // Remove every third ref, then check the mask picks out exactly those
+    std::vector<Utils::WeakRef> removed_refs;
+    for (size_t i = 0; i < num_refs; i += 3)
+        removed_refs.push_back(refs[i]);
+    std::vector<uint64_t> remove_mask((removed_refs.size() + 63) / 64);
+    REQUIRE(manager.remove_many(&removed_refs[0], removed_refs.size(), &remove_mask[0]) == 0);
+
+    REQUIRE(manager.get_many(&refs[0], num_refs, &out_values[0], &invalid_mask[0]) == removed_refs.size());
+    for (size_t i = 0; i < num_refs; i++)
+    {
+        bool invalid = (invalid_mask[i / 64] >> (i % 64)) & 1;
+        REQUIRE(invalid == (i % 3 == 0));
+        REQUIRE((out_values[i] == nullptr) == invalid);
+    }
+
+    // Removing them again fails for all of them
+    REQUIRE(manager.remove_many(&removed_refs[0], removed_refs.size(), &remove_mask[0]) == removed_refs.size());
+}
+
+TEST_CASE("Batched Get Rejects Out Of Bounds Refs", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int> manager(4, 1);
+
+    Utils::WeakRef refs[5] = {
+        manager.add(0),
+        { 100000, 0 },
+        manager.add(2),
+        { WEAKREF_INVALID_INDEX, 0 },
+        manager.add(4)
+    };
+
+    int* out_values[5];
+    uint64_t invalid_mask;
+    REQUIRE(manager.get_many(refs, 5, out_values, &invalid_mask) == 2);
+    REQUIRE(invalid_mask == 0b01010);
+    REQUIRE(*out_values[4] == 4);
+}
+
+TEST_CASE("Fast Validation Rejects Invalid Refs", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int, Utils::WeakRefVectorStorage, Utils::FastRefValidation> manager(4, 1);
+    Utils::DenseWeakRefManager<int, Utils::FastRefValidation> dense_manager(4, 1);
+
+    auto ref = manager.add(888);
+    auto dense_ref = dense_manager.add(999);
+    REQUIRE(*manager.get(ref) == 888);
+    REQUIRE(*dense_manager.get(dense_ref) == 999);
+
+    Utils::WeakRef out_of_bounds_ref = { 100000, 0 };
+    REQUIRE(manager.get(out_of_bounds_ref) == nullptr);
+    REQUIRE(dense_manager.get(out_of_bounds_ref) == nullptr);
+
+    manager.remove(ref);
+    dense_manager.remove(dense_ref);
+    REQUIRE(manager.get(ref) == nullptr);
+    REQUIRE(dense_manager.get(dense_ref) == nullptr);
+}
+
+TEST_CASE("Unchecked Validation Resolves Valid Refs", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int, Utils::WeakRefVectorStorage, Utils::UncheckedRefValidation> manager(4, 1);
+    Utils::DenseWeakRefManager<int, Utils::UncheckedRefValidation> dense_manager(4, 1);
+
+    auto ref = manager.add(888);
+    auto dense_ref = dense_manager.add(999);
+    REQUIRE(*manager.get(ref) == 888);
+    REQUIRE(*dense_manager.get(dense_ref) == 999);
+
+    // Removal is still checked
+    dense_manager.remove(dense_ref);
+    dense_manager.remove(dense_ref);
+    REQUIRE(dense_manager.size() == 0);
+}
+
+TEST_CASE("WeakRefs Pack Into 64 Bits", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int> manager(4, 1);
+
+    auto ref = manager.add(888, 7);
+    REQUIRE(ref.type == 7);
+    REQUIRE(Utils::weakref_from_bits(Utils::weakref_bits(ref)) == ref);
+
+    manager.remove(ref);
+    auto new_ref = manager.add(999, 7);
+    REQUIRE(new_ref != ref);
+    REQUIRE(Utils::weakref_bits(new_ref) != Utils::weakref_bits(ref));
+}
+
+TEST_CASE("WeakRefs Only Resolve With Their Type", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int> manager(4, 1);
+
+    auto ref = manager.add(888, 1);
+    Utils::WeakRef wrong_type_ref = ref;
+    wrong_type_ref.type = 2;
+
+    REQUIRE(*manager.get(ref) == 888);
+    REQUIRE(manager.get(wrong_type_ref) == nullptr);
+
+    // Removing through the wrong type doesn't free the slot
+    manager.remove(wrong_type_ref);
+    REQUIRE(*manager.get(ref) == 888);
+}
+
+TEST_CASE("Default WeakRefs Are Invalid", "[weak_ref_manager]")
+{
+    Utils::WeakRefManager<int> manager(4, 1);
+    Utils::WeakRefManager<int, Utils::WeakRefVectorStorage, Utils::FastRefValidation> fast_manager(4, 1);
+
+    // Nothing issued yet, slot 0 exists but holds nothing
+    Utils::WeakRef default_ref = {};
+    Utils::WeakRef forged_ref = { 2, 0, 0 };
+    REQUIRE(!manager.ref_is_valid(default_ref));
+    REQUIRE(!manager.ref_is_valid(forged_ref));
+    REQUIRE(manager.get(default_ref) == nullptr);
+    REQUIRE(fast_manager.get(default_ref) == nullptr);
+    REQUIRE(fast_manager.get_or(forged_ref, -1) == -1);
+
+    // Still invalid once slot 0 is in use
+    auto ref = manager.add(888);
+    REQUIRE(ref.index == 0);
+    REQUIRE(ref != default_ref);
+    REQUIRE(manager.get(default_ref) == nullptr);
+    manager.remove(default_ref);
+    REQUIRE(*manager.get(ref) == 888);
+
+    uint64_t invalid_mask = 0;
+    REQUIRE(manager.remove_many(&forged_ref, 1, &invalid_mask) == 1);
+}
+
+TEST_CASE("Dense Manager Rejects Never Issued Refs", "[weak_ref_manager]")
+{
+    Utils::DenseWeakRefManager<int> manager(8, 1);
+    Utils::DenseWeakRefManager<int, Utils::FastRefValidation> fast_manager(8, 1);
+
+    // Empty, so there's no value for a bad index to land on
+    Utils::WeakRef default_ref = {};
+    REQUIRE(manager.get(default_ref) == nullptr);
+    REQUIRE(fast_manager.get(default_ref) == nullptr);
+    manager.remove(default_ref);
+    REQUIRE(manager.size() == 0);
+
+    // Two live values, neither of which the forged ref should evict
+    auto first_ref = manager.add(888);
+    auto second_ref = manager.add(999);
+    Utils::WeakRef forged_ref = { 7, 0, 0 };
+    manager.remove(forged_ref);
+    manager.remove(default_ref);
+    REQUIRE(manager.size() == 2);
+    REQUIRE(manager.get(forged_ref) == nullptr);
+    REQUIRE(*manager.get(first_ref) == 888);
+    REQUIRE(*manager.get(second_ref) == 999);
+}